@@ -1,4 +1,6 @@
 #!/bin/bash
 
 cc src/main.c src/lisp.c src/var.c src/platform.c src/call.c src/builtin.c \
-   src/tree.c -o main -ansi -Isrc -g -Wall -Wextra -Wpedantic -lm
\ No newline at end of file
+   src/tree.c src/opt.c src/memo.c src/vm.c src/jit.c src/aot.c src/num.c \
+   src/stream.c \
+   -o main -ansi -Isrc -g -Wall -Wextra -Wpedantic -lm
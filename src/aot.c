@@ -0,0 +1,862 @@
+/* A small interpreter for a lisp like language, targetting embedded systems.
+ * by Mibi88
+ *
+ * This software is licensed under the BSD-3-Clause license:
+ *
+ * Copyright 2024 Mibi88
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* CHANGELOG
+ *
+ * 2026/10/18: Created this file. Compile a program to C. Translate the
+ *             bytecode of the functions to C.
+ */
+
+#include <aot.h>
+#include <jit.h>
+#include <opt.h>
+#include <call.h>
+#include <builtin.h>
+#include <vm.h>
+
+#include <ctype.h>
+#include <string.h>
+
+/* The functions of the program that only compute with numbers are compiled
+ * to C functions working on unboxed floats, like the functions the JIT
+ * compiles: their body is a single expression made of numbers, of their
+ * parameters and of calls of the arithmetic and comparison builtins, of if
+ * and of the other functions compiled. The rest of the program is kept as
+ * its source, parsed when the program starts and run by the interpreter,
+ * which calls the C functions in place of the bytecode of these functions,
+ * as long as the names they call still refer to the same functions.
+ * The bytecode of every other function is translated to C too: each
+ * instruction becomes the calls vm_run makes into the runtime to perform it,
+ * with its operand written in the code and the jumps turned into gotos. A
+ * function runs it in place of its bytecode if it is compiled to the same
+ * bytecode when the program runs, which is not the case if a name it calls
+ * refers to something else. */
+
+void aot_string(char *name, String *string) {
+    string->len = strlen(name);
+    if(VAR_STR_INLINE(string)){
+        memcpy(string->data.buf, name, string->len);
+    }else{
+        string->data.ptr = name;
+    }
+}
+
+int aot_attach(LizyLang *lisp, Function *function, Code *code) {
+    TlNativeFunc *native;
+    TlCompiledFunc *compiled;
+    TlNativeDep *dep;
+    Function *called;
+    String name;
+    size_t i, n;
+    for(n=0;n<lisp->compiled_num;n++){
+        compiled = lisp->compiled+n;
+        /* It was compiled to other bytecode if a name it uses refers to
+         * something else. */
+        if(compiled->fncdef == function->ptr.fncdef &&
+           compiled->size == code->size &&
+           !memcmp(compiled->ops, code->ops, code->size)){
+            code->compiled = compiled->f;
+            break;
+        }
+    }
+    /* The calls it makes to itself would not use the cache. */
+    if(function->memo && lisp->opt & TL_OPT_MEMO) return TL_SUCCESS;
+    for(n=0;n<lisp->native_num;n++){
+        native = lisp->natives+n;
+        if(native->fncdef != function->ptr.fncdef) continue;
+        for(i=0;i<native->dep_num;i++){
+            dep = native->deps+i;
+            aot_string(dep->name, &name);
+            if(call_find_func(lisp, &name, &called)) return TL_SUCCESS;
+            if(dep->f){
+                if(!called->builtin || called->ptr.f != dep->f){
+                    return TL_SUCCESS;
+                }
+            }else if(called->builtin || called->ptr.fncdef !=
+                     ((Node**)lisp->node.childs)[dep->statement]){
+                return TL_SUCCESS;
+            }
+        }
+        code->native = native->f;
+        return TL_SUCCESS;
+    }
+    return TL_SUCCESS;
+}
+
+String *aot_name(Node *node) {
+    Var *name = ((Node**)node->childs)[0]->var;
+    if((name->type != TL_T_NAME && name->type != TL_T_STR) ||
+       VAR_LEN(name) != 1){
+        return NULL;
+    }
+    return &VAR_GET_ITEM(name, 0).string;
+}
+
+size_t aot_passed(Node *names) {
+    size_t i, passed = 0;
+    for(i=0;i<names->childnum;i++){
+        if(!((Node**)names->childs)[i]->childnum) passed++;
+    }
+    return passed;
+}
+
+char aot_candidate(LizyLang *lisp, Node *node) {
+    Node *names;
+    size_t i, passed;
+    if(!opt_is(lisp, node, builtin_fncdef) || node->childnum != 3 ||
+       !aot_name(node)){
+        return 0;
+    }
+    names = ((Node**)node->childs)[1];
+    if(!opt_literal_params(lisp, names) || names->childnum > TL_JIT_ARGS){
+        return 0;
+    }
+    /* The parameters the optimiser added come after the arguments. */
+    passed = aot_passed(names);
+    for(i=0;i<passed;i++){
+        if(((Node**)names->childs)[i]->childnum) return 0;
+    }
+    return 1;
+}
+
+char aot_same(String *a, String *b) {
+    return a->len == b->len && !memcmp(VAR_RAW_STR_DATA(a),
+                                       VAR_RAW_STR_DATA(b), a->len);
+}
+
+size_t aot_find(AotCompiler *c, String *name, size_t *defs) {
+    Node *node;
+    size_t i, found = c->num;
+    *defs = 0;
+    for(i=0;i<c->num;i++){
+        node = ((Node**)c->lisp->node.childs)[i];
+        if(!opt_is(c->lisp, node, builtin_fncdef) || !node->childnum ||
+           !aot_name(node) || !aot_same(aot_name(node), name)){
+            continue;
+        }
+        found = i;
+        (*defs)++;
+    }
+    return found;
+}
+
+int aot_op(AotCompiler *c, Node *node, size_t *callee) {
+    Function *function;
+    String *name = &node->var->items->call.function;
+    size_t defs;
+    *callee = aot_find(c, name, &defs);
+    if(!call_find_func(c->lisp, name, &function)){
+        /* The program may replace the builtin. */
+        if(!function->builtin || defs) return TL_JIT_NONE;
+        return jit_builtin_op(function->ptr.f);
+    }
+    /* The function must always be the same. */
+    if(defs != 1 || !c->fncdefs[*callee]) return TL_JIT_NONE;
+    return TL_JIT_CALL;
+}
+
+char aot_supported(AotCompiler *c, Node *node, char in_call) {
+    Var *var = node->var;
+    size_t i, n;
+    int op;
+    if(var->type == TL_T_NUM){
+        /* Infinities and NaN can't be written in C. */
+        return VAR_LEN(var) == 1 &&
+               VAR_NUM(VAR_GET_ITEM(var, 0))-VAR_NUM(VAR_GET_ITEM(var, 0))
+               == 0;
+    }
+    if(var->type == TL_T_NAME){
+        return VAR_LEN(var) == 1 && opt_find_param(c->names, var, &n) &&
+               n < c->visible;
+    }
+    if(var->type != TL_T_CALL || VAR_LEN(var) != 1) return 0;
+    op = aot_op(c, node, &n);
+    if(op == TL_JIT_NONE) return 0;
+    if(op == TL_JIT_CALL){
+        /* Its arguments are evaluated before the call instead of when they
+         * are used, so they must not be able to recurse forever. */
+        if(in_call || node->childnum !=
+           aot_passed(((Node**)c->fncdefs[n]->childs)[1])){
+            return 0;
+        }
+        in_call = 1;
+    }else if(node->childnum != (op == TL_JIT_IF ? 3 : 2)){
+        return 0;
+    }
+    for(i=0;i<node->childnum;i++){
+        if(!aot_supported(c, ((Node**)node->childs)[i], in_call)) return 0;
+    }
+    return 1;
+}
+
+char aot_function(AotCompiler *c) {
+    Node *fncdef = c->fncdefs[c->current];
+    size_t i;
+    c->names = ((Node**)fncdef->childs)[1];
+    c->passed = aot_passed(c->names);
+    c->visible = c->names->childnum;
+    if(!aot_supported(c, ((Node**)fncdef->childs)[2], 0)) return 0;
+    for(i=c->passed;i<c->names->childnum;i++){
+        c->visible = i;
+        if(!aot_supported(c, call_let(c->names, i), 1)) return 0;
+    }
+    return 1;
+}
+
+char *aot_builtin(int op) {
+    switch(op){
+        case TL_JIT_IF:
+            return "builtin_if";
+        case TL_JIT_ADD:
+            return "builtin_add";
+        case TL_JIT_SUB:
+            return "builtin_substract";
+        case TL_JIT_MUL:
+            return "builtin_multiply";
+        case TL_JIT_DIV:
+            return "builtin_divide";
+        case TL_JIT_MOD:
+            return "builtin_modulo";
+        case TL_JIT_LT:
+            return "builtin_smaller";
+        case TL_JIT_GT:
+            return "builtin_bigger";
+        case TL_JIT_LE:
+            return "builtin_smaller_or_equal";
+        case TL_JIT_GE:
+            return "builtin_bigger_or_equal";
+        case TL_JIT_EQ:
+            return "builtin_equal";
+        default:
+            return "builtin_not_equal";
+    }
+}
+
+void aot_write(AotCompiler *c, char *text) {
+    char *buf;
+    size_t len = strlen(text);
+    size_t max;
+    if(c->rc) return;
+    if(c->size+len > c->max){
+        max = c->max ? c->max*2 : 256;
+        while(max < c->size+len) max *= 2;
+        buf = TL_REALLOC(&c->lisp->alloc, c->buf, max);
+        if(!buf){
+            c->rc = TL_ERR_OUT_OF_MEM;
+            return;
+        }
+        c->buf = buf;
+        c->max = max;
+    }
+    memcpy(c->buf+c->size, text, len);
+    c->size += len;
+}
+
+void aot_line(AotCompiler *c, char *text) {
+    size_t i;
+    for(i=0;i<c->indent;i++) aot_write(c, "    ");
+    aot_write(c, text);
+    aot_write(c, "\n");
+}
+
+void aot_escape(FILE *fp, char *data, size_t len) {
+    size_t i;
+    for(i=0;i<len;i++){
+        if(isalnum((unsigned char)data[i]) ||
+           strchr("+-*/%<>=!_.", data[i])){
+            fputc(data[i], fp);
+        }else{
+            fprintf(fp, "\\%03o", (unsigned char)data[i]);
+        }
+    }
+}
+
+void aot_num(char *out, float value) {
+    sprintf(out, "%.9g", value);
+    if(!strchr(out, '.') && !strchr(out, 'e')) strcat(out, ".0");
+    strcat(out, "f");
+}
+
+size_t aot_temp(AotCompiler *c) {
+    return c->temps++;
+}
+
+void aot_dep(AotCompiler *c, Node *node) {
+    Node **deps;
+    size_t i, max, callee;
+    if(c->rc) return;
+    if(node->var->type == TL_T_CALL){
+        for(i=0;i<c->dep_num;i++){
+            if(aot_same(&c->deps[i]->var->items->call.function,
+                        &node->var->items->call.function)){
+                break;
+            }
+        }
+        if(i == c->dep_num){
+            if(c->dep_num >= c->dep_max){
+                max = c->dep_max ? c->dep_max*2 : 8;
+                deps = TL_REALLOC(&c->lisp->alloc, c->deps,
+                                  max*sizeof(Node*));
+                if(!deps){
+                    c->rc = TL_ERR_OUT_OF_MEM;
+                    return;
+                }
+                c->deps = deps;
+                c->dep_max = max;
+            }
+            c->deps[c->dep_num++] = node;
+            if(aot_op(c, node, &callee) == TL_JIT_CALL){
+                /* The C functions it calls also depend on their calls. */
+                aot_deps(c, c->fncdefs[callee]);
+            }
+        }
+    }
+    for(i=0;i<node->childnum;i++) aot_dep(c, ((Node**)node->childs)[i]);
+}
+
+void aot_deps(AotCompiler *c, Node *fncdef) {
+    Node *names = ((Node**)fncdef->childs)[1];
+    size_t i;
+    for(i=aot_passed(names);i<names->childnum;i++){
+        aot_dep(c, call_let(names, i));
+    }
+    aot_dep(c, ((Node**)fncdef->childs)[2]);
+}
+
+size_t aot_expr(AotCompiler *c, Node *node, char tail) {
+    Var *var = node->var;
+    char line[128];
+    char num[64];
+    size_t args[TL_JIT_ARGS];
+    size_t a, b, t, i, n;
+    int op;
+    if(var->type == TL_T_NUM){
+        t = aot_temp(c);
+        aot_num(num, VAR_NUM(VAR_GET_ITEM(var, 0)));
+        sprintf(line, "t%lu = %s;", (unsigned long)t, num);
+        aot_line(c, line);
+        return t;
+    }
+    if(var->type == TL_T_NAME){
+        opt_find_param(c->names, var, &n);
+        t = aot_temp(c);
+        sprintf(line, "t%lu = p[%lu];", (unsigned long)t, (unsigned long)n);
+        aot_line(c, line);
+        return t;
+    }
+    op = aot_op(c, node, &n);
+    if(op == TL_JIT_CALL){
+        for(i=0;i<node->childnum;i++){
+            args[i] = aot_expr(c, ((Node**)node->childs)[i], 0);
+        }
+        if(tail && n == c->current){
+            /* A call of itself in tail position is a jump. */
+            for(i=0;i<node->childnum;i++){
+                sprintf(line, "p[%lu] = t%lu;", (unsigned long)i,
+                        (unsigned long)args[i]);
+                aot_line(c, line);
+            }
+            aot_line(c, "goto body;");
+            c->loops = 1;
+            return TL_AOT_NONE;
+        }
+        t = aot_temp(c);
+        aot_line(c, "{");
+        c->indent++;
+        /* The callee computes its hidden parameters after the arguments. */
+        i = ((Node**)c->fncdefs[n]->childs)[1]->childnum;
+        sprintf(line, "float a[%lu];", (unsigned long)(i ? i : 1));
+        aot_line(c, line);
+        for(i=0;i<node->childnum;i++){
+            sprintf(line, "a[%lu] = t%lu;", (unsigned long)i,
+                    (unsigned long)args[i]);
+            aot_line(c, line);
+        }
+        sprintf(line, "if(lzy_fn%lu(a, depth+1, &t%lu)) return 1;",
+                (unsigned long)n, (unsigned long)t);
+        aot_line(c, line);
+        c->indent--;
+        aot_line(c, "}");
+        return t;
+    }
+    if(op == TL_JIT_IF){
+        a = aot_expr(c, ((Node**)node->childs)[0], 0);
+        sprintf(line, "if(t%lu != 0){", (unsigned long)a);
+        aot_line(c, line);
+        c->indent++;
+        t = TL_AOT_NONE;
+        b = aot_expr(c, ((Node**)node->childs)[1], tail);
+        if(b != TL_AOT_NONE){
+            t = aot_temp(c);
+            sprintf(line, "t%lu = t%lu;", (unsigned long)t, (unsigned long)b);
+            aot_line(c, line);
+        }
+        c->indent--;
+        aot_line(c, "}else{");
+        c->indent++;
+        b = aot_expr(c, ((Node**)node->childs)[2], tail);
+        if(b != TL_AOT_NONE){
+            if(t == TL_AOT_NONE) t = aot_temp(c);
+            sprintf(line, "t%lu = t%lu;", (unsigned long)t, (unsigned long)b);
+            aot_line(c, line);
+        }
+        c->indent--;
+        aot_line(c, "}");
+        return t;
+    }
+    a = aot_expr(c, ((Node**)node->childs)[0], 0);
+    b = aot_expr(c, ((Node**)node->childs)[1], 0);
+    t = aot_temp(c);
+    if(op == TL_JIT_DIV || op == TL_JIT_MOD){
+        sprintf(line, "if(t%lu == 0) return 1;", (unsigned long)b);
+        aot_line(c, line);
+    }
+    if(op == TL_JIT_MOD){
+        sprintf(line, "t%lu = (float)fmod(t%lu, t%lu);", (unsigned long)t,
+                (unsigned long)a, (unsigned long)b);
+        aot_line(c, line);
+        return t;
+    }
+    sprintf(line, "t%lu = t%lu %s t%lu;", (unsigned long)t, (unsigned long)a,
+            op == TL_JIT_ADD ? "+" : op == TL_JIT_SUB ? "-" :
+            op == TL_JIT_MUL ? "*" : op == TL_JIT_DIV ? "/" :
+            op == TL_JIT_LT ? "<" : op == TL_JIT_GT ? ">" :
+            op == TL_JIT_LE ? "<=" : op == TL_JIT_GE ? ">=" :
+            op == TL_JIT_EQ ? "==" : "!=", (unsigned long)b);
+    aot_line(c, line);
+    return t;
+}
+
+int aot_emit_func(AotCompiler *c) {
+    Node *fncdef = c->fncdefs[c->current];
+    Node *dep;
+    String *name;
+    char line[64];
+    size_t i, t, callee;
+    int op;
+    c->names = ((Node**)fncdef->childs)[1];
+    c->passed = aot_passed(c->names);
+    c->size = 0;
+    c->temps = 0;
+    c->indent = 1;
+    c->loops = 0;
+    c->dep_num = 0;
+    /* The hidden parameters are computed first. */
+    for(i=c->passed;i<c->names->childnum;i++){
+        t = aot_expr(c, call_let(c->names, i), 0);
+        sprintf(line, "p[%lu] = t%lu;", (unsigned long)i, (unsigned long)t);
+        aot_line(c, line);
+    }
+    t = aot_expr(c, ((Node**)fncdef->childs)[2], 1);
+    if(t != TL_AOT_NONE){
+        sprintf(line, "*result = t%lu;", (unsigned long)t);
+        aot_line(c, line);
+        aot_line(c, "return 0;");
+    }
+    aot_deps(c, fncdef);
+    if(c->rc) return c->rc;
+    if(c->dep_num){
+        fprintf(c->fp, "TlNativeDep lzy_deps%lu[] = {\n",
+                (unsigned long)c->current);
+        for(i=0;i<c->dep_num;i++){
+            dep = c->deps[i];
+            name = &dep->var->items->call.function;
+            fputs("    {\"", c->fp);
+            aot_escape(c->fp, VAR_RAW_STR_DATA(name), name->len);
+            op = aot_op(c, dep, &callee);
+            if(op == TL_JIT_CALL){
+                fprintf(c->fp, "\", %lu, NULL}", (unsigned long)callee);
+            }else{
+                fprintf(c->fp, "\", 0, %s}", aot_builtin(op));
+            }
+            fputs(i+1 < c->dep_num ? ",\n" : "\n", c->fp);
+        }
+        fputs("};\n\n", c->fp);
+    }
+    fprintf(c->fp, "int lzy_fn%lu(float *p, unsigned int depth, "
+            "float *result) {\n", (unsigned long)c->current);
+    for(i=0;i<c->temps;i++){
+        fprintf(c->fp, i%8 ? ", t%lu" : i ? ";\n    float t%lu" :
+                "    float t%lu", (unsigned long)i);
+    }
+    if(c->temps) fputs(";\n", c->fp);
+    fputs("    if(depth >= TL_JIT_DEPTH) return 1;\n", c->fp);
+    if(c->loops) fputs("body:\n", c->fp);
+    fwrite(c->buf, 1, c->size, c->fp);
+    fputs("}\n\n", c->fp);
+    return TL_SUCCESS;
+}
+
+int aot_compile(AotCompiler *c, Node *fncdef) {
+    Node *names;
+    Function function;
+    Var params;
+    size_t i;
+    int rc = TL_SUCCESS;
+    c->codes[c->current] = NULL;
+    if(!opt_is(c->lisp, fncdef, builtin_fncdef) || fncdef->childnum < 3 ||
+       !aot_name(fncdef)){
+        return TL_SUCCESS;
+    }
+    names = ((Node**)fncdef->childs)[1];
+    if(!opt_literal_params(c->lisp, names)) return TL_SUCCESS;
+    /* The parameters builtin_fncdef gives to the function. */
+    params.null = 0;
+    params.ref = 0;
+    params.storage = TL_S_ITEMS;
+    params.base = NULL;
+    params.size = 0;
+    params.items = NULL;
+    params.type = TL_T_NAME;
+    for(i=0;i<names->childnum && !rc;i++){
+        if(i){
+            rc = var_append(&c->lisp->alloc,
+                            ((Node**)names->childs)[i]->var, &params);
+        }else{
+            rc = var_copy(&c->lisp->alloc, ((Node**)names->childs)[i]->var,
+                          &params);
+        }
+    }
+    if(!rc){
+        function.ptr.fncdef = fncdef;
+        function.params = &params;
+        function.code = NULL;
+        rc = vm_compile(c->lisp, &function);
+    }
+    var_free(&c->lisp->alloc, &params);
+    if(rc) return rc;
+    /* It is too big to be compiled. */
+    if(((Code*)function.code)->size) c->codes[c->current] = function.code;
+    return TL_SUCCESS;
+}
+
+/* If the call of a builtin function is specialised for the types of its
+ * arguments, like vm_run does when quickening is enabled. */
+char aot_quick(AotCompiler *c, Code *code, size_t offset) {
+    size_t n = code->ops[offset+1]|code->ops[offset+2]<<8;
+    return c->lisp->opt & TL_OPT_QUICKEN &&
+           code->ops[offset] == TL_OP_BUILTIN &&
+           ((Node*)code->refs[n].node)->childnum == 2;
+}
+
+void aot_emit_op(AotCompiler *c, Code *code, size_t offset) {
+    FILE *fp = c->fp;
+    unsigned char op = code->ops[offset];
+    unsigned long n = code->ops[offset+1]|code->ops[offset+2]<<8;
+    char quick = aot_quick(c, code, offset);
+    fprintf(fp, "o%lu:\n    cont->i = %lu;\n", (unsigned long)offset,
+            (unsigned long)offset);
+    if(op != TL_OP_JUMP && op != TL_OP_TAIL && op != TL_OP_END &&
+       (op != TL_OP_BUILTIN || quick)){
+        fputs("    slot = cont->args+cont->sp;\n", fp);
+    }
+    switch(op){
+        case TL_OP_CONST:
+            fprintf(fp, "    rc = var_ref(((Node*)refs[%lu].node)->var, "
+                    "&slot->value);\n", n);
+            break;
+        case TL_OP_COPY:
+            fprintf(fp, "    rc = var_copy(&lisp->alloc, "
+                    "((Node*)refs[%lu].node)->var,\n"
+                    "                  &slot->value);\n", n);
+            break;
+        case TL_OP_PARAM:
+        case TL_OP_BORROW:
+            fprintf(fp, "    rc = vm_param(lisp, cont, %lu, slot, %d);\n"
+                    "    if(rc == TL_PENDING) return TL_SUCCESS;\n", n,
+                    op == TL_OP_BORROW);
+            break;
+        case TL_OP_GLOBAL:
+            fprintf(fp, "    if(!vm_find_var(lisp, refs+%lu,\n"
+                    "                    &((Node*)refs[%lu].node)->var"
+                    "->items->string, &i)){\n"
+                    "        return TL_ERR_NOT_DEF;\n"
+                    "    }\n"
+                    "    rc = var_copy(&lisp->alloc, lisp->vars+i, "
+                    "&slot->value);\n", n, n);
+            break;
+        case TL_OP_BUILTIN:
+            if(quick){
+                fprintf(fp, "    op = vm_quick_op(refs+%lu, slot-2);\n"
+                        "    if(op != TL_OP_BUILTIN && vm_guard(op, slot-2)){"
+                        "\n"
+                        "        rc = vm_quick(lisp, cont, op);\n"
+                        "    }else{\n"
+                        "        rc = vm_builtin(lisp, cont, refs+%lu);"
+                        "\n"
+                        "    }\n", n, n);
+            }else{
+                fprintf(fp, "    rc = vm_builtin(lisp, cont, refs+%lu);"
+                        "\n", n);
+            }
+            fputs("    if(rc) return rc;\n", fp);
+            return;
+        case TL_OP_CALL:
+        case TL_OP_EXEC:
+            fprintf(fp, "    if(!slot->evaluated){\n"
+                    "        return vm_call(lisp, cont, refs+%lu, "
+                    "&slot->value,\n"
+                    "                       &slot->evaluated, 0);\n"
+                    "    }\n", n);
+            if(op == TL_OP_CALL){
+                fputs("    if(slot->value.type == TL_T_NAME){\n"
+                      "        rc = call_parse_arg(lisp, &slot->value, "
+                      "&parsed, cont->context);\n"
+                      "        if(rc) return rc;\n"
+                      "        var_free(&lisp->alloc, &slot->value);\n"
+                      "        slot->value = parsed;\n"
+                      "    }\n", fp);
+            }
+            fputs("    cont->sp++;\n", fp);
+            return;
+        case TL_OP_TAIL:
+            fprintf(fp, "    cont->i = %lu;\n"
+                    "    return vm_call(lisp, cont, refs+%lu, "
+                    "cont->dest, NULL, 1);\n",
+                    (unsigned long)offset+TL_OP_SZ, n);
+            return;
+        case TL_OP_POP:
+            fputs("    slot--;\n"
+                  "    var_free(&lisp->alloc, &slot->value);\n"
+                  "    slot->evaluated = 0;\n"
+                  "    cont->sp--;\n", fp);
+            return;
+        case TL_OP_JUMPF:
+            fprintf(fp, "    slot--;\n"
+                    "    rc = TL_SUCCESS;\n"
+                    "    if(VAR_LEN(&slot->value) != 1){\n"
+                    "        rc = TL_ERR_INVALID_LIST_SIZE;\n"
+                    "    }else if(slot->value.type != TL_T_NUM){\n"
+                    "        rc = TL_ERR_BAD_TYPE;\n"
+                    "    }\n"
+                    "    op = !rc && VAR_NUM_AT(&slot->value, 0) == 0;\n"
+                    "    var_free(&lisp->alloc, &slot->value);\n"
+                    "    slot->evaluated = 0;\n"
+                    "    cont->sp--;\n"
+                    "    if(rc){\n"
+                    "        cont->i = %lu;\n"
+                    "        return rc;\n"
+                    "    }\n"
+                    "    if(op) goto o%lu;\n",
+                    (unsigned long)offset+TL_OP_SZ, n);
+            return;
+        case TL_OP_JUMP:
+            fprintf(fp, "    goto o%lu;\n", n);
+            return;
+        case TL_OP_RETURN:
+            fputs("    slot--;\n"
+                  "    *cont->dest = slot->value;\n"
+                  "    slot->evaluated = 0;\n"
+                  "    cont->sp--;\n", fp);
+            return;
+        case TL_OP_END:
+            fputs("    call_free_cont_args(lisp, cont);\n"
+                  "    if(cont->state == TL_C_EXPR){\n"
+                  "        if(cont->done) *cont->done = 1;\n"
+                  "        return call_pop_cont(lisp);\n"
+                  "    }\n"
+                  "    return call_end_body(lisp, cont);\n", fp);
+            return;
+        default:
+            fputs("    return TL_ERR_INTERNAL;\n", fp);
+            return;
+    }
+    /* The instruction pushed a value. */
+    fputs("    if(rc) return rc;\n"
+          "    slot->evaluated = 1;\n"
+          "    cont->sp++;\n", fp);
+}
+
+int aot_emit_vm(AotCompiler *c) {
+    Code *code = c->codes[c->current];
+    FILE *fp = c->fp;
+    unsigned long n = c->current;
+    size_t i;
+    char refs = 0, slot = 0, parsed = 0, var = 0, op = 0, rc = 0;
+    unsigned char code_op;
+    /* Only the variables it uses are declared. */
+    for(i=0;i<code->size;i+=TL_OP_SZ){
+        code_op = code->ops[i];
+        if(code_op != TL_OP_JUMP && code_op != TL_OP_TAIL &&
+           code_op != TL_OP_END){
+            slot |= code_op != TL_OP_BUILTIN || aot_quick(c, code, i);
+            rc |= code_op != TL_OP_EXEC && code_op != TL_OP_POP &&
+                  code_op != TL_OP_RETURN;
+        }
+        refs |= code_op == TL_OP_CONST || code_op == TL_OP_COPY ||
+                code_op == TL_OP_GLOBAL || code_op == TL_OP_BUILTIN ||
+                code_op == TL_OP_CALL || code_op == TL_OP_EXEC ||
+                code_op == TL_OP_TAIL;
+        parsed |= code_op == TL_OP_CALL;
+        var |= code_op == TL_OP_GLOBAL;
+        op |= code_op == TL_OP_JUMPF || aot_quick(c, code, i);
+    }
+    fprintf(fp, "unsigned char lzy_ops%lu[] = {", n);
+    for(i=0;i<code->size;i++){
+        fprintf(fp, i%16 ? " %d," : "\n    %d,", code->ops[i]);
+    }
+    fputs("\n};\n\n", fp);
+    fprintf(fp, "int lzy_vm%lu(void *_lisp, void *_cont) {\n", n);
+    fputs("    LizyLang *lisp = _lisp;\n"
+          "    Cont *cont = _cont;\n", fp);
+    if(refs) fputs("    CodeRef *refs = cont->code->refs;\n", fp);
+    if(slot) fputs("    Arg *slot;\n", fp);
+    if(parsed) fputs("    Var parsed;\n", fp);
+    if(var) fputs("    size_t i;\n", fp);
+    if(op) fputs("    unsigned char op;\n", fp);
+    if(rc) fputs("    int rc;\n", fp);
+    fputs("    /* It continues from the instruction it stopped at. */\n"
+          "    switch(cont->i){\n", fp);
+    for(i=0;i<code->size;i+=TL_OP_SZ){
+        fprintf(fp, "        case %lu: goto o%lu;\n", (unsigned long)i,
+                (unsigned long)i);
+    }
+    fputs("    }\n"
+          "    return TL_ERR_INTERNAL;\n", fp);
+    for(i=0;i<code->size;i+=TL_OP_SZ) aot_emit_op(c, code, i);
+    fputs("}\n\n", fp);
+    return TL_SUCCESS;
+}
+
+int aot_emit(LizyLang *lisp, char *file, FILE *fp) {
+    AotCompiler c;
+    size_t i, n;
+    char changed;
+    c.lisp = lisp;
+    c.fp = fp;
+    c.num = lisp->node.childnum;
+    c.buf = NULL;
+    c.size = 0;
+    c.max = 0;
+    c.deps = NULL;
+    c.dep_num = 0;
+    c.dep_max = 0;
+    c.rc = TL_SUCCESS;
+    c.fncdefs = TL_MALLOC(&lisp->alloc, (c.num ? c.num : 1)*sizeof(Node*));
+    if(!c.fncdefs) return TL_ERR_OUT_OF_MEM;
+    c.codes = TL_MALLOC(&lisp->alloc, (c.num ? c.num : 1)*sizeof(Code*));
+    if(!c.codes){
+        TL_FREE(&lisp->alloc, c.fncdefs);
+        return TL_ERR_OUT_OF_MEM;
+    }
+    for(c.current=0;c.current<c.num && !c.rc;c.current++){
+        c.rc = aot_compile(&c, ((Node**)lisp->node.childs)[c.current]);
+    }
+    for(i=0;i<c.num;i++){
+        c.fncdefs[i] = ((Node**)lisp->node.childs)[i];
+        if(!aot_candidate(lisp, c.fncdefs[i])) c.fncdefs[i] = NULL;
+    }
+    /* A function can only call the functions that are compiled too. */
+    do{
+        changed = 0;
+        for(c.current=0;c.current<c.num;c.current++){
+            if(c.fncdefs[c.current] && !aot_function(&c)){
+                c.fncdefs[c.current] = NULL;
+                changed = 1;
+            }
+        }
+    }while(changed);
+    fputs("#include <lisp.h>\n#include <platform.h>\n#include <builtin.h>\n"
+          "#include <call.h>\n#include <vm.h>\n\n#include <math.h>\n"
+          "#include <stdio.h>\n#include <stdlib.h>\n\n", fp);
+    for(i=0;i<c.num;i++){
+        if(!c.fncdefs[i]) continue;
+        fprintf(fp, "int lzy_fn%lu(float *p, unsigned int depth, "
+                "float *result);\n", (unsigned long)i);
+    }
+    fputs("\n", fp);
+    for(c.current=0;c.current<c.num && !c.rc;c.current++){
+        if(c.fncdefs[c.current] && aot_emit_func(&c)) break;
+        if(c.codes[c.current] && aot_emit_vm(&c)) break;
+    }
+    if(!c.rc){
+        fputs("char lzy_file[] = \"", fp);
+        aot_escape(fp, file, strlen(file));
+        fputs("\";\n\nchar lzy_source[] = {", fp);
+        for(i=0;i<lisp->sz;i++){
+            fprintf(fp, i%16 ? " %d," : "\n    %d,",
+                    (unsigned char)lisp->buffer[i]);
+        }
+        fputs(lisp->sz ? "\n};\n\n" : "\n    0\n};\n\n", fp);
+        fputs("void lzy_onerror(char *message, void *data) {\n"
+              "    LizyLang *lisp = data;\n"
+              "    fprintf(stderr, \"%s:%ld: Error: %s\\n\", lzy_file, "
+              "lisp->line,\n"
+              "            message);\n"
+              "}\n\n"
+              "int main(int argc, char **argv) {\n"
+              "    LizyLang lisp;\n"
+              "    int rc;\n", fp);
+        fprintf(fp, "    tl_init(&lisp, lzy_source, %lu, NULL);\n",
+                (unsigned long)lisp->sz);
+        fputs("    if(argc > 1) tl_set_mem_limit(&lisp, strtoul(argv[1], "
+              "NULL, 10));\n", fp);
+        fprintf(fp, "    tl_set_opt(&lisp, %d);\n", lisp->opt);
+        fputs("    rc = tl_parse(&lisp, lzy_onerror, &lisp);\n", fp);
+        for(i=0;i<c.num;i++){
+            if(!c.fncdefs[i]) continue;
+            c.current = i;
+            c.dep_num = 0;
+            aot_deps(&c, c.fncdefs[i]);
+            n = c.dep_num;
+            if(n){
+                fprintf(fp, "    if(!rc) rc = tl_add_native(&lisp, %lu, "
+                        "lzy_fn%lu, lzy_deps%lu, %lu);\n", (unsigned long)i,
+                        (unsigned long)i, (unsigned long)i, (unsigned long)n);
+            }else{
+                fprintf(fp, "    if(!rc) rc = tl_add_native(&lisp, %lu, "
+                        "lzy_fn%lu, NULL, 0);\n", (unsigned long)i,
+                        (unsigned long)i);
+            }
+        }
+        for(i=0;i<c.num;i++){
+            if(!c.codes[i]) continue;
+            fprintf(fp, "    if(!rc) rc = tl_add_compiled(&lisp, %lu, "
+                    "lzy_vm%lu, lzy_ops%lu,\n"
+                    "                                 %lu);\n",
+                    (unsigned long)i, (unsigned long)i, (unsigned long)i,
+                    (unsigned long)c.codes[i]->size);
+        }
+        fputs("    if(!rc) rc = tl_exec(&lisp, lzy_onerror, &lisp);\n"
+              "    tl_free(&lisp);\n"
+              "    return rc;\n"
+              "}\n", fp);
+    }
+    TL_FREE(&lisp->alloc, c.fncdefs);
+    TL_FREE(&lisp->alloc, c.codes);
+    if(c.buf) TL_FREE(&lisp->alloc, c.buf);
+    if(c.deps) TL_FREE(&lisp->alloc, c.deps);
+    return c.rc;
+}
@@ -0,0 +1,110 @@
+/* A small interpreter for a lisp like language, targetting embedded systems.
+ * by Mibi88
+ *
+ * This software is licensed under the BSD-3-Clause license:
+ *
+ * Copyright 2024 Mibi88
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* CHANGELOG
+ *
+ * 2026/10/18: Created this file. Compile a program to C. Translate the
+ *             bytecode of the functions to C.
+ */
+
+#ifndef AOT_H
+#define AOT_H
+
+#include <lisp.h>
+#include <var.h>
+#include <tree.h>
+
+#include <stdio.h>
+
+/* The value of an expression that jumps instead of giving a value. */
+#define TL_AOT_NONE ((size_t)-1)
+
+typedef struct {
+    LizyLang *lisp;
+    FILE *fp;
+    /* The fncdef each statement of the program is, if it is compiled to C,
+     * or NULL. */
+    Node **fncdefs;
+    /* The bytecode each function defined by a statement is compiled to, or
+     * NULL. */
+    Code **codes;
+    size_t num;
+    /* The function being compiled. */
+    size_t current;
+    Node *names;
+    size_t passed;
+    size_t visible;
+    /* Its body, written once the temporary values it needs are known. */
+    char *buf;
+    size_t size;
+    size_t max;
+    size_t temps;
+    size_t indent;
+    /* If a call in tail position jumps back to the start of the body. */
+    char loops;
+    /* The calls of the functions it depends on. */
+    Node **deps;
+    size_t dep_num;
+    size_t dep_max;
+    int rc;
+} AotCompiler;
+
+void aot_string(char *name, String *string);
+int aot_attach(LizyLang *lisp, Function *function, Code *code);
+String *aot_name(Node *node);
+size_t aot_passed(Node *names);
+char aot_candidate(LizyLang *lisp, Node *node);
+char aot_same(String *a, String *b);
+size_t aot_find(AotCompiler *c, String *name, size_t *defs);
+int aot_op(AotCompiler *c, Node *node, size_t *callee);
+char aot_supported(AotCompiler *c, Node *node, char in_call);
+char aot_function(AotCompiler *c);
+char *aot_builtin(int op);
+void aot_write(AotCompiler *c, char *text);
+void aot_line(AotCompiler *c, char *text);
+void aot_escape(FILE *fp, char *data, size_t len);
+void aot_num(char *out, float value);
+size_t aot_temp(AotCompiler *c);
+void aot_dep(AotCompiler *c, Node *node);
+void aot_deps(AotCompiler *c, Node *fncdef);
+size_t aot_expr(AotCompiler *c, Node *node, char tail);
+int aot_emit_func(AotCompiler *c);
+int aot_compile(AotCompiler *c, Node *fncdef);
+char aot_quick(AotCompiler *c, Code *code, size_t offset);
+void aot_emit_op(AotCompiler *c, Code *code, size_t offset);
+int aot_emit_vm(AotCompiler *c);
+int aot_emit(LizyLang *lisp, char *file, FILE *fp);
+
+#endif
@@ -48,68 +48,105 @@
  * 2024/10/19: Updated some functions. Removed defend.
  * 2024/10/20: Finish user function definition.
  * 2024/10/21: Fixed functions.
+ * 2026/10/18: Store short strings inline, so that strget does not allocate the
+ *             character on the heap anymore. Get the arguments of set, del,
+ *             =, !=, parsenum, strlen and strget with call_get_arg. Get the
+ *             arguments of the numeric functions with call_get_arg, so that
+ *             constants are passed by reference. Support packed lists in list,
+ *             ++, len, get, print and printraw. Allocate memory with the
+ *             interpreter allocator. Fixed double free in strdef and numdef.
+ *             Fixed freeing the arguments of strdef and numdef on errors.
+ *             Added head, tail, slice and substr. Rewrote callif. Tail calls
+ *             in if and callif. The branch of if takes its place. Evaluate
+ *             the arguments before calling the functions. Register which
+ *             functions are pure, find the strict parameters in fncdef.
+ *             Count the hidden parameters in fncdef. Find the pure
+ *             functions in fncdef. Added memo-persist. Added while, repeat
+ *             and for. Added range, iterate, stream-map, stream-filter,
+ *             take and drop. Added list-map, list-filter and reduce, fused
+ *             with the calls that use their results. The functions that
+ *             borrow their first argument.
  */
 
 #include <builtin.h>
 
-#define TL_REGISTER_FUNC(s, parse, f) rc = var_raw_str(&name, s, \
-                                                       sizeof(s)-1); \
-                                      if(rc) return rc; \
-                                      rc = var_builtin_func(&var, f, parse); \
-                                      if(rc) return rc; \
-                                      rc = tl_add_var(lisp, &var, &name); \
-                                      if(rc) return rc
+#define TL_REGISTER_FUNC(s, parse, pure, f) \
+    rc = var_raw_str(&lisp->alloc, &name, s, sizeof(s)-1); \
+    if(rc) return rc; \
+    rc = var_builtin_func(&lisp->alloc, &var, f, parse, pure); \
+    if(rc) return rc; \
+    rc = tl_add_var(lisp, &var, &name); \
+    if(rc) return rc
 
+/* parse is the amount of arguments that are evaluated before calling the
+ * function, or TL_ARGS_ALL. The other arguments are evaluated when the function
+ * gets them, and it is called again once they are. pure is set if the function
+ * has no side effects. */
 int builtin_register_funcs(LizyLang *lisp) {
     int rc;
     Var var;
     String name;
     /* strdef */
-    TL_REGISTER_FUNC("strdef", 0, builtin_strdef);
-    TL_REGISTER_FUNC("numdef", 0, builtin_numdef);
-    TL_REGISTER_FUNC("set", 0, builtin_set);
-    TL_REGISTER_FUNC("del", 0, builtin_del);
+    TL_REGISTER_FUNC("strdef", 0, 0, builtin_strdef);
+    TL_REGISTER_FUNC("numdef", 0, 0, builtin_numdef);
+    TL_REGISTER_FUNC("set", 0, 0, builtin_set);
+    TL_REGISTER_FUNC("del", 0, 0, builtin_del);
     /* comment */
-    TL_REGISTER_FUNC("comment", 0, builtin_comment);
-    TL_REGISTER_FUNC("print", 1, builtin_print);
-    TL_REGISTER_FUNC("printraw", 0, builtin_printraw);
-    TL_REGISTER_FUNC("input", 1, builtin_input);
-    TL_REGISTER_FUNC("+", 1, builtin_add);
-    TL_REGISTER_FUNC("++", 1, builtin_merge);
-    TL_REGISTER_FUNC("params", 0, builtin_params);
-    TL_REGISTER_FUNC("list", 1, builtin_list);
-    TL_REGISTER_FUNC("fncdef", 0, builtin_fncdef);
-    TL_REGISTER_FUNC("if", 1, builtin_if);
-    TL_REGISTER_FUNC("<", 1, builtin_smaller);
-    TL_REGISTER_FUNC(">", 1, builtin_bigger);
-    TL_REGISTER_FUNC("<=", 1, builtin_smaller_or_equal);
-    TL_REGISTER_FUNC(">=", 1, builtin_bigger_or_equal);
-    TL_REGISTER_FUNC("=", 1, builtin_equal);
-    TL_REGISTER_FUNC("!=", 1, builtin_not_equal);
-    TL_REGISTER_FUNC("-", 1, builtin_substract);
-    TL_REGISTER_FUNC("*", 1, builtin_multiply);
-    TL_REGISTER_FUNC("/", 1, builtin_divide);
-    TL_REGISTER_FUNC("%", 1, builtin_modulo);
-    TL_REGISTER_FUNC("floor", 1, builtin_floor);
-    TL_REGISTER_FUNC("ceil", 1, builtin_ceil);
-    TL_REGISTER_FUNC("parsenum", 1, builtin_parsenum);
-    TL_REGISTER_FUNC("callif", 0, builtin_callif);
-    TL_REGISTER_FUNC("len", 1, builtin_len);
-    TL_REGISTER_FUNC("get", 1, builtin_get);
-    TL_REGISTER_FUNC("strlen", 1, builtin_strlen);
-    TL_REGISTER_FUNC("strget", 1, builtin_strget);
+    TL_REGISTER_FUNC("comment", 0, 1, builtin_comment);
+    TL_REGISTER_FUNC("print", TL_ARGS_ALL, 0, builtin_print);
+    TL_REGISTER_FUNC("printraw", 0, 0, builtin_printraw);
+    TL_REGISTER_FUNC("input", TL_ARGS_ALL, 0, builtin_input);
+    TL_REGISTER_FUNC("+", TL_ARGS_ALL, 1, builtin_add);
+    TL_REGISTER_FUNC("++", TL_ARGS_ALL, 1, builtin_merge);
+    TL_REGISTER_FUNC("params", 0, 1, builtin_params);
+    TL_REGISTER_FUNC("list", TL_ARGS_ALL, 1, builtin_list);
+    TL_REGISTER_FUNC("fncdef", 0, 0, builtin_fncdef);
+    TL_REGISTER_FUNC("if", 1, 1, builtin_if);
+    TL_REGISTER_FUNC("<", TL_ARGS_ALL, 1, builtin_smaller);
+    TL_REGISTER_FUNC(">", TL_ARGS_ALL, 1, builtin_bigger);
+    TL_REGISTER_FUNC("<=", TL_ARGS_ALL, 1, builtin_smaller_or_equal);
+    TL_REGISTER_FUNC(">=", TL_ARGS_ALL, 1, builtin_bigger_or_equal);
+    TL_REGISTER_FUNC("=", TL_ARGS_ALL, 1, builtin_equal);
+    TL_REGISTER_FUNC("!=", TL_ARGS_ALL, 1, builtin_not_equal);
+    TL_REGISTER_FUNC("-", TL_ARGS_ALL, 1, builtin_substract);
+    TL_REGISTER_FUNC("*", TL_ARGS_ALL, 1, builtin_multiply);
+    TL_REGISTER_FUNC("/", TL_ARGS_ALL, 1, builtin_divide);
+    TL_REGISTER_FUNC("%", TL_ARGS_ALL, 1, builtin_modulo);
+    TL_REGISTER_FUNC("floor", TL_ARGS_ALL, 1, builtin_floor);
+    TL_REGISTER_FUNC("ceil", TL_ARGS_ALL, 1, builtin_ceil);
+    TL_REGISTER_FUNC("parsenum", TL_ARGS_ALL, 1, builtin_parsenum);
+    TL_REGISTER_FUNC("callif", 1, 0, builtin_callif);
+    TL_REGISTER_FUNC("while", 0, 0, builtin_while);
+    TL_REGISTER_FUNC("repeat", 0, 0, builtin_repeat);
+    TL_REGISTER_FUNC("for", 0, 0, builtin_for);
+    TL_REGISTER_FUNC("range", TL_ARGS_ALL, 1, builtin_range);
+    TL_REGISTER_FUNC("iterate", 0, 1, builtin_iterate);
+    TL_REGISTER_FUNC("stream-map", 0, 1, builtin_stream_map);
+    TL_REGISTER_FUNC("stream-filter", 0, 1, builtin_stream_filter);
+    TL_REGISTER_FUNC("list-map", 0, 0, builtin_map);
+    TL_REGISTER_FUNC("list-filter", 0, 0, builtin_filter);
+    TL_REGISTER_FUNC("reduce", 0, 0, builtin_reduce);
+    TL_REGISTER_FUNC("take", 0, 0, builtin_take);
+    TL_REGISTER_FUNC("drop", 0, 1, builtin_drop);
+    TL_REGISTER_FUNC("memo-persist", TL_ARGS_ALL, 0, builtin_memo_persist);
+    TL_REGISTER_FUNC("len", TL_ARGS_ALL, 1, builtin_len);
+    TL_REGISTER_FUNC("get", TL_ARGS_ALL, 1, builtin_get);
+    TL_REGISTER_FUNC("strlen", TL_ARGS_ALL, 1, builtin_strlen);
+    TL_REGISTER_FUNC("strget", TL_ARGS_ALL, 1, builtin_strget);
     /* TODO: numstr: Convert float to string. */
-    /* TODO: head and tail */
+    TL_REGISTER_FUNC("head", TL_ARGS_ALL, 1, builtin_head);
+    TL_REGISTER_FUNC("tail", TL_ARGS_ALL, 1, builtin_tail);
+    TL_REGISTER_FUNC("slice", TL_ARGS_ALL, 1, builtin_slice);
+    TL_REGISTER_FUNC("substr", TL_ARGS_ALL, 1, builtin_substr);
     return TL_SUCCESS;
 }
 
 int builtin_comment(void *_lisp, void *_node, size_t argnum, void *_returned) {
+    LizyLang *lisp = _lisp;
     int rc;
-    TL_UNUSED(_lisp);
     TL_UNUSED(_node);
     TL_UNUSED(argnum);
-    TL_UNUSED(_returned);
-    rc = var_str(_returned, "", 0);
+    rc = var_str(&lisp->alloc, _returned, "", 0);
     if(rc) return rc;
     return TL_SUCCESS;
 }
@@ -128,33 +165,34 @@ int builtin_strdef(void *_lisp, void *_node, size_t argnum, void *_returned) {
     if(rc) return rc;
     rc = call_get_arg(lisp, node, 1, &value, 1);
     if(rc){
-        var_free(&value);
+        var_free(&lisp->alloc, &varname);
         return rc;
     }
-    if(varname.type != TL_T_NAME) return TL_ERR_BAD_TYPE;
-    if(VAR_LEN(&varname) != 1) return TL_ERR_INVALID_LIST_SIZE;
-    if(value.type != TL_T_STR) return TL_ERR_BAD_TYPE;
-    rc = var_raw_str(&name, VAR_STR_DATA(VAR_GET_ITEM(&varname, 0)),
-                     VAR_STR_LEN(VAR_GET_ITEM(&varname, 0)));
-    var_free(&varname);
+    if(varname.type != TL_T_NAME) rc = TL_ERR_BAD_TYPE;
+    else if(VAR_LEN(&varname) != 1) rc = TL_ERR_INVALID_LIST_SIZE;
+    else if(value.type != TL_T_STR) rc = TL_ERR_BAD_TYPE;
     if(rc){
-        var_free(&value);
-        free(name.data);
+        var_free(&lisp->alloc, &varname);
+        var_free(&lisp->alloc, &value);
         return rc;
     }
-    rc = tl_add_var(lisp, &value, &name);
+    rc = var_raw_str(&lisp->alloc, &name,
+                     VAR_STR_DATA(VAR_GET_ITEM(&varname, 0)),
+                     VAR_STR_LEN(VAR_GET_ITEM(&varname, 0)));
+    var_free(&lisp->alloc, &varname);
     if(rc){
-        var_free(&value);
-        free(name.data);
+        var_free(&lisp->alloc, &value);
+        var_free_str(&lisp->alloc, &name);
         return rc;
     }
-    rc = var_copy(&value, _returned);
+    rc = tl_add_var(lisp, &value, &name);
     if(rc){
-        var_free(&value);
-        free(name.data);
+        var_free(&lisp->alloc, &value);
+        var_free_str(&lisp->alloc, &name);
         return rc;
     }
-    return TL_SUCCESS;
+    /* value and name now belong to the variable, they are freed with it. */
+    return var_copy(&lisp->alloc, &value, _returned);
 }
 
 int builtin_numdef(void *_lisp, void *_node, size_t argnum, void *_returned) {
@@ -171,72 +209,90 @@ int builtin_numdef(void *_lisp, void *_node, size_t argnum, void *_returned) {
     if(rc) return rc;
     rc = call_get_arg(lisp, node, 1, &value, 1);
     if(rc){
-        var_free(&value);
+        var_free(&lisp->alloc, &varname);
         return rc;
     }
-    if(varname.type != TL_T_NAME) return TL_ERR_BAD_TYPE;
-    if(VAR_LEN(&varname) != 1) return TL_ERR_INVALID_LIST_SIZE;
-    if(value.type != TL_T_NUM) return TL_ERR_BAD_TYPE;
-    rc = var_raw_str(&name, VAR_STR_DATA(VAR_GET_ITEM(&varname, 0)),
-                     VAR_STR_LEN(VAR_GET_ITEM(&varname, 0)));
-    var_free(&varname);
+    if(varname.type != TL_T_NAME) rc = TL_ERR_BAD_TYPE;
+    else if(VAR_LEN(&varname) != 1) rc = TL_ERR_INVALID_LIST_SIZE;
+    else if(value.type != TL_T_NUM) rc = TL_ERR_BAD_TYPE;
     if(rc){
-        var_free(&value);
-        free(name.data);
+        var_free(&lisp->alloc, &varname);
+        var_free(&lisp->alloc, &value);
         return rc;
     }
-    rc = tl_add_var(lisp, &value, &name);
+    rc = var_raw_str(&lisp->alloc, &name,
+                     VAR_STR_DATA(VAR_GET_ITEM(&varname, 0)),
+                     VAR_STR_LEN(VAR_GET_ITEM(&varname, 0)));
+    var_free(&lisp->alloc, &varname);
     if(rc){
-        var_free(&value);
-        free(name.data);
+        var_free(&lisp->alloc, &value);
+        var_free_str(&lisp->alloc, &name);
         return rc;
     }
-    rc = var_copy(&value, _returned);
+    rc = tl_add_var(lisp, &value, &name);
     if(rc){
-        var_free(&value);
-        free(name.data);
+        var_free(&lisp->alloc, &value);
+        var_free_str(&lisp->alloc, &name);
         return rc;
     }
-    return TL_SUCCESS;
+    /* value and name now belong to the variable, they are freed with it. */
+    return var_copy(&lisp->alloc, &value, _returned);
 }
 
 int builtin_set(void *_lisp, void *_node, size_t argnum, void *_returned) {
     LizyLang *lisp = _lisp;
-    Var *args = NULL; /* TODO: Fix required! */
+    Node *node = _node;
+    Var varname;
     Var value;
     int rc;
-    TL_UNUSED(_node);
     if(argnum < 2) return TL_ERR_TOO_FEW_ARGS;
     else if(argnum > 2) return TL_ERR_TOO_MANY_ARGS;
-    if(args[0].type != TL_T_NAME) return TL_ERR_BAD_TYPE;
-    if(VAR_LEN(args) != 1) return TL_ERR_INVALID_LIST_SIZE;
-    rc = call_parse_arg(lisp, args+1, &value, lisp->stack_cur);
+    rc = call_get_arg(lisp, node, 0, &varname, 0);
     if(rc) return rc;
-    rc = tl_set_var(lisp, &value, &args->items->string);
+    if(varname.type != TL_T_NAME){
+        var_free(&lisp->alloc, &varname);
+        return TL_ERR_BAD_TYPE;
+    }
+    if(VAR_LEN(&varname) != 1){
+        var_free(&lisp->alloc, &varname);
+        return TL_ERR_INVALID_LIST_SIZE;
+    }
+    rc = call_get_arg(lisp, node, 1, &value, 1);
     if(rc){
-        var_free(&value);
+        var_free(&lisp->alloc, &varname);
         return rc;
     }
-    rc = var_free(&value);
+    rc = tl_set_var(lisp, &value, &varname.items->string);
+    var_free(&lisp->alloc, &varname);
+    var_free(&lisp->alloc, &value);
     if(rc) return rc;
-    rc = var_num_from_float(_returned, 0);
+    rc = var_num_from_float(&lisp->alloc, _returned, 0);
     return rc;
 }
 
 int builtin_del(void *_lisp, void *_node, size_t argnum,  void *_returned) {
     LizyLang *lisp = _lisp;
-    Var *args = NULL; /* TODO: Fix required! */
+    Node *node = _node;
+    Var varname;
     int rc;
-    TL_UNUSED(_node);
     if(argnum < 1) return TL_ERR_TOO_FEW_ARGS;
     else if(argnum > 1) return TL_ERR_TOO_MANY_ARGS;
-    if(args[0].type != TL_T_NAME) return TL_ERR_BAD_TYPE;
-    if(VAR_LEN(args) != 1) return TL_ERR_INVALID_LIST_SIZE;
-    rc = tl_del_var(lisp, &args->items->string);
+    rc = call_get_arg(lisp, node, 0, &varname, 0);
+    if(rc) return rc;
+    if(varname.type != TL_T_NAME){
+        var_free(&lisp->alloc, &varname);
+        return TL_ERR_BAD_TYPE;
+    }
+    if(VAR_LEN(&varname) != 1){
+        var_free(&lisp->alloc, &varname);
+        return TL_ERR_INVALID_LIST_SIZE;
+    }
+    rc = tl_del_var(lisp, &varname.items->string);
+    var_free(&lisp->alloc, &varname);
     if(rc){
         return rc;
     }
-    rc = var_num_from_float(_returned, 0);
+    rc = var_num_from_float(&lisp->alloc, _returned, 0);
     return rc;
 }
 
@@ -252,7 +308,7 @@ int builtin_print(void *_lisp, void *_node, size_t argnum, void *_returned) {
     if(rc) return rc;
     if(VAR_LEN(&data) < 1){
         puts("()");
-        var_free(&data);
+        var_free(&lisp->alloc, &data);
         return TL_SUCCESS;
     }
     if(VAR_LEN(&data) > 1) fputc('(', stdout);
@@ -260,25 +316,25 @@ int builtin_print(void *_lisp, void *_node, size_t argnum, void *_returned) {
         switch(data.type){
             case TL_T_STR:
                 if(VAR_LEN(&data) > 1) fputc('"', stdout);
-                fwrite(VAR_STR_DATA(VAR_GET_ITEM(&data, i)), 1,
-                       VAR_STR_LEN(VAR_GET_ITEM(&data, i)), stdout);
+                fwrite(VAR_STR_AT(&data, i), 1, VAR_STR_LEN_AT(&data, i),
+                       stdout);
                 if(VAR_LEN(&data) > 1) fputc('"', stdout);
                 if(i < VAR_LEN(&data)-1) fputc(' ', stdout);
                 break;
             case TL_T_NUM:
                 /* TODO: Custom number conversion function. */
-                printf("%f", VAR_NUM(VAR_GET_ITEM(&data, i)));
+                printf("%f", VAR_NUM_AT(&data, i));
                 if(i < VAR_LEN(&data)-1) fputc(' ', stdout);
                 break;
             default:
-                var_free(&data);
+                var_free(&lisp->alloc, &data);
                 return TL_ERR_BAD_TYPE;
         }
     }
     if(VAR_LEN(&data) > 1) fputc(')', stdout);
     fputc('\n', stdout);
-    rc = var_copy(&data, _returned);
-    var_free(&data);
+    rc = var_copy(&lisp->alloc, &data, _returned);
+    var_free(&lisp->alloc, &data);
     if(rc) return rc;
     return TL_SUCCESS;
 }
@@ -298,7 +354,7 @@ int builtin_printraw(void *_lisp, void *_node, size_t argnum,
     if(rc) return rc;
     if(VAR_LEN(&data) < 1){
         puts("()");
-        var_free(&data);
+        var_free(&lisp->alloc, &data);
         return TL_SUCCESS;
     }
     if(VAR_LEN(&data) > 1) fputc('(', stdout);
@@ -306,8 +362,8 @@ int builtin_printraw(void *_lisp, void *_node, size_t argnum,
         switch(data.type){
             case TL_T_STR:
                 if(VAR_LEN(&data) > 1) fputc('"', stdout);
-                fwrite(VAR_STR_DATA(VAR_GET_ITEM(&data, i)), 1,
-                       VAR_STR_LEN(VAR_GET_ITEM(&data, i)), stdout);
+                fwrite(VAR_STR_AT(&data, i), 1, VAR_STR_LEN_AT(&data, i),
+                       stdout);
                 if(VAR_LEN(&data) > 1) fputc('"', stdout);
                 if(i < VAR_LEN(&data)-1) fputc(' ', stdout);
                 break;
@@ -320,18 +376,18 @@ int builtin_printraw(void *_lisp, void *_node, size_t argnum,
                 break;
             case TL_T_NUM:
                 /* TODO: Custom number conversion function. */
-                printf("%f", VAR_NUM(VAR_GET_ITEM(&data, i)));
+                printf("%f", VAR_NUM_AT(&data, i));
                 if(i < VAR_LEN(&data)-1) fputc(' ', stdout);
                 break;
             default:
-                var_free(&data);
+                var_free(&lisp->alloc, &data);
                 return TL_ERR_BAD_TYPE;
         }
     }
     if(VAR_LEN(&data) > 1) fputc(')', stdout);
     fputc('\n', stdout);
-    rc = var_copy(&data, _returned);
-    var_free(&data);
+    rc = var_copy(&lisp->alloc, &data, _returned);
+    var_free(&lisp->alloc, &data);
     if(rc) return rc;
     return TL_SUCCESS;
 }
@@ -347,24 +403,24 @@ int builtin_input(void *_lisp, void *_node, size_t argnum, void *_returned) {
     rc = call_get_arg(lisp, node, 0, &str, 1);
     if(rc) return rc;
     if(str.type != TL_T_STR){
-        var_free(&str);
+        var_free(&lisp->alloc, &str);
         return TL_ERR_BAD_TYPE;
     }
     if(VAR_LEN(&str) != 1){
-        var_free(&str);
+        var_free(&lisp->alloc, &str);
         return TL_ERR_INVALID_LIST_SIZE;
     }
     fwrite(VAR_STR_DATA(VAR_GET_ITEM(&str, 0)), 1,
            VAR_STR_LEN(VAR_GET_ITEM(&str, 0)), stdout);
-    var_str(_returned, "", 0);
+    var_str(&lisp->alloc, _returned, "", 0);
     while((c = getc(stdin)) != '\n'){
-        rc = var_str_add(_returned, &c, 1);
+        rc = var_str_add(&lisp->alloc, _returned, &c, 1);
         if(rc){
-            var_free(&str);
+            var_free(&lisp->alloc, &str);
             return rc;
         }
     }
-    var_free(&str);
+    var_free(&lisp->alloc, &str);
     return TL_SUCCESS;
 }
 
@@ -380,56 +436,67 @@ int builtin_add(void *_lisp, void *_node, size_t argnum, void *_returned) {
     if(rc) return rc;
     rc = call_get_arg(lisp, node, 1, &b, 1);
     if(rc){
-        var_free(&a);
+        var_free(&lisp->alloc, &a);
         return rc;
     }
     else if(a.type != b.type){
-        var_free(&a);
-        var_free(&b);
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_BAD_TYPE;
     }
     if(VAR_LEN(&a) != 1){
-        var_free(&a);
-        var_free(&b);
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_INVALID_LIST_SIZE;
     }
     if(VAR_LEN(&b) != 1){
-        var_free(&a);
-        var_free(&b);
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_INVALID_LIST_SIZE;
     }
     switch(a.type){
         case TL_T_STR:
-            rc = var_str_concat(_returned, &a, &b);
-            var_free(&a);
-            var_free(&b);
+            rc = var_str_concat(&lisp->alloc, _returned, &a, &b);
+            var_free(&lisp->alloc, &a);
+            var_free(&lisp->alloc, &b);
             if(rc) return rc;
             break;
         case TL_T_NUM:
-            rc = var_num_from_float(_returned, VAR_NUM(VAR_GET_ITEM(&a, 0))+
+            rc = var_num_from_float(&lisp->alloc, _returned,
+                                    VAR_NUM(VAR_GET_ITEM(&a, 0))+
                                     VAR_NUM(VAR_GET_ITEM(&b, 0)));
-            var_free(&a);
-            var_free(&b);
+            var_free(&lisp->alloc, &a);
+            var_free(&lisp->alloc, &b);
             if(rc) return rc;
             break;
         default:
-            var_free(&a);
-            var_free(&b);
+            var_free(&lisp->alloc, &a);
+            var_free(&lisp->alloc, &b);
             return TL_ERR_BAD_TYPE;
     }
     return TL_SUCCESS;
 }
 
 int builtin_merge(void *_lisp, void *_node, size_t argnum, void *_returned) {
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
     int rc;
-    Var *args = NULL; /* TODO: Fix required! */
-    TL_UNUSED(_lisp);
+    Var list;
     if(argnum < 2) return TL_ERR_TOO_FEW_ARGS;
     else if(argnum > 2) return TL_ERR_TOO_MANY_ARGS;
-    rc = var_copy(args, _returned);
-    if(rc) return rc;
-    rc = var_append(args+1, _returned);
+    rc = call_get_arg(lisp, node, 0, _returned, 1);
     if(rc) return rc;
+    rc = call_get_arg(lisp, node, 1, &list, 1);
+    if(rc){
+        var_free(&lisp->alloc, _returned);
+        return rc;
+    }
+    rc = var_append(&lisp->alloc, &list, _returned);
+    var_free(&lisp->alloc, &list);
+    if(rc){
+        var_free(&lisp->alloc, _returned);
+        return rc;
+    }
     return TL_SUCCESS;
 }
 
@@ -441,6 +508,9 @@ int builtin_params(void *_lisp, void *_node, size_t argnum, void *_returned) {
     size_t i;
     if(!argnum){
         ((Var*)_returned)->null = 0;
+        ((Var*)_returned)->ref = 0;
+        ((Var*)_returned)->storage = TL_S_ITEMS;
+        ((Var*)_returned)->base = NULL;
         ((Var*)_returned)->size = 0;
         ((Var*)_returned)->items = NULL;
         ((Var*)_returned)->type = TL_T_NAME;
@@ -451,13 +521,13 @@ int builtin_params(void *_lisp, void *_node, size_t argnum, void *_returned) {
     for(i=1;i<argnum;i++){
         rc = call_get_arg(lisp, node, i, &param, 0);
         if(rc){
-            var_free(_returned);
+            var_free(&lisp->alloc, _returned);
             return rc;
         }
-        rc = var_append(&param, _returned);
-        var_free(&param);
+        rc = var_append(&lisp->alloc, &param, _returned);
+        var_free(&lisp->alloc, &param);
         if(rc){
-            var_free(_returned);
+            var_free(&lisp->alloc, _returned);
             return rc;
         }
     }
@@ -465,24 +535,33 @@ int builtin_params(void *_lisp, void *_node, size_t argnum, void *_returned) {
 }
 
 int builtin_list(void *_lisp, void *_node, size_t argnum, void *_returned) {
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
     int rc;
-    Var *args = NULL; /* TODO: Fix required! */
+    Var item;
     size_t i;
-    TL_UNUSED(_lisp);
-    TL_UNUSED(_node);
     if(!argnum){
         ((Var*)_returned)->null = 0;
+        ((Var*)_returned)->ref = 0;
+        ((Var*)_returned)->storage = TL_S_ITEMS;
+        ((Var*)_returned)->base = NULL;
         ((Var*)_returned)->size = 0;
         ((Var*)_returned)->items = NULL;
         ((Var*)_returned)->type = TL_T_NUM;
         return TL_SUCCESS;
     }
-    rc = var_copy(args, _returned);
+    rc = call_get_arg(lisp, node, 0, _returned, 1);
     if(rc) return rc;
     for(i=1;i<argnum;i++){
-        rc = var_append(args+i, _returned);
+        rc = call_get_arg(lisp, node, i, &item, 1);
         if(rc){
-            var_free(_returned);
+            var_free(&lisp->alloc, _returned);
+            return rc;
+        }
+        rc = var_append(&lisp->alloc, &item, _returned);
+        var_free(&lisp->alloc, &item);
+        if(rc){
+            var_free(&lisp->alloc, _returned);
             return rc;
         }
     }
@@ -498,6 +577,7 @@ int builtin_fncdef(void *_lisp, void *_node, size_t argnum, void *_returned) {
     Var fncname;
     Var params;
     Var *raw;
+    Node *names;
     String name;
     if(argnum < 3) return TL_ERR_TOO_FEW_ARGS;
     for(i=2;i<argnum;i++){
@@ -510,225 +590,349 @@ int builtin_fncdef(void *_lisp, void *_node, size_t argnum, void *_returned) {
     if(rc) return rc;
     rc = call_get_arg(lisp, node, 1, &params, 0);
     if(rc){
-        var_free(&fncname);
+        var_free(&lisp->alloc, &fncname);
         return rc;
     }
     if(VAR_LEN(&fncname) != 1){
-        var_free(&fncname);
-        var_free(&params);
+        var_free(&lisp->alloc, &fncname);
+        var_free(&lisp->alloc, &params);
         return TL_ERR_INVALID_LIST_SIZE;
     }
-    rc = var_user_func(&function, node, &params);
+    rc = var_user_func(&lisp->alloc, &function, node, &params);
     if(rc){
-        var_free(&fncname);
-        var_free(&params);
+        var_free(&lisp->alloc, &fncname);
+        var_free(&lisp->alloc, &params);
         return rc;
     }
-    rc = var_raw_str(&name, VAR_STR_DATA(VAR_GET_ITEM(&fncname, 0)),
+    /* The optimiser gives an expression to the parameters it added. */
+    names = ((Node**)node->childs)[1];
+    for(i=0;i<names->childnum;i++){
+        if(((Node**)names->childs)[i]->childnum){
+            function.items->function.lets++;
+        }
+    }
+    function.items->function.strict = call_strict_params(lisp, node,
+                                                         &params);
+    /* The results of a pure function that uses all of its arguments can be
+     * cached, as they can be evaluated before calling it. */
+    function.items->function.pure = call_pure_func(lisp, node, &params,
+                                                   &VAR_GET_ITEM(&fncname,
+                                                                 0).string);
+    i = VAR_LEN(&params)-function.items->function.lets;
+    function.items->function.memo = function.items->function.pure &&
+                                    i <= TL_STRICT_MAX &&
+                                    function.items->function.strict ==
+                                    (unsigned short)((1UL<<i)-1);
+    if(function.items->function.pure){
+        /* Remember its code, to find the results saved for it. */
+        rc = memo_add_func(lisp, node);
+        if(rc){
+            var_free(&lisp->alloc, &function);
+            var_free(&lisp->alloc, &fncname);
+            var_free(&lisp->alloc, &params);
+            return rc;
+        }
+    }
+    rc = var_raw_str(&lisp->alloc, &name,
+                     VAR_STR_DATA(VAR_GET_ITEM(&fncname, 0)),
                      VAR_STR_LEN(VAR_GET_ITEM(&fncname, 0)));
     if(rc){
-        var_free(&function);
-        var_free(&fncname);
-        var_free(&params);
-        free(name.data);
+        var_free(&lisp->alloc, &function);
+        var_free(&lisp->alloc, &fncname);
+        var_free(&lisp->alloc, &params);
+        var_free_str(&lisp->alloc, &name);
         return rc;
     }
     rc = tl_add_var(lisp, &function, &name);
     if(rc){
-        var_free(&function);
-        var_free(&fncname);
-        var_free(&params);
-        free(name.data);
+        var_free(&lisp->alloc, &function);
+        var_free(&lisp->alloc, &fncname);
+        var_free(&lisp->alloc, &params);
+        var_free_str(&lisp->alloc, &name);
         return rc;
     }
     /* TODO: Store calls. */
-    var_free(&fncname);
-    var_free(&params);
-    rc = var_num_from_float(_returned, 0);
+    var_free(&lisp->alloc, &fncname);
+    var_free(&lisp->alloc, &params);
+    rc = var_num_from_float(&lisp->alloc, _returned, 0);
     return rc;
 }
 
+int builtin_memo_persist(void *_lisp, void *_node, size_t argnum,
+                         void *_returned) {
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
+    Var path;
+    int rc;
+    if(argnum < 1) return TL_ERR_TOO_FEW_ARGS;
+    else if(argnum > 1) return TL_ERR_TOO_MANY_ARGS;
+    rc = call_get_arg(lisp, node, 0, &path, 1);
+    if(rc) return rc;
+    if(path.type != TL_T_STR){
+        var_free(&lisp->alloc, &path);
+        return TL_ERR_BAD_TYPE;
+    }
+    if(VAR_LEN(&path) != 1){
+        var_free(&lisp->alloc, &path);
+        return TL_ERR_INVALID_LIST_SIZE;
+    }
+    /* The results are loaded now and saved when the interpreter is freed. */
+    rc = memo_load(lisp, VAR_STR_AT(&path, 0), VAR_STR_LEN_AT(&path, 0));
+    var_free(&lisp->alloc, &path);
+    if(rc) return rc;
+    return var_num_from_float(&lisp->alloc, _returned, 0);
+}
+
 int builtin_if(void *_lisp, void *_node, size_t argnum, void *_returned) {
+    LizyLang *lisp = _lisp;
     Var condition;
     int rc;
-    TL_UNUSED(_lisp);
     if(argnum < 3) return TL_ERR_TOO_FEW_ARGS;
     else if(argnum > 3) return TL_ERR_TOO_MANY_ARGS;
     rc = call_get_arg(_lisp, _node, 0, &condition, 1);
     if(rc) return rc;
     if(VAR_LEN(&condition) != 1){
-        var_free(&condition);
+        var_free(&lisp->alloc, &condition);
         return TL_ERR_INVALID_LIST_SIZE;
     }
     if(condition.type != TL_T_NUM){
-        var_free(&condition);
+        var_free(&lisp->alloc, &condition);
         return TL_ERR_BAD_TYPE;
     }
+    /* The branch that is taken returns the value of the if. */
     if(condition.items->num != 0){
-        rc = call_get_arg(_lisp, _node, 1, _returned, 1);
-        var_free(&condition);
+        rc = call_return_arg(_lisp, _node, 1, _returned);
+        var_free(&lisp->alloc, &condition);
         return rc;
     }
-    rc = call_get_arg(_lisp, _node, 2, _returned, 1);
-    var_free(&condition);
+    rc = call_return_arg(_lisp, _node, 2, _returned);
+    var_free(&lisp->alloc, &condition);
     return rc;
 }
 
 int builtin_smaller(void *_lisp, void *_node, size_t argnum, void *_returned) {
-    Var *args = NULL; /* TODO: Fix required! */
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
     int rc;
-    TL_UNUSED(_lisp);
+    Var a;
+    Var b;
     if(argnum < 2) return TL_ERR_TOO_FEW_ARGS;
     else if(argnum > 2) return TL_ERR_TOO_MANY_ARGS;
-    if(VAR_LEN(args) != 1 || VAR_LEN(args+1) != 1){
+    rc = call_get_arg(lisp, node, 0, &a, 1);
+    if(rc) return rc;
+    rc = call_get_arg(lisp, node, 1, &b, 1);
+    if(rc){
+        var_free(&lisp->alloc, &a);
+        return rc;
+    }
+    if(VAR_LEN(&a) != 1 || VAR_LEN(&b) != 1){
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_INVALID_LIST_SIZE;
     }
-    if(args[0].type != TL_T_NUM || args[1].type != TL_T_NUM){
+    if(a.type != TL_T_NUM || b.type != TL_T_NUM){
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_BAD_TYPE;
     }
-    if(args[0].items->num < args[1].items->num){
-        rc = var_num_from_float(_returned, 1);
-        return rc;
-    }
-    rc = var_num_from_float(_returned, 0);
+    rc = var_num_from_float(&lisp->alloc, _returned,
+                            a.items->num < b.items->num);
+    var_free(&lisp->alloc, &a);
+    var_free(&lisp->alloc, &b);
     return rc;
 }
 
 int builtin_bigger(void *_lisp, void *_node, size_t argnum, void *_returned) {
-    Var *args = NULL; /* TODO: Fix required! */
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
     int rc;
-    TL_UNUSED(_lisp);
+    Var a;
+    Var b;
     if(argnum < 2) return TL_ERR_TOO_FEW_ARGS;
     else if(argnum > 2) return TL_ERR_TOO_MANY_ARGS;
-    if(VAR_LEN(args) != 1 || VAR_LEN(args+1) != 1){
+    rc = call_get_arg(lisp, node, 0, &a, 1);
+    if(rc) return rc;
+    rc = call_get_arg(lisp, node, 1, &b, 1);
+    if(rc){
+        var_free(&lisp->alloc, &a);
+        return rc;
+    }
+    if(VAR_LEN(&a) != 1 || VAR_LEN(&b) != 1){
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_INVALID_LIST_SIZE;
     }
-    if(args[0].type != TL_T_NUM || args[1].type != TL_T_NUM){
+    if(a.type != TL_T_NUM || b.type != TL_T_NUM){
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_BAD_TYPE;
     }
-    if(args[0].items->num > args[1].items->num){
-        rc = var_num_from_float(_returned, 1);
-        return rc;
-    }
-    rc = var_num_from_float(_returned, 0);
+    rc = var_num_from_float(&lisp->alloc, _returned,
+                            a.items->num > b.items->num);
+    var_free(&lisp->alloc, &a);
+    var_free(&lisp->alloc, &b);
     return rc;
 }
 
 int builtin_smaller_or_equal(void *_lisp, void *_node, size_t argnum,
                              void *_returned) {
-    Var *args = NULL; /* TODO: Fix required! */
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
     int rc;
-    TL_UNUSED(_lisp);
+    Var a;
+    Var b;
     if(argnum < 2) return TL_ERR_TOO_FEW_ARGS;
     else if(argnum > 2) return TL_ERR_TOO_MANY_ARGS;
-    if(VAR_LEN(args) != 1 || VAR_LEN(args+1) != 1){
+    rc = call_get_arg(lisp, node, 0, &a, 1);
+    if(rc) return rc;
+    rc = call_get_arg(lisp, node, 1, &b, 1);
+    if(rc){
+        var_free(&lisp->alloc, &a);
+        return rc;
+    }
+    if(VAR_LEN(&a) != 1 || VAR_LEN(&b) != 1){
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_INVALID_LIST_SIZE;
     }
-    if(args[0].type != TL_T_NUM || args[1].type != TL_T_NUM){
+    if(a.type != TL_T_NUM || b.type != TL_T_NUM){
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_BAD_TYPE;
     }
-    if(args[0].items->num <= args[1].items->num){
-        rc = var_num_from_float(_returned, 1);
-        return rc;
-    }
-    rc = var_num_from_float(_returned, 0);
+    rc = var_num_from_float(&lisp->alloc, _returned,
+                            a.items->num <= b.items->num);
+    var_free(&lisp->alloc, &a);
+    var_free(&lisp->alloc, &b);
     return rc;
 }
 
 int builtin_bigger_or_equal(void *_lisp, void *_node, size_t argnum,
                             void *_returned) {
-    Var *args = NULL; /* TODO: Fix required! */
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
     int rc;
-    TL_UNUSED(_lisp);
+    Var a;
+    Var b;
     if(argnum < 2) return TL_ERR_TOO_FEW_ARGS;
     else if(argnum > 2) return TL_ERR_TOO_MANY_ARGS;
-    if(VAR_LEN(args) != 1 || VAR_LEN(args+1) != 1){
+    rc = call_get_arg(lisp, node, 0, &a, 1);
+    if(rc) return rc;
+    rc = call_get_arg(lisp, node, 1, &b, 1);
+    if(rc){
+        var_free(&lisp->alloc, &a);
+        return rc;
+    }
+    if(VAR_LEN(&a) != 1 || VAR_LEN(&b) != 1){
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_INVALID_LIST_SIZE;
     }
-    if(args[0].type != TL_T_NUM || args[1].type != TL_T_NUM){
+    if(a.type != TL_T_NUM || b.type != TL_T_NUM){
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_BAD_TYPE;
     }
-    if(args[0].items->num >= args[1].items->num){
-        rc = var_num_from_float(_returned, 1);
-        return rc;
-    }
-    rc = var_num_from_float(_returned, 0);
+    rc = var_num_from_float(&lisp->alloc, _returned,
+                            a.items->num >= b.items->num);
+    var_free(&lisp->alloc, &a);
+    var_free(&lisp->alloc, &b);
     return rc;
 }
 
 int builtin_equal(void *_lisp, void *_node, size_t argnum, void *_returned) {
-    Var *args = NULL; /* TODO: Fix required! */
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
     int rc;
-    TL_UNUSED(_lisp);
+    char equal;
+    Var a;
+    Var b;
     if(argnum < 2) return TL_ERR_TOO_FEW_ARGS;
     else if(argnum > 2) return TL_ERR_TOO_MANY_ARGS;
-    if(VAR_LEN(args) != 1 || VAR_LEN(args+1) != 1){
+    rc = call_get_arg(lisp, node, 0, &a, 1);
+    if(rc) return rc;
+    rc = call_get_arg(lisp, node, 1, &b, 1);
+    if(rc){
+        var_free(&lisp->alloc, &a);
+        return rc;
+    }
+    if(VAR_LEN(&a) != 1 || VAR_LEN(&b) != 1){
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_INVALID_LIST_SIZE;
     }
-    if(args[0].type != args[1].type){
+    if(a.type != b.type){
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_BAD_TYPE;
     }
-    switch(args[0].type){
+    switch(a.type){
         case TL_T_STR:
-            if(args[0].items->string.len == args[1].items->string.len){
-                if(!memcmp(args[0].items->string.data,
-                           args[1].items->string.data,
-                           args[0].items->string.len)){
-                    rc = var_num_from_float(_returned, 1);
-                    return rc;
-                }
-            }
-            rc = var_num_from_float(_returned, 0);
-            return rc;
+            equal = a.items->string.len == b.items->string.len &&
+                    !memcmp(VAR_STR_DATA(VAR_GET_ITEM(&a, 0)),
+                            VAR_STR_DATA(VAR_GET_ITEM(&b, 0)),
+                            a.items->string.len);
+            break;
         case TL_T_NUM:
-            if(args[0].items->num == args[1].items->num){
-                rc = var_num_from_float(_returned, 1);
-                return rc;
-            }
-            rc = var_num_from_float(_returned, 0);
-            return rc;
+            equal = a.items->num == b.items->num;
+            break;
         default:
+            var_free(&lisp->alloc, &a);
+            var_free(&lisp->alloc, &b);
             return TL_ERR_BAD_TYPE;
     }
-    return TL_SUCCESS;
+    var_free(&lisp->alloc, &a);
+    var_free(&lisp->alloc, &b);
+    rc = var_num_from_float(&lisp->alloc, _returned, equal);
+    return rc;
 }
 
 int builtin_not_equal(void *_lisp, void *_node, size_t argnum,
                       void *_returned) {
-    Var *args = NULL; /* TODO: Fix required! */
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
     int rc;
-    TL_UNUSED(_lisp);
+    char equal;
+    Var a;
+    Var b;
     if(argnum < 2) return TL_ERR_TOO_FEW_ARGS;
     else if(argnum > 2) return TL_ERR_TOO_MANY_ARGS;
-    if(VAR_LEN(args) != 1 || VAR_LEN(args+1) != 1){
+    rc = call_get_arg(lisp, node, 0, &a, 1);
+    if(rc) return rc;
+    rc = call_get_arg(lisp, node, 1, &b, 1);
+    if(rc){
+        var_free(&lisp->alloc, &a);
+        return rc;
+    }
+    if(VAR_LEN(&a) != 1 || VAR_LEN(&b) != 1){
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_INVALID_LIST_SIZE;
     }
-    if(args[0].type != args[1].type){
+    if(a.type != b.type){
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_BAD_TYPE;
     }
-    switch(args[0].type){
+    switch(a.type){
         case TL_T_STR:
-            if(args[0].items->string.len == args[1].items->string.len){
-                if(!memcmp(args[0].items->string.data,
-                           args[1].items->string.data,
-                           args[0].items->string.len)){
-                    rc = var_num_from_float(_returned, 0);
-                    return rc;
-                }
-            }
-            rc = var_num_from_float(_returned, 1);
-            return rc;
+            equal = a.items->string.len == b.items->string.len &&
+                    !memcmp(VAR_STR_DATA(VAR_GET_ITEM(&a, 0)),
+                            VAR_STR_DATA(VAR_GET_ITEM(&b, 0)),
+                            a.items->string.len);
+            break;
         case TL_T_NUM:
-            if(args[0].items->num == args[1].items->num){
-                rc = var_num_from_float(_returned, 0);
-                return rc;
-            }
-            rc = var_num_from_float(_returned, 1);
-            return rc;
+            equal = a.items->num == b.items->num;
+            break;
         default:
+            var_free(&lisp->alloc, &a);
+            var_free(&lisp->alloc, &b);
             return TL_ERR_BAD_TYPE;
     }
-    return TL_SUCCESS;
+    var_free(&lisp->alloc, &a);
+    var_free(&lisp->alloc, &b);
+    rc = var_num_from_float(&lisp->alloc, _returned, !equal);
+    return rc;
 }
 
 int builtin_substract(void *_lisp, void *_node, size_t argnum,
@@ -744,208 +948,728 @@ int builtin_substract(void *_lisp, void *_node, size_t argnum,
     if(rc) return rc;
     rc = call_get_arg(lisp, node, 1, &b, 1);
     if(rc){
-        var_free(&a);
+        var_free(&lisp->alloc, &a);
         return rc;
     }
     if(VAR_LEN(&a) != 1 || VAR_LEN(&b) != 1){
-        var_free(&a);
-        var_free(&b);
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_INVALID_LIST_SIZE;
     }
     if(a.type != TL_T_NUM || b.type != TL_T_NUM){
-        var_free(&a);
-        var_free(&b);
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_BAD_TYPE;
     }
-    rc = var_num_from_float(_returned, a.items->num-b.items->num);
-    var_free(&a);
-    var_free(&b);
+    rc = var_num_from_float(&lisp->alloc, _returned,
+                            a.items->num-b.items->num);
+    var_free(&lisp->alloc, &a);
+    var_free(&lisp->alloc, &b);
     return rc;
 }
 
 int builtin_multiply(void *_lisp, void *_node, size_t argnum,
                      void *_returned) {
-    Var *args = NULL; /* TODO: Fix required! */
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
     int rc;
-    TL_UNUSED(_lisp);
+    Var a;
+    Var b;
     if(argnum < 2) return TL_ERR_TOO_FEW_ARGS;
     else if(argnum > 2) return TL_ERR_TOO_MANY_ARGS;
-    if(VAR_LEN(args) != 1 || VAR_LEN(args+1) != 1){
+    rc = call_get_arg(lisp, node, 0, &a, 1);
+    if(rc) return rc;
+    rc = call_get_arg(lisp, node, 1, &b, 1);
+    if(rc){
+        var_free(&lisp->alloc, &a);
+        return rc;
+    }
+    if(VAR_LEN(&a) != 1 || VAR_LEN(&b) != 1){
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_INVALID_LIST_SIZE;
     }
-    if(args[0].type != TL_T_NUM || args[1].type != TL_T_NUM){
+    if(a.type != TL_T_NUM || b.type != TL_T_NUM){
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_BAD_TYPE;
     }
-    rc = var_num_from_float(_returned, args[0].items->num*args[1].items->num);
+    rc = var_num_from_float(&lisp->alloc, _returned,
+                            a.items->num * b.items->num);
+    var_free(&lisp->alloc, &a);
+    var_free(&lisp->alloc, &b);
     return rc;
 }
 
 int builtin_divide(void *_lisp, void *_node, size_t argnum, void *_returned) {
-    Var *args = NULL; /* TODO: Fix required! */
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
     int rc;
-    TL_UNUSED(_lisp);
+    Var a;
+    Var b;
     if(argnum < 2) return TL_ERR_TOO_FEW_ARGS;
     else if(argnum > 2) return TL_ERR_TOO_MANY_ARGS;
-    if(VAR_LEN(args) != 1 || VAR_LEN(args+1) != 1){
+    rc = call_get_arg(lisp, node, 0, &a, 1);
+    if(rc) return rc;
+    rc = call_get_arg(lisp, node, 1, &b, 1);
+    if(rc){
+        var_free(&lisp->alloc, &a);
+        return rc;
+    }
+    if(VAR_LEN(&a) != 1 || VAR_LEN(&b) != 1){
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_INVALID_LIST_SIZE;
     }
-    if(args[0].type != TL_T_NUM || args[1].type != TL_T_NUM){
+    if(a.type != TL_T_NUM || b.type != TL_T_NUM){
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_BAD_TYPE;
     }
-    if(args[1].items->num == 0){
+    if(b.items->num == 0){
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_DIVISION_BY_ZERO;
     }
-    rc = var_num_from_float(_returned, args[0].items->num/args[1].items->num);
+    rc = var_num_from_float(&lisp->alloc, _returned,
+                            a.items->num/b.items->num);
+    var_free(&lisp->alloc, &a);
+    var_free(&lisp->alloc, &b);
     return rc;
 }
 
 int builtin_modulo(void *_lisp, void *_node, size_t argnum, void *_returned) {
-    Var *args = NULL; /* TODO: Fix required! */
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
     int rc;
-    TL_UNUSED(_lisp);
+    Var a;
+    Var b;
     if(argnum < 2) return TL_ERR_TOO_FEW_ARGS;
     else if(argnum > 2) return TL_ERR_TOO_MANY_ARGS;
-    if(VAR_LEN(args) != 1 || VAR_LEN(args+1) != 1){
+    rc = call_get_arg(lisp, node, 0, &a, 1);
+    if(rc) return rc;
+    rc = call_get_arg(lisp, node, 1, &b, 1);
+    if(rc){
+        var_free(&lisp->alloc, &a);
+        return rc;
+    }
+    if(VAR_LEN(&a) != 1 || VAR_LEN(&b) != 1){
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_INVALID_LIST_SIZE;
     }
-    if(args[0].type != TL_T_NUM || args[1].type != TL_T_NUM){
+    if(a.type != TL_T_NUM || b.type != TL_T_NUM){
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_BAD_TYPE;
     }
-    if(args[1].items->num == 0){
+    if(b.items->num == 0){
+        var_free(&lisp->alloc, &a);
+        var_free(&lisp->alloc, &b);
         return TL_ERR_DIVISION_BY_ZERO;
     }
-    rc = var_num_from_float(_returned, fmod(args[0].items->num,
-                                            args[1].items->num));
+    rc = var_num_from_float(&lisp->alloc, _returned,
+                            fmod(a.items->num, b.items->num));
+    var_free(&lisp->alloc, &a);
+    var_free(&lisp->alloc, &b);
     return rc;
 }
 
 int builtin_floor(void *_lisp, void *_node, size_t argnum, void *_returned) {
-    Var *args = NULL; /* TODO: Fix required! */
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
     int rc;
-    TL_UNUSED(_lisp);
+    Var a;
     if(argnum < 1) return TL_ERR_TOO_FEW_ARGS;
     else if(argnum > 1) return TL_ERR_TOO_MANY_ARGS;
-    if(VAR_LEN(args) != 1){
+    rc = call_get_arg(lisp, node, 0, &a, 1);
+    if(rc) return rc;
+    if(VAR_LEN(&a) != 1){
+        var_free(&lisp->alloc, &a);
         return TL_ERR_INVALID_LIST_SIZE;
     }
-    if(args[0].type != TL_T_NUM){
+    if(a.type != TL_T_NUM){
+        var_free(&lisp->alloc, &a);
         return TL_ERR_BAD_TYPE;
     }
-    rc = var_num_from_float(_returned, floor(args[0].items->num));
+    rc = var_num_from_float(&lisp->alloc, _returned, floor(a.items->num));
+    var_free(&lisp->alloc, &a);
     return rc;
 }
 
 int builtin_ceil(void *_lisp, void *_node, size_t argnum, void *_returned) {
-    Var *args = NULL; /* TODO: Fix required! */
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
     int rc;
-    TL_UNUSED(_lisp);
+    Var a;
     if(argnum < 1) return TL_ERR_TOO_FEW_ARGS;
     else if(argnum > 1) return TL_ERR_TOO_MANY_ARGS;
-    if(VAR_LEN(args) != 1){
+    rc = call_get_arg(lisp, node, 0, &a, 1);
+    if(rc) return rc;
+    if(VAR_LEN(&a) != 1){
+        var_free(&lisp->alloc, &a);
         return TL_ERR_INVALID_LIST_SIZE;
     }
-    if(args[0].type != TL_T_NUM){
+    if(a.type != TL_T_NUM){
+        var_free(&lisp->alloc, &a);
         return TL_ERR_BAD_TYPE;
     }
-    rc = var_num_from_float(_returned, ceil(args[0].items->num));
+    rc = var_num_from_float(&lisp->alloc, _returned, ceil(a.items->num));
+    var_free(&lisp->alloc, &a);
     return rc;
 }
 
 int builtin_parsenum(void *_lisp, void *_node, size_t argnum,
                      void *_returned) {
-    Var *args = NULL; /* TODO: Fix required! */
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
     int rc;
-    TL_UNUSED(_lisp);
+    Var str;
     if(argnum < 1) return TL_ERR_TOO_FEW_ARGS;
     else if(argnum > 1) return TL_ERR_TOO_MANY_ARGS;
-    if(VAR_LEN(args) != 1){
+    rc = call_get_arg(lisp, node, 0, &str, 1);
+    if(rc) return rc;
+    if(VAR_LEN(&str) != 1){
+        var_free(&lisp->alloc, &str);
         return TL_ERR_INVALID_LIST_SIZE;
     }
-    if(args[0].type != TL_T_STR){
+    if(str.type != TL_T_STR){
+        var_free(&lisp->alloc, &str);
         return TL_ERR_BAD_TYPE;
     }
-    if(!var_isnum(args[0].items->string.data, args[0].items->string.len)){
+    if(!var_isnum(VAR_STR_DATA(VAR_GET_ITEM(&str, 0)),
+                  VAR_STR_LEN(VAR_GET_ITEM(&str, 0)))){
+        var_free(&lisp->alloc, &str);
         return TL_ERR_BAD_INPUT;
     }
-    rc = var_num(_returned, args[0].items->string.data,
-                 args[0].items->string.len);
+    rc = var_num(&lisp->alloc, _returned, VAR_STR_DATA(VAR_GET_ITEM(&str, 0)),
+                 VAR_STR_LEN(VAR_GET_ITEM(&str, 0)));
+    var_free(&lisp->alloc, &str);
     return rc;
 }
 
 int builtin_callif(void *_lisp, void *_node, size_t argnum, void *_returned) {
-    /* TODO: Rewrite it! */
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
+    Var condition;
+    Var *name;
+    Function *function;
+    int rc;
+    if(argnum < 2) return TL_ERR_TOO_FEW_ARGS;
+    rc = call_get_arg(lisp, node, 0, &condition, 1);
+    if(rc) return rc;
+    if(VAR_LEN(&condition) != 1){
+        var_free(&lisp->alloc, &condition);
+        return TL_ERR_INVALID_LIST_SIZE;
+    }
+    if(condition.type != TL_T_NUM){
+        var_free(&lisp->alloc, &condition);
+        return TL_ERR_BAD_TYPE;
+    }
+    if(condition.items->num == 0){
+        /* The function is not called. */
+        var_free(&lisp->alloc, &condition);
+        return var_num_from_float(&lisp->alloc, _returned, 1);
+    }
+    var_free(&lisp->alloc, &condition);
+    rc = call_get_arg_raw(node, 1, &name);
+    if(rc) return rc;
+    if(name->type != TL_T_NAME) return TL_ERR_BAD_TYPE;
+    if(VAR_LEN(name) != 1) return TL_ERR_INVALID_LIST_SIZE;
+    rc = call_find_func(lisp, &VAR_GET_ITEM(name, 0).string, &function);
+    if(rc) return rc;
+    /* The arguments of the function follow its name. */
+    return call_function(lisp, function, node, 2, _returned);
+}
+
+int builtin_while(void *_lisp, void *_node, size_t argnum, void *_returned) {
+    TL_UNUSED(_node);
+    TL_UNUSED(_returned);
+    if(argnum < 1) return TL_ERR_TOO_FEW_ARGS;
+    /* The condition and the body are evaluated by the loop. */
+    return call_loop(_lisp, TL_LOOP_WHILE);
+}
+
+int builtin_repeat(void *_lisp, void *_node, size_t argnum, void *_returned) {
+    TL_UNUSED(_node);
+    TL_UNUSED(_returned);
+    if(argnum < 1) return TL_ERR_TOO_FEW_ARGS;
+    return call_loop(_lisp, TL_LOOP_REPEAT);
+}
+
+int builtin_for(void *_lisp, void *_node, size_t argnum, void *_returned) {
+    Var *name;
+    int rc;
+    TL_UNUSED(_returned);
+    if(argnum < 3) return TL_ERR_TOO_FEW_ARGS;
+    /* The variable is given from the first value to the last one. */
+    rc = call_get_arg_raw(_node, 0, &name);
+    if(rc) return rc;
+    if(name->type != TL_T_NAME) return TL_ERR_BAD_TYPE;
+    if(VAR_LEN(name) != 1) return TL_ERR_INVALID_LIST_SIZE;
+    return call_loop(_lisp, TL_LOOP_FOR);
+}
+
+int builtin_range(void *_lisp, void *_node, size_t argnum, void *_returned) {
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
+    Stream *stream;
+    Var num;
+    float nums[3];
+    size_t i;
+    int rc;
+    if(argnum < 1) return TL_ERR_TOO_FEW_ARGS;
+    else if(argnum > 3) return TL_ERR_TOO_MANY_ARGS;
+    /* The first number, the last one and the step. */
+    for(i=0;i<argnum;i++){
+        rc = call_get_arg(lisp, node, i, &num, 1);
+        if(rc) return rc;
+        if(VAR_LEN(&num) != 1) rc = TL_ERR_INVALID_LIST_SIZE;
+        else if(num.type != TL_T_NUM) rc = TL_ERR_BAD_TYPE;
+        else nums[i] = VAR_NUM_AT(&num, 0);
+        var_free(&lisp->alloc, &num);
+        if(rc) return rc;
+    }
+    rc = var_stream(&lisp->alloc, _returned, TL_STREAM_RANGE);
+    if(rc) return rc;
+    stream = ((Var*)_returned)->items->stream;
+    stream->num = nums[0];
+    if(argnum > 1){
+        stream->end = nums[1];
+        stream->bounded = 1;
+    }
+    if(argnum > 2) stream->step = nums[2];
+    return TL_SUCCESS;
+}
+
+int builtin_iterate(void *_lisp, void *_node, size_t argnum, void *_returned) {
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
+    Stream *stream;
+    Var value;
+    int rc;
+    if(argnum < 2) return TL_ERR_TOO_FEW_ARGS;
+    else if(argnum > 2) return TL_ERR_TOO_MANY_ARGS;
+    rc = call_get_arg(lisp, node, 1, &value, 1);
+    if(rc) return rc;
+    rc = var_stream(&lisp->alloc, _returned, TL_STREAM_ITERATE);
+    if(rc){
+        var_free(&lisp->alloc, &value);
+        return rc;
+    }
+    stream = ((Var*)_returned)->items->stream;
+    /* The value may be borrowed. */
+    rc = var_copy(&lisp->alloc, &value, &stream->value);
+    var_free(&lisp->alloc, &value);
+    stream->has_value = !rc;
+    stream->ready = 1;
+    if(!rc) rc = stream_func(lisp, node, 0, stream);
+    if(rc) var_free(&lisp->alloc, _returned);
+    return rc;
+}
+
+int builtin_stream_apply(void *_lisp, void *_node, size_t argnum,
+                         void *_returned, unsigned char kind) {
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
+    Stream *source;
+    Var value;
+    int rc;
+    if(argnum < 2) return TL_ERR_TOO_FEW_ARGS;
+    else if(argnum > 2) return TL_ERR_TOO_MANY_ARGS;
+    rc = call_get_arg(lisp, node, 1, &value, 1);
+    if(rc) return rc;
+    rc = stream_get(lisp, &value, &source);
+    if(rc) return rc;
+    rc = var_stream(&lisp->alloc, _returned, kind);
+    if(rc){
+        var_free_stream(&lisp->alloc, source);
+        return rc;
+    }
+    ((Var*)_returned)->items->stream->source = source;
+    rc = stream_func(lisp, node, 0, ((Var*)_returned)->items->stream);
+    if(rc) var_free(&lisp->alloc, _returned);
+    return rc;
+}
+
+int builtin_stream_map(void *_lisp, void *_node, size_t argnum,
+                       void *_returned) {
+    /* The function is only called when the elements are pulled. */
+    return builtin_stream_apply(_lisp, _node, argnum, _returned,
+                                TL_STREAM_MAP);
+}
+
+int builtin_stream_filter(void *_lisp, void *_node, size_t argnum,
+                          void *_returned) {
+    return builtin_stream_apply(_lisp, _node, argnum, _returned,
+                                TL_STREAM_FILTER);
+}
+
+int builtin_list_apply(void *_lisp, void *_node, size_t argnum,
+                       void *_returned, unsigned char kind) {
+    Stream *stream;
+    int rc;
+    rc = builtin_stream_apply(_lisp, _node, argnum, _returned, kind);
+    if(rc) return rc;
+    /* A stream gives a stream. A list gives a list, unless the elements are
+     * only pulled by the function that uses them. */
+    stream = ((Var*)_returned)->items->stream;
+    stream->list = stream->source->list;
+    if(!stream->list || stream_fused(_lisp, _node)) return TL_SUCCESS;
+    return stream_take(_lisp, _returned, (size_t)-1);
+}
+
+int builtin_map(void *_lisp, void *_node, size_t argnum, void *_returned) {
+    return builtin_list_apply(_lisp, _node, argnum, _returned,
+                              TL_STREAM_MAP);
+}
+
+int builtin_filter(void *_lisp, void *_node, size_t argnum,
+                   void *_returned) {
+    return builtin_list_apply(_lisp, _node, argnum, _returned,
+                              TL_STREAM_FILTER);
+}
+
+int builtin_reduce(void *_lisp, void *_node, size_t argnum, void *_returned) {
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
+    Stream *source;
+    Stream *stream;
+    Var value;
+    Var list;
+    int rc;
+    if(argnum < 3) return TL_ERR_TOO_FEW_ARGS;
+    else if(argnum > 3) return TL_ERR_TOO_MANY_ARGS;
+    rc = call_get_arg(lisp, node, 1, &value, 1);
+    if(rc) return rc;
+    rc = call_get_arg(lisp, node, 2, &list, 1);
+    if(!rc) rc = stream_get(lisp, &list, &source);
+    if(rc){
+        var_free(&lisp->alloc, &value);
+        return rc;
+    }
+    rc = var_stream(&lisp->alloc, _returned, TL_STREAM_FOLD);
+    if(rc){
+        var_free(&lisp->alloc, &value);
+        var_free_stream(&lisp->alloc, source);
+        return rc;
+    }
+    stream = ((Var*)_returned)->items->stream;
+    stream->source = source;
+    /* The value may be borrowed. */
+    rc = var_copy(&lisp->alloc, &value, &stream->data);
+    var_free(&lisp->alloc, &value);
+    stream->has_data = !rc;
+    if(!rc) rc = stream_func(lisp, node, 0, stream);
+    if(rc){
+        var_free(&lisp->alloc, _returned);
+        return rc;
+    }
+    /* The fold gives a single element, once every element went through
+     * the function. */
+    return stream_take(lisp, _returned, 1);
+}
+
+int builtin_take(void *_lisp, void *_node, size_t argnum, void *_returned) {
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
+    Var *list = _returned;
+    Stream *source;
+    size_t count;
+    int rc;
+    if(argnum < 2) return TL_ERR_TOO_FEW_ARGS;
+    else if(argnum > 2) return TL_ERR_TOO_MANY_ARGS;
+    rc = builtin_get_pos(lisp, node, 0, &count);
+    if(rc) return rc;
+    rc = call_get_arg(lisp, node, 1, list, 1);
+    if(rc) return rc;
+    if(list->type == TL_T_STREAM && stream_fused(lisp, node)){
+        /* The function using the elements pulls them. */
+        rc = stream_get(lisp, list, &source);
+        if(rc) return rc;
+        rc = var_stream(&lisp->alloc, list, TL_STREAM_TAKE);
+        if(rc){
+            var_free_stream(&lisp->alloc, source);
+            return rc;
+        }
+        list->items->stream->source = source;
+        list->items->stream->count = count;
+        list->items->stream->list = 1;
+        return TL_SUCCESS;
+    }
+    if(list->type == TL_T_STREAM){
+        /* The elements are pulled one by one, and put in a list. */
+        return stream_take(lisp, list, count);
+    }
+    if(count > VAR_LEN(list)) count = VAR_LEN(list);
+    rc = var_slice(&lisp->alloc, list, 0, count);
+    if(rc) var_free(&lisp->alloc, list);
+    return rc;
+}
+
+int builtin_drop(void *_lisp, void *_node, size_t argnum, void *_returned) {
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
+    Var *list = _returned;
+    Stream *source;
+    size_t count;
+    int rc;
+    if(argnum < 2) return TL_ERR_TOO_FEW_ARGS;
+    else if(argnum > 2) return TL_ERR_TOO_MANY_ARGS;
+    rc = builtin_get_pos(lisp, node, 0, &count);
+    if(rc) return rc;
+    rc = call_get_arg(lisp, node, 1, list, 1);
+    if(rc) return rc;
+    if(list->type != TL_T_STREAM){
+        if(count > VAR_LEN(list)) count = VAR_LEN(list);
+        rc = var_slice(&lisp->alloc, list, count, VAR_LEN(list)-count);
+        if(rc) var_free(&lisp->alloc, list);
+        return rc;
+    }
+    /* The elements are only skipped when the stream is pulled from. */
+    rc = stream_get(lisp, list, &source);
+    if(rc) return rc;
+    rc = var_stream(&lisp->alloc, list, TL_STREAM_DROP);
+    if(rc){
+        var_free_stream(&lisp->alloc, source);
+        return rc;
+    }
+    list->items->stream->source = source;
+    list->items->stream->count = count;
     return TL_SUCCESS;
 }
 
 int builtin_len(void *_lisp, void *_node, size_t argnum, void *_returned) {
-    Var *args = NULL; /* TODO: Fix required! */
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
     int rc;
-    TL_UNUSED(_lisp);
+    Var list;
     if(argnum < 1) return TL_ERR_TOO_FEW_ARGS;
     else if(argnum > 1) return TL_ERR_TOO_MANY_ARGS;
-    rc = var_num_from_float(_returned, VAR_LEN(args));
+    rc = call_get_arg(lisp, node, 0, &list, 1);
+    if(rc) return rc;
+    rc = var_num_from_float(&lisp->alloc, _returned, VAR_LEN(&list));
+    var_free(&lisp->alloc, &list);
     return rc;
 }
 
 int builtin_strlen(void *_lisp, void *_node, size_t argnum, void *_returned) {
-    Var *args = NULL; /* TODO: Fix required! */
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
     int rc;
-    TL_UNUSED(_lisp);
+    Var str;
     if(argnum < 1) return TL_ERR_TOO_FEW_ARGS;
     else if(argnum > 1) return TL_ERR_TOO_MANY_ARGS;
-    if(VAR_LEN(args) != 1) return TL_ERR_INVALID_LIST_SIZE;
-    if(args->type != TL_T_STR) return TL_ERR_BAD_TYPE;
-    rc = var_num_from_float(_returned, args->items->string.len);
+    rc = call_get_arg(lisp, node, 0, &str, 1);
+    if(rc) return rc;
+    if(VAR_LEN(&str) != 1){
+        var_free(&lisp->alloc, &str);
+        return TL_ERR_INVALID_LIST_SIZE;
+    }
+    if(str.type != TL_T_STR){
+        var_free(&lisp->alloc, &str);
+        return TL_ERR_BAD_TYPE;
+    }
+    rc = var_num_from_float(&lisp->alloc, _returned,
+                            VAR_STR_LEN(VAR_GET_ITEM(&str, 0)));
+    var_free(&lisp->alloc, &str);
     return rc;
 }
 
 int builtin_get(void *_lisp, void *_node, size_t argnum, void *_returned) {
-    Var *args = NULL; /* TODO: Fix required! */
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
     int rc;
     int index;
-    TL_UNUSED(_lisp);
+    Var list;
+    Var pos;
     if(argnum < 2) return TL_ERR_TOO_FEW_ARGS;
     else if(argnum > 2) return TL_ERR_TOO_MANY_ARGS;
-    if(args[1].type != TL_T_NUM) return TL_ERR_BAD_TYPE;
-    if(VAR_LEN(args+1) != 1) return TL_ERR_INVALID_LIST_SIZE;
-    index = (int)args[1].items->num;
-    if(index < 0 || (size_t)index >= VAR_LEN(args)){
+    rc = call_get_arg(lisp, node, 0, &list, 1);
+    if(rc) return rc;
+    rc = call_get_arg(lisp, node, 1, &pos, 1);
+    if(rc){
+        var_free(&lisp->alloc, &list);
+        return rc;
+    }
+    if(pos.type != TL_T_NUM){
+        var_free(&lisp->alloc, &list);
+        var_free(&lisp->alloc, &pos);
+        return TL_ERR_BAD_TYPE;
+    }
+    if(VAR_LEN(&pos) != 1){
+        var_free(&lisp->alloc, &list);
+        var_free(&lisp->alloc, &pos);
+        return TL_ERR_INVALID_LIST_SIZE;
+    }
+    index = (int)pos.items->num;
+    var_free(&lisp->alloc, &pos);
+    if(index < 0 || (size_t)index >= VAR_LEN(&list)){
+        var_free(&lisp->alloc, &list);
         return TL_ERR_OUT_OF_RANGE;
     }
-    switch(args->type){
+    switch(list.type){
         case TL_T_NAME:
-            rc = var_str(_returned, args->items[index].string.data,
-                         args->items[index].string.len);
+            rc = var_str(&lisp->alloc, _returned,
+                         VAR_STR_DATA(list.items[index]),
+                         VAR_STR_LEN(list.items[index]));
             if(!rc) ((Var*)_returned)->type = TL_T_NAME;
-            return rc;
+            break;
         case TL_T_STR:
-            rc = var_str(_returned, args->items[index].string.data,
-                         args->items[index].string.len);
-            return rc;
+            rc = var_str(&lisp->alloc, _returned, VAR_STR_AT(&list, index),
+                         VAR_STR_LEN_AT(&list, index));
+            break;
         case TL_T_NUM:
-            rc = var_num_from_float(_returned, args->items[index].num);
-            return rc;
+            rc = var_num_from_float(&lisp->alloc, _returned,
+                                    VAR_NUM_AT(&list, index));
+            break;
         default:
-            return TL_ERR_BAD_TYPE;
+            rc = TL_ERR_BAD_TYPE;
     }
-    return TL_SUCCESS;
+    var_free(&lisp->alloc, &list);
+    return rc;
 }
 
 int builtin_strget(void *_lisp, void *_node, size_t argnum, void *_returned) {
-    Var *args = NULL; /* TODO: Fix required! */
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
     int rc;
     int index;
-    TL_UNUSED(_lisp);
+    Var str;
+    Var pos;
     if(argnum < 2) return TL_ERR_TOO_FEW_ARGS;
     else if(argnum > 2) return TL_ERR_TOO_MANY_ARGS;
-    if(VAR_LEN(args) != 1) return TL_ERR_INVALID_LIST_SIZE;
-    if(VAR_LEN(args+1) != 1) return TL_ERR_INVALID_LIST_SIZE;
-    if(args->type != TL_T_STR) return TL_ERR_BAD_TYPE;
-    if(args[1].type != TL_T_NUM) return TL_ERR_BAD_TYPE;
-    index = (int)args[1].items->num;
-    if(index < 0 || (size_t)index >= args->items->string.len){
+    rc = call_get_arg(lisp, node, 0, &str, 1);
+    if(rc) return rc;
+    rc = call_get_arg(lisp, node, 1, &pos, 1);
+    if(rc){
+        var_free(&lisp->alloc, &str);
+        return rc;
+    }
+    if(VAR_LEN(&str) != 1 || VAR_LEN(&pos) != 1){
+        var_free(&lisp->alloc, &str);
+        var_free(&lisp->alloc, &pos);
+        return TL_ERR_INVALID_LIST_SIZE;
+    }
+    if(str.type != TL_T_STR || pos.type != TL_T_NUM){
+        var_free(&lisp->alloc, &str);
+        var_free(&lisp->alloc, &pos);
+        return TL_ERR_BAD_TYPE;
+    }
+    index = (int)pos.items->num;
+    var_free(&lisp->alloc, &pos);
+    if(index < 0 || (size_t)index >= VAR_STR_LEN(VAR_GET_ITEM(&str, 0))){
+        var_free(&lisp->alloc, &str);
         return TL_ERR_OUT_OF_RANGE;
     }
-    rc = var_str(_returned, args->items->string.data+index, sizeof(char));
+    /* A single character is always stored inline. */
+    rc = var_str(&lisp->alloc, _returned,
+                 VAR_STR_DATA(VAR_GET_ITEM(&str, 0))+index, sizeof(char));
+    var_free(&lisp->alloc, &str);
+    return rc;
+}
+
+int builtin_get_pos(void *_lisp, void *_node, size_t i, size_t *pos) {
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
+    int rc;
+    Var num;
+    rc = call_get_arg(lisp, node, i, &num, 1);
+    if(rc) return rc;
+    if(num.type != TL_T_NUM){
+        var_free(&lisp->alloc, &num);
+        return TL_ERR_BAD_TYPE;
+    }
+    if(VAR_LEN(&num) != 1){
+        var_free(&lisp->alloc, &num);
+        return TL_ERR_INVALID_LIST_SIZE;
+    }
+    if(num.items->num < 0){
+        var_free(&lisp->alloc, &num);
+        return TL_ERR_OUT_OF_RANGE;
+    }
+    *pos = (size_t)num.items->num;
+    var_free(&lisp->alloc, &num);
+    return TL_SUCCESS;
+}
+
+int builtin_head(void *_lisp, void *_node, size_t argnum, void *_returned) {
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
+    int rc;
+    if(argnum < 1) return TL_ERR_TOO_FEW_ARGS;
+    else if(argnum > 1) return TL_ERR_TOO_MANY_ARGS;
+    rc = call_get_arg(lisp, node, 0, _returned, 1);
+    if(rc) return rc;
+    if(!VAR_LEN((Var*)_returned)){
+        var_free(&lisp->alloc, _returned);
+        return TL_ERR_INVALID_LIST_SIZE;
+    }
+    rc = var_slice(&lisp->alloc, _returned, 0, 1);
+    if(rc) var_free(&lisp->alloc, _returned);
+    return rc;
+}
+
+int builtin_tail(void *_lisp, void *_node, size_t argnum, void *_returned) {
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
+    int rc;
+    if(argnum < 1) return TL_ERR_TOO_FEW_ARGS;
+    else if(argnum > 1) return TL_ERR_TOO_MANY_ARGS;
+    rc = call_get_arg(lisp, node, 0, _returned, 1);
+    if(rc) return rc;
+    if(!VAR_LEN((Var*)_returned)){
+        var_free(&lisp->alloc, _returned);
+        return TL_ERR_INVALID_LIST_SIZE;
+    }
+    rc = var_slice(&lisp->alloc, _returned, 1, VAR_LEN((Var*)_returned)-1);
+    if(rc) var_free(&lisp->alloc, _returned);
+    return rc;
+}
+
+int builtin_slice(void *_lisp, void *_node, size_t argnum, void *_returned) {
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
+    int rc;
+    size_t start;
+    size_t len;
+    if(argnum < 3) return TL_ERR_TOO_FEW_ARGS;
+    else if(argnum > 3) return TL_ERR_TOO_MANY_ARGS;
+    rc = builtin_get_pos(lisp, node, 1, &start);
+    if(rc) return rc;
+    rc = builtin_get_pos(lisp, node, 2, &len);
+    if(rc) return rc;
+    rc = call_get_arg(lisp, node, 0, _returned, 1);
+    if(rc) return rc;
+    rc = var_slice(&lisp->alloc, _returned, start, len);
+    if(rc) var_free(&lisp->alloc, _returned);
+    return rc;
+}
+
+char builtin_borrows(Function *function) {
+    int (*f)(void*, void*, size_t, void*) = function->ptr.f;
+    /* These functions only read their first argument, or give a view of a
+     * part of it: a parameter can be passed to them without copying it. */
+    return function->builtin && (f == builtin_len || f == builtin_get ||
+                                 f == builtin_head || f == builtin_tail ||
+                                 f == builtin_slice);
+}
+
+int builtin_substr(void *_lisp, void *_node, size_t argnum, void *_returned) {
+    LizyLang *lisp = _lisp;
+    Node *node = _node;
+    int rc;
+    size_t start;
+    size_t len;
+    if(argnum < 3) return TL_ERR_TOO_FEW_ARGS;
+    else if(argnum > 3) return TL_ERR_TOO_MANY_ARGS;
+    rc = builtin_get_pos(lisp, node, 1, &start);
+    if(rc) return rc;
+    rc = builtin_get_pos(lisp, node, 2, &len);
+    if(rc) return rc;
+    rc = call_get_arg(lisp, node, 0, _returned, 1);
+    if(rc) return rc;
+    rc = var_substr(&lisp->alloc, _returned, start, len);
+    if(rc) var_free(&lisp->alloc, _returned);
     return rc;
 }
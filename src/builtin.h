@@ -38,6 +38,10 @@
  * 2024/10/04: Adding some functions.
  * 2024/10/09: Started adding function definition.
  * 2024/10/18: Fixed the prototypes.
+ * 2026/10/18: Added head, tail, slice and substr. Added memo-persist.
+ *             Added while, repeat and for. Added range, iterate,
+ *             stream-map, stream-filter, take and drop. Added map, filter
+ *             and reduce.
  */
 
 #ifndef BUILTIN_H
@@ -61,6 +65,8 @@ int builtin_params(void *_lisp, void *_node, size_t argnum, void *_returned);
 int builtin_list(void *_lisp, void *_node, size_t argnum, void *_returned);
 int builtin_fncdef(void *_lisp, void *_node, size_t argnum, void *_returned);
 int builtin_defend(void *_lisp, void *_node, size_t argnum, void *_returned);
+int builtin_memo_persist(void *_lisp, void *_node, size_t argnum,
+                         void *_returned);
 int builtin_if(void *_lisp, void *_node, size_t argnum, void *_returned);
 int builtin_smaller(void *_lisp, void *_node, size_t argnum, void *_returned);
 int builtin_bigger(void *_lisp, void *_node, size_t argnum, void *_returned);
@@ -80,9 +86,33 @@ int builtin_floor(void *_lisp, void *_node, size_t argnum, void *_returned);
 int builtin_ceil(void *_lisp, void *_node, size_t argnum, void *_returned);
 int builtin_parsenum(void *_lisp, void *_node, size_t argnum, void *_returned);
 int builtin_callif(void *_lisp, void *_node, size_t argnum, void *_returned);
+int builtin_while(void *_lisp, void *_node, size_t argnum, void *_returned);
+int builtin_repeat(void *_lisp, void *_node, size_t argnum, void *_returned);
+int builtin_for(void *_lisp, void *_node, size_t argnum, void *_returned);
+int builtin_range(void *_lisp, void *_node, size_t argnum, void *_returned);
+int builtin_iterate(void *_lisp, void *_node, size_t argnum, void *_returned);
+int builtin_stream_apply(void *_lisp, void *_node, size_t argnum,
+                         void *_returned, unsigned char kind);
+int builtin_stream_map(void *_lisp, void *_node, size_t argnum,
+                       void *_returned);
+int builtin_stream_filter(void *_lisp, void *_node, size_t argnum,
+                          void *_returned);
+int builtin_list_apply(void *_lisp, void *_node, size_t argnum,
+                       void *_returned, unsigned char kind);
+int builtin_map(void *_lisp, void *_node, size_t argnum, void *_returned);
+int builtin_filter(void *_lisp, void *_node, size_t argnum, void *_returned);
+int builtin_reduce(void *_lisp, void *_node, size_t argnum, void *_returned);
+int builtin_take(void *_lisp, void *_node, size_t argnum, void *_returned);
+int builtin_drop(void *_lisp, void *_node, size_t argnum, void *_returned);
 int builtin_len(void *_lisp, void *_node, size_t argnum, void *_returned);
 int builtin_strlen(void *_lisp, void *_node, size_t argnum, void *_returned);
 int builtin_get(void *_lisp, void *_node, size_t argnum, void *_returned);
 int builtin_strget(void *_lisp, void *_node, size_t argnum, void *_returned);
+int builtin_get_pos(void *_lisp, void *_node, size_t i, size_t *pos);
+int builtin_head(void *_lisp, void *_node, size_t argnum, void *_returned);
+int builtin_tail(void *_lisp, void *_node, size_t argnum, void *_returned);
+int builtin_slice(void *_lisp, void *_node, size_t argnum, void *_returned);
+char builtin_borrows(Function *function);
+int builtin_substr(void *_lisp, void *_node, size_t argnum, void *_returned);
 
 #endif
@@ -46,315 +46,1479 @@
  * 2024/10/20: Adding user defined function calling.
  * 2024/10/21: Getting arguments when calling user defined functions.
  * 2024/10/22: Still trying to fix a context issue.
+ * 2026/10/18: Store short strings inline. Pass constants by reference and
+ *             look names up without copying them first. Allocate memory
+ *             with the interpreter allocator. Support views. Fixed looking
+ *             up the parameters. Tail calls reuse the frame of the caller.
+ *             Growable stack, take the arguments from a pool. Evaluate with
+ *             a continuation stack instead of recursing. Parameters passed
+ *             through share the argument they were passed as. Strictness
+ *             analysis, strict arguments are evaluated first. Hidden
+ *             parameters computed in the frame. Cache the results of the
+ *             pure functions. Run the bodies compiled to bytecode. Use the
+ *             functions and parameters the nodes are bound to. Run the
+ *             loops in the continuation of their builtin function. Pull
+ *             the elements of streams. Do not cache the calls with long
+ *             lists. Lend the parameters to the builtin functions that
+ *             only read them, the views they give take their storage when
+ *             the frame is freed. Check again if the functions are pure
+ *             once one is deleted or replaced. Check the bodies without
+ *             recursing, or up to TL_STRICT_DEPTH for the strictness. A tail
+ *             call does not reuse the frame if a lazy argument needs it. The
+ *             strictness follows both branches of if and recursive calls.
  */
 
 #include <call.h>
+#include <builtin.h>
 
 #define TL_MIN(a, b) ((a) < (b) ? (a) : (b))
 
-int call_exec(LizyLang *lisp, Node *node, Var *returned) {
-    Function *function;
-    char found;
+int call_find_func(LizyLang *lisp, String *name, Function **function) {
     size_t i;
-    int rc;
-    size_t line, old_ctx;
-    Var call_return;
-    if(node->var->type != TL_T_CALL){
-        return TL_ERR_VALUE_OUTSIDE_OF_CALL;
-    }
-    if(node->var->size != 1){
-        return TL_ERR_INVALID_LIST_SIZE;
-    }
-#if TL_DEBUG_CALL
-    fputs("Calling \"", stdout);
-    fwrite(node->var->items->call.function.data, 1,
-           node->var->items->call.function.len, stdout);
-    puts("\"");
-#endif
-    /* Find the function */
-    found = 0;
     for(i=0;i<lisp->var_num;i++){
-        if(lisp->vars[i].type == TL_T_FUNC){
+        if(lisp->vars[i].type != TL_T_FUNC) continue;
 #if TL_DEBUG_VARS
-            fputc('"', stdout);
-            fwrite(lisp->var_names[i].data, 1,
-                   lisp->var_names[i].len, stdout);
-            fputs("\", \"", stdout);
-            fwrite(node->var->items->call.function.data, 1,
-                   node->var->items->call.function.len, stdout);
-            fputs("\"\n", stdout);
+        fputc('"', stdout);
+        fwrite(VAR_RAW_STR_DATA(lisp->var_names+i), 1, lisp->var_names[i].len,
+               stdout);
+        fputs("\", \"", stdout);
+        fwrite(VAR_RAW_STR_DATA(name), 1, name->len, stdout);
+        fputs("\"\n", stdout);
 #endif
-            if(lisp->var_names[i].len != node->var->items->call.function.len){
+        if(lisp->var_names[i].len != name->len) continue;
+        if(!memcmp(VAR_RAW_STR_DATA(lisp->var_names+i), VAR_RAW_STR_DATA(name),
+                   name->len)){
+            *function = &lisp->vars[i].items->function;
+            return TL_SUCCESS;
+        }
+    }
+    return TL_ERR_FUNC_NOT_DEF;
+}
+
+char call_find_param(Var *params, Var *name, size_t *n) {
+    size_t i;
+    for(i=0;i<VAR_LEN(params);i++){
+        if(VAR_STR_LEN(VAR_GET_ITEM(params, i)) !=
+           VAR_STR_LEN(VAR_GET_ITEM(name, 0))){
+            continue;
+        }
+        if(!memcmp(VAR_STR_DATA(VAR_GET_ITEM(params, i)),
+                   VAR_STR_DATA(VAR_GET_ITEM(name, 0)),
+                   VAR_STR_LEN(VAR_GET_ITEM(name, 0)))){
+            *n = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int call_node_func(LizyLang *lisp, Node *node, Function **function) {
+    String *name = &node->var->items->call.function;
+    size_t i = node->slot;
+    /* The function is most likely where it was found the last time. */
+    if(i < lisp->var_num && lisp->vars[i].type == TL_T_FUNC &&
+       lisp->var_names[i].len == name->len &&
+       !memcmp(VAR_RAW_STR_DATA(lisp->var_names+i), VAR_RAW_STR_DATA(name),
+               name->len)){
+        *function = &lisp->vars[i].items->function;
+        return TL_SUCCESS;
+    }
+    for(i=0;i<lisp->var_num;i++){
+        if(lisp->vars[i].type != TL_T_FUNC) continue;
+        if(lisp->var_names[i].len != name->len) continue;
+        if(!memcmp(VAR_RAW_STR_DATA(lisp->var_names+i), VAR_RAW_STR_DATA(name),
+                   name->len)){
+            node->slot = i;
+            *function = &lisp->vars[i].items->function;
+            return TL_SUCCESS;
+        }
+    }
+    return TL_ERR_FUNC_NOT_DEF;
+}
+
+char call_node_param(Node *node, Var *params, size_t *n) {
+    size_t i = node->param-TL_PARAM_FIRST;
+    if(node->param == TL_PARAM_NONE) return 0;
+    /* The optimiser bound the name to the parameter it refers to. */
+    if(node->param != TL_PARAM_UNKNOWN && i < VAR_LEN(params) &&
+       VAR_STR_LEN(VAR_GET_ITEM(params, i)) ==
+       VAR_STR_LEN(VAR_GET_ITEM(node->var, 0)) &&
+       !memcmp(VAR_STR_DATA(VAR_GET_ITEM(params, i)),
+               VAR_STR_DATA(VAR_GET_ITEM(node->var, 0)),
+               VAR_STR_LEN(VAR_GET_ITEM(node->var, 0)))){
+        *n = i;
+        return 1;
+    }
+    return call_find_param(params, node->var, n);
+}
+
+Node *call_let(Node *names, size_t n) {
+    return ((Node**)((Node**)names->childs)[n]->childs)[0];
+}
+
+char call_uses_params(Node *root, Var *params) {
+    Node *node;
+    size_t n;
+    for(node=root;node;node=node_next(root, node)){
+        if(node->var->type == TL_T_NAME &&
+           call_find_param(params, node->var, &n)){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+char call_is_self(Node *node, Node *names) {
+    Node *name = ((Node**)((Node*)names->parent)->childs)[0];
+    String *called = &node->var->items->call.function;
+    return name->var->type == TL_T_NAME && node->var->size == 1 &&
+           called->len == VAR_STR_LEN(VAR_GET_ITEM(name->var, 0)) &&
+           !memcmp(VAR_RAW_STR_DATA(called),
+                   VAR_STR_DATA(VAR_GET_ITEM(name->var, 0)), called->len);
+}
+
+unsigned short call_forces(LizyLang *lisp, Node *node, Var *params,
+                           Node *names, unsigned short self, char *effects,
+                           size_t depth) {
+    Function *function;
+    size_t i, n, num;
+    unsigned short mask = 0;
+    unsigned short other;
+    char later;
+    if(*effects) return 0;
+    if(depth >= TL_STRICT_DEPTH){
+        /* What it does deeper is not known. */
+        *effects = 1;
+        return 0;
+    }
+    if(node->var->type == TL_T_NAME){
+        if(!call_find_param(params, node->var, &n)) return 0;
+        if(n < names->childnum && ((Node**)names->childs)[n]->childnum){
+            /* A hidden parameter forces what its expression forces. */
+            return call_forces(lisp, call_let(names, n), params, names, self,
+                               effects, depth+1);
+        }
+        return n < TL_STRICT_MAX ? 1<<n : 0;
+    }
+    if(node->var->type != TL_T_CALL) return 0;
+    if(call_is_self(node, names)){
+        /* A recursive call forces the arguments of the parameters the
+         * function is assumed to be strict in, before running its body. */
+        for(i=0;i<node->childnum;i++){
+            later = 0;
+            if(i < TL_STRICT_MAX && self & (1<<i)){
+                mask |= call_forces(lisp, ((Node**)node->childs)[i], params,
+                                    names, self, effects, depth+1);
+                continue;
+            }
+            call_forces(lisp, ((Node**)node->childs)[i], params, names, self,
+                        &later, depth+1);
+            if(later) *effects = 1;
+        }
+        *effects = 1;
+        return mask;
+    }
+    if(call_find_func(lisp, &node->var->items->call.function, &function) ||
+       !function->builtin){
+        /* A user defined function may have side effects before it uses its
+         * arguments. */
+        *effects = 1;
+        return 0;
+    }
+    num = TL_MIN((size_t)function->parseargs, node->childnum);
+    for(i=0;i<num;i++){
+        mask |= call_forces(lisp, ((Node**)node->childs)[i], params, names,
+                            self, effects, depth+1);
+    }
+    if(function->ptr.f == builtin_if && node->childnum == 3 && !*effects){
+        /* What both branches force is forced, whichever is taken. */
+        later = 0;
+        other = call_forces(lisp, ((Node**)node->childs)[1], params, names,
+                            self, &later, depth+1);
+        if(later) *effects = 1;
+        later = 0;
+        other &= call_forces(lisp, ((Node**)node->childs)[2], params, names,
+                             self, &later, depth+1);
+        if(later) *effects = 1;
+        return mask | other;
+    }
+    /* The other arguments may be evaluated, or not. */
+    for(i=num;i<node->childnum;i++){
+        later = 0;
+        call_forces(lisp, ((Node**)node->childs)[i], params, names, self,
+                    &later, depth+1);
+        if(later) *effects = 1;
+    }
+    if(!function->pure) *effects = 1;
+    return mask;
+}
+
+unsigned short call_strict_params(LizyLang *lisp, Node *fncdef,
+                                  Var *params) {
+    size_t i;
+    unsigned short self = (unsigned short)~0U;
+    unsigned short mask;
+    char effects;
+    /* It is first assumed to be strict in all of its parameters where it
+     * calls itself, then in the ones found until they do not change. */
+    for(;;){
+        mask = 0;
+        effects = 0;
+        /* Every node of the body is evaluated, one after the other. */
+        for(i=2;i<fncdef->childnum;i++){
+            mask |= call_forces(lisp, ((Node**)fncdef->childs)[i], params,
+                                ((Node**)fncdef->childs)[1], self, &effects,
+                                0);
+        }
+        mask &= self;
+        if(mask == self) return mask;
+        self = mask;
+    }
+}
+
+char call_pure_body(LizyLang *lisp, Node *root, Var *params, String *name) {
+    Function *function;
+    String *called;
+    Node *node;
+    size_t n;
+    for(node=root;node;node=node_next(root, node)){
+        /* Globals may change, so only the parameters can be used. */
+        if(node->var->type == TL_T_NAME){
+            if(!call_find_param(params, node->var, &n)) return 0;
+            continue;
+        }
+        if(node->var->type != TL_T_CALL) continue;
+        if(node->var->size != 1) return 0;
+        called = &node->var->items->call.function;
+        if(called->len != name->len ||
+           memcmp(VAR_RAW_STR_DATA(called), VAR_RAW_STR_DATA(name),
+                  called->len)){
+            /* The function is only defined once its body was checked. */
+            if(call_find_func(lisp, called, &function) || !function->pure){
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+char call_pure_func(LizyLang *lisp, Node *fncdef, Var *params,
+                    String *name) {
+    Node *names = ((Node**)fncdef->childs)[1];
+    size_t i;
+    for(i=2;i<fncdef->childnum;i++){
+        if(!call_pure_body(lisp, ((Node**)fncdef->childs)[i], params, name)){
+            return 0;
+        }
+    }
+    /* The expressions of the hidden parameters too. */
+    for(i=0;i<names->childnum;i++){
+        if(((Node**)names->childs)[i]->childnum &&
+           !call_pure_body(lisp, call_let(names, i), params, name)){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Checks again if the user defined functions are pure, once a function they
+ * may call was deleted or replaced, so that their results are not cached
+ * anymore if they are not. */
+int call_check_pure(LizyLang *lisp) {
+    Function *function;
+    Node *node;
+    size_t i;
+    char changed;
+    /* The calls remember if the function they called was pure. */
+    for(node=&lisp->node;node;node=node_next(&lisp->node, node)){
+        node->pure = TL_PURE_UNKNOWN;
+    }
+    /* The functions that call a function that is not pure anymore are not
+     * pure either. */
+    do{
+        changed = 0;
+        for(i=0;i<lisp->var_num;i++){
+            if(lisp->vars[i].type != TL_T_FUNC || !VAR_LEN(lisp->vars+i)){
                 continue;
             }
-            if(!memcmp(lisp->var_names[i].data,
-                       node->var->items->call.function.data,
-                       lisp->var_names[i].len)){
-                function = &lisp->vars[i].items->function;
-                found = 1;
+            function = &lisp->vars[i].items->function;
+            if(function->builtin || !function->pure) continue;
+            if(!call_pure_func(lisp, function->ptr.fncdef, function->params,
+                               lisp->var_names+i)){
+                function->pure = 0;
+                function->memo = 0;
+                changed = 1;
+            }
+        }
+    }while(changed);
+    return TL_SUCCESS;
+}
+
+char call_pure(LizyLang *lisp, Node *node, size_t context) {
+    Function *function;
+    Arg *arg;
+    size_t i, n;
+    if(node->var->type == TL_T_NAME){
+        if(!context ||
+           !call_node_param(node, TL_FRAME(lisp, context-1)->function->params,
+                            &n)){
+            return 1;
+        }
+        arg = TL_FRAME(lisp, context-1)->args+n;
+        if(arg->thunk) arg = arg->thunk;
+        if(arg->evaluated) return 1;
+        return call_pure(lisp, arg->node, arg->context);
+    }
+    if(node->var->type != TL_T_CALL) return 1;
+    if(node->pure == TL_PURE_UNKNOWN){
+        node->pure = !call_find_func(lisp, &node->var->items->call.function,
+                                     &function) && function->builtin &&
+                     function->pure;
+    }
+    if(!node->pure) return 0;
+    for(i=0;i<node->childnum;i++){
+        if(!call_pure(lisp, ((Node**)node->childs)[i], context)) return 0;
+    }
+    return 1;
+}
+
+int call_free_args(LizyLang *lisp, Arg *args, size_t argnum) {
+    size_t i;
+    for(i=0;i<argnum;i++){
+        if(args[i].evaluated) var_free(&lisp->alloc, &args[i].value);
+    }
+    return TL_SUCCESS;
+}
+
+int call_keep(LizyLang *lisp, Frame *frame, Var *var, Arg *others,
+              size_t othernum) {
+    Arg *arg;
+    size_t argnum = VAR_LEN((Var*)frame->function->params);
+    size_t i, n;
+    /* var outlives the arguments of the frame, it cannot stay a view of one
+     * of them. */
+    if(!var->ref || !var->base) return TL_SUCCESS;
+    for(n=0;n<argnum;n++){
+        arg = frame->args+n;
+        if(arg->thunk || !arg->evaluated || !var_borrows(var, &arg->value)){
+            continue;
+        }
+        for(i=0;i<othernum;i++){
+            if(others[i].evaluated &&
+               var_borrows(&others[i].value, &arg->value)){
+                break;
+            }
+        }
+        if(i == othernum) return var_take(&lisp->alloc, var, &arg->value);
+        /* Another view of it takes it later. */
+        return call_own(lisp, var);
+    }
+    return TL_SUCCESS;
+}
+
+int call_own(LizyLang *lisp, Var *value) {
+    Var copy;
+    int rc;
+    rc = var_copy(&lisp->alloc, value, &copy);
+    if(rc) return rc;
+    var_free(&lisp->alloc, value);
+    *value = copy;
+    return TL_SUCCESS;
+}
+
+int call_unlend(LizyLang *lisp, Frame *frame, Var *var) {
+    Cont *cont;
+    size_t argnum = VAR_LEN((Var*)frame->function->params);
+    size_t i, n;
+    int rc;
+    /* var is replaced while the frame runs: the views of it can only be in
+     * the other arguments of the frame or in the continuations, they get a
+     * copy. */
+    for(n=0;n<argnum;n++){
+        if(frame->args[n].evaluated &&
+           var_borrows(&frame->args[n].value, var)){
+            rc = call_own(lisp, &frame->args[n].value);
+            if(rc) return rc;
+        }
+    }
+    for(i=0;i<lisp->cont_cur;i++){
+        cont = TL_CONT(lisp, i);
+        for(n=0;cont->args && n<cont->argnum;n++){
+            if(cont->args[n].evaluated &&
+               var_borrows(&cont->args[n].value, var)){
+                rc = call_own(lisp, &cont->args[n].value);
+                if(rc) return rc;
             }
         }
+        if(cont->tmp_set && var_borrows(&cont->tmp, var)){
+            rc = call_own(lisp, &cont->tmp);
+            if(rc) return rc;
+        }
+    }
+    return TL_SUCCESS;
+}
+
+int call_alloc_args(LizyLang *lisp, size_t argnum, Arg **args,
+                    size_t *chunk) {
+    ArgChunk *chunks;
+    ArgChunk *current;
+    size_t size;
+    /* The arguments are released in the reverse order, so the chunks after
+     * the current one are all empty. */
+    while(lisp->arg_chunk_cur < lisp->arg_chunk_num){
+        current = lisp->arg_chunks+lisp->arg_chunk_cur;
+        if(current->used+argnum <= current->size){
+            *args = current->args+current->used;
+            *chunk = lisp->arg_chunk_cur;
+            current->used += argnum;
+            return TL_SUCCESS;
+        }
+        lisp->arg_chunk_cur++;
+    }
+    chunks = TL_REALLOC(&lisp->alloc, lisp->arg_chunks,
+                        (lisp->arg_chunk_num+1)*sizeof(ArgChunk));
+    if(!chunks) return TL_ERR_OUT_OF_MEM;
+    lisp->arg_chunks = chunks;
+    current = chunks+lisp->arg_chunk_num;
+    size = argnum > TL_ARG_CHUNK_SZ ? argnum : TL_ARG_CHUNK_SZ;
+    current->args = TL_MALLOC(&lisp->alloc, size*sizeof(Arg));
+    if(!current->args) return TL_ERR_OUT_OF_MEM;
+    current->size = size;
+    current->used = argnum;
+    *args = current->args;
+    *chunk = lisp->arg_chunk_num;
+    lisp->arg_chunk_cur = lisp->arg_chunk_num++;
+    return TL_SUCCESS;
+}
+
+int call_release_args(LizyLang *lisp, size_t argnum, size_t chunk) {
+    lisp->arg_chunks[chunk].used -= argnum;
+    lisp->arg_chunk_cur = chunk;
+    return TL_SUCCESS;
+}
+
+int call_push_frame(LizyLang *lisp, Function *function, Node *node,
+                    size_t offset) {
+    Frame **frames;
+    Frame *frame;
+    Node *child;
+    Arg *arg;
+    size_t i, n;
+    size_t argnum = VAR_LEN((Var*)function->params);
+    size_t passed = argnum-function->lets;
+    int rc;
+    if(lisp->stack_cur >= TL_MAX_DEPTH) return TL_ERR_STACK_OVERFLOW;
+    if(lisp->stack_cur == lisp->frame_segs*TL_FRAME_SEG_SZ){
+        /* Add a segment. */
+        frames = TL_REALLOC(&lisp->alloc, lisp->frames,
+                            (lisp->frame_segs+1)*sizeof(Frame*));
+        if(!frames) return TL_ERR_OUT_OF_MEM;
+        lisp->frames = frames;
+        frames[lisp->frame_segs] = TL_MALLOC(&lisp->alloc,
+                                             TL_FRAME_SEG_SZ*sizeof(Frame));
+        if(!frames[lisp->frame_segs]) return TL_ERR_OUT_OF_MEM;
+        lisp->frame_segs++;
+    }
+    frame = TL_FRAME(lisp, lisp->stack_cur);
+    rc = call_alloc_args(lisp, argnum, &frame->args, &frame->arg_chunk);
+    if(rc) return rc;
+    for(i=0;i<passed;i++){
+        /* The arguments are evaluated lazily, in the context of the call. */
+        child = ((Node**)node->childs)[offset+i];
+        frame->args[i].node = child;
+        frame->args[i].context = lisp->context;
+        frame->args[i].evaluated = 0;
+        frame->args[i].thunk = NULL;
+        if(child->var->type == TL_T_NAME && lisp->context &&
+           call_node_param(child,
+                           TL_FRAME(lisp, lisp->context-1)->function->params,
+                           &n)){
+            /* A parameter passed through shares the argument. */
+            arg = TL_FRAME(lisp, lisp->context-1)->args+n;
+            frame->args[i].thunk = arg->thunk ? arg->thunk : arg;
+        }
+    }
+    call_init_lets(function, frame->args, lisp->stack_cur+1);
+    frame->function = function;
+    frame->call = node;
+    frame->parent = lisp->context;
+#if TL_DEBUG_STACK
+    printf("Added to stack at %ld!\n", lisp->stack_cur);
+#endif
+    lisp->stack_cur++;
+    return TL_SUCCESS;
+}
+
+int call_init_lets(Function *function, Arg *args, size_t context) {
+    Node *names = ((Node**)((Node*)function->ptr.fncdef)->childs)[1];
+    size_t argnum = VAR_LEN((Var*)function->params);
+    size_t i;
+    /* Hidden parameters are evaluated lazily too, but in the frame. */
+    for(i=argnum-function->lets;i<argnum;i++){
+        args[i].node = call_let(names, i);
+        args[i].context = context;
+        args[i].evaluated = 0;
+        args[i].thunk = NULL;
+    }
+    return TL_SUCCESS;
+}
+
+int call_pop_frame(LizyLang *lisp) {
+    Frame *frame;
+    size_t argnum;
+    lisp->stack_cur--;
+    frame = TL_FRAME(lisp, lisp->stack_cur);
+    argnum = VAR_LEN((Var*)frame->function->params);
+    call_free_args(lisp, frame->args, argnum);
+    call_release_args(lisp, argnum, frame->arg_chunk);
+    frame->args = NULL;
+#if TL_DEBUG_STACK
+    printf("Removed %ld from stack!\n", lisp->stack_cur);
+#endif
+    return TL_SUCCESS;
+}
+
+int call_push_cont(LizyLang *lisp, Node *node, size_t context, Var *dest,
+                   char *done, char tail) {
+    Cont **conts;
+    Cont *cont;
+    if(lisp->cont_cur == lisp->cont_segs*TL_CONT_SEG_SZ){
+        /* Add a segment. */
+        conts = TL_REALLOC(&lisp->alloc, lisp->conts,
+                           (lisp->cont_segs+1)*sizeof(Cont*));
+        if(!conts) return TL_ERR_OUT_OF_MEM;
+        lisp->conts = conts;
+        conts[lisp->cont_segs] = TL_MALLOC(&lisp->alloc,
+                                           TL_CONT_SEG_SZ*sizeof(Cont));
+        if(!conts[lisp->cont_segs]) return TL_ERR_OUT_OF_MEM;
+        lisp->cont_segs++;
     }
-    if(!found){
-        return TL_ERR_FUNC_NOT_DEF;
+    cont = TL_CONT(lisp, lisp->cont_cur);
+    cont->node = node;
+    cont->context = context;
+    cont->dest = dest;
+    cont->done = done;
+    cont->function = NULL;
+    cont->offset = 0;
+    cont->args = NULL;
+    cont->argnum = 0;
+    cont->evalnum = 0;
+    cont->i = 0;
+    cont->tmp_set = 0;
+    cont->then_node = NULL;
+    cont->state = TL_C_START;
+    cont->tail = tail;
+    cont->memo = NULL;
+    cont->code = NULL;
+    cont->sp = 0;
+    cont->loop = TL_LOOP_WHILE;
+    cont->loop_num = 0;
+    cont->loop_end = 0;
+    lisp->cont_cur++;
+    return TL_SUCCESS;
+}
+
+int call_push_node(LizyLang *lisp, Node *node, size_t context, Var *dest,
+                   char *done) {
+    Code *code = node->code;
+    Cont *cont;
+    int rc;
+    rc = call_push_cont(lisp, node, context, dest, done, 0);
+    if(rc) return rc;
+    if(code && code->gen == lisp->code_gen && lisp->opt & TL_OPT_BYTECODE){
+        /* The node was compiled with the function it is in. */
+        cont = TL_CONT(lisp, lisp->cont_cur-1);
+        cont->state = TL_C_EXPR;
+        cont->i = node->offset;
+        cont->code = code;
+    }
+    return TL_SUCCESS;
+}
+
+int call_free_cont_args(LizyLang *lisp, Cont *cont) {
+    if(!cont->args) return TL_SUCCESS;
+    call_free_args(lisp, cont->args, cont->argnum);
+    call_release_args(lisp, cont->argnum, cont->arg_chunk);
+    cont->args = NULL;
+    cont->argnum = 0;
+    return TL_SUCCESS;
+}
+
+int call_pop_cont(LizyLang *lisp) {
+    Cont *cont = TL_CONT(lisp, lisp->cont_cur-1);
+    /* The arguments of a tail call are after the ones of the frame. */
+    call_free_cont_args(lisp, cont);
+    if(cont->tmp_set) var_free(&lisp->alloc, &cont->tmp);
+    if(cont->memo) memo_free_entry(lisp, cont->memo);
+    if(cont->state == TL_C_STRICT || cont->state == TL_C_MEMO ||
+       cont->state == TL_C_BODY || cont->state == TL_C_VM ||
+       cont->state == TL_C_TAIL){
+        call_pop_frame(lisp);
     }
+    lisp->cont_cur--;
+    return TL_SUCCESS;
+}
+
+int call_cont_args(LizyLang *lisp, Cont *cont) {
+    Node *node = cont->node;
+    size_t i;
+    int rc;
+    rc = call_alloc_args(lisp, node->childnum, &cont->args, &cont->arg_chunk);
+    if(rc) return rc;
+    cont->argnum = node->childnum;
+    for(i=0;i<cont->argnum;i++){
+        cont->args[i].node = ((Node**)node->childs)[i];
+        cont->args[i].context = cont->context;
+        cont->args[i].evaluated = 0;
+        cont->args[i].thunk = NULL;
+    }
+    return TL_SUCCESS;
+}
+
+int call_start(LizyLang *lisp, Cont *cont) {
+    Node *node = cont->node;
+    Function *function;
+    Cont *caller;
+    int rc;
+    if(!cont->function){
+        if(node->var->type != TL_T_CALL){
+            return TL_ERR_VALUE_OUTSIDE_OF_CALL;
+        }
+        if(node->var->size != 1){
+            return TL_ERR_INVALID_LIST_SIZE;
+        }
+#if TL_DEBUG_CALL
+        fputs("Calling \"", stdout);
+        fwrite(VAR_RAW_STR_DATA(&node->var->items->call.function), 1,
+               node->var->items->call.function.len, stdout);
+        puts("\"");
+#endif
+        rc = call_node_func(lisp, node, &cont->function);
+        if(rc) return rc;
+    }
+    function = cont->function;
     if(function->builtin){
-        /* Call the right builtin function. */
-        rc = function->ptr.f(lisp, node, node->childnum, returned);
+        /* Builtin functions get their arguments from the whole node. */
+        if(cont->offset) return TL_ERR_BAD_TYPE;
+        cont->state = TL_C_BUILTIN;
+        cont->evalnum = 0;
+        if(!function->parseargs || !node->childnum){
+            return call_builtin(lisp, cont);
+        }
+        /* The first arguments are evaluated before calling it. */
+        cont->state = TL_C_ARGS;
+        cont->i = 0;
+        cont->evalnum = TL_MIN((size_t)function->parseargs, node->childnum);
+        rc = call_cont_args(lisp, cont);
         if(rc) return rc;
+        return call_eval_args(lisp, cont);
+    }
+    if(node->childnum-cont->offset <
+       VAR_LEN((Var*)function->params)-function->lets){
+        return TL_ERR_TOO_FEW_ARGS;
+    }
+    if(node->childnum-cont->offset >
+       VAR_LEN((Var*)function->params)-function->lets){
+        return TL_ERR_TOO_MANY_ARGS;
+    }
+    if(cont->tail && !call_needs_frame(lisp, cont, function)){
+        /* The function we are in performs the call once its body returned,
+         * in its own frame. */
+        caller = TL_CONT(lisp, lisp->cont_cur-2);
+        caller->then_node = node;
+        caller->then_function = function;
+        caller->then_offset = cont->offset;
+        return call_pop_cont(lisp);
+    }
+    rc = call_push_frame(lisp, function, node, cont->offset);
+    if(rc) return rc;
+    /* The body is evaluated in the new frame. */
+    cont->context = lisp->stack_cur;
+    if(function->strict){
+        cont->state = TL_C_STRICT;
+        cont->i = 0;
+    }else if(function->memo && lisp->opt & TL_OPT_MEMO){
+        cont->state = TL_C_MEMO;
+        cont->i = 0;
     }else{
-        if(node->childnum < VAR_LEN((Var*)function->params)){
-            return TL_ERR_TOO_FEW_ARGS;
-        }
-        if(node->childnum > VAR_LEN((Var*)function->params)){
-            return TL_ERR_TOO_MANY_ARGS;
-        }
-        lisp->stack[lisp->stack_cur].parent = lisp->context;
-        lisp->stack[lisp->stack_cur].call = node;
-        lisp->stack[lisp->stack_cur].function = function;
-        lisp->stack[lisp->stack_cur].args =
-                malloc(((Node*)function->ptr.fncdef)->childnum*sizeof(Var));
-        lisp->stack[lisp->stack_cur].evaluated =
-                malloc(((Node*)function->ptr.fncdef)->childnum*sizeof(char));
-        memset(lisp->stack[lisp->stack_cur].evaluated, 0,
-               ((Node*)function->ptr.fncdef)->childnum*sizeof(char));
-#if TL_DEBUG_STACK
-        printf("Added to stack at %ld!\n", lisp->stack_cur);
+        call_enter_body(lisp, cont);
+    }
+#if TL_DEBUG_CONTEXT
+    printf("Context: %ld\n", cont->context);
 #endif
+    return TL_SUCCESS;
+}
+
+int call_find_arg(LizyLang *lisp, Cont *cont, size_t idx, Var **var,
+                  char *constant, size_t *context, char parse) {
+    Node *child = ((Node**)((Node*)cont->node)->childs)[idx];
+    Var *src = child->var;
+    Arg *arg;
+    size_t n;
+    int rc;
+    *constant = child->constant;
+    *context = cont->context;
+    /* A name is first looked up in the parameters of the function the call is
+     * in. A parameter that was passed through uses the argument of the call
+     * that passed it first, other names passed are global. */
+    if(parse && src->type == TL_T_NAME && *context &&
+       call_node_param(child, TL_FRAME(lisp, *context-1)->function->params,
+                       &n)){
+        arg = TL_FRAME(lisp, *context-1)->args+n;
+        if(arg->thunk) arg = arg->thunk;
+        if(arg->evaluated){
+            src = &arg->value;
+            *constant = 0;
+        }else{
+            src = ((Node*)arg->node)->var;
+            *constant = ((Node*)arg->node)->constant;
+            *context = arg->context;
+            if(src->type == TL_T_CALL){
 #if TL_DEBUG_CONTEXT
-    puts("    NEW CONTEXT CREATED!");
-    puts("--------");
-    printf("Context: %ld\n", lisp->stack_cur+1);
-    printf("Index: %ld\n", lisp->stack_cur);
-    fputs("Function definition of: ",
-            stdout);
-    fwrite(((Node**)((Node*)function->ptr.fncdef)
-            ->childs)[0]->var->items->string.data, 1,
-            ((Node**)((Node*)function->ptr.fncdef)
-            ->childs)[0]->var->items->string.len,
-            stdout);
-    fputs("\n", stdout);
-    fputs("Parameter definition function name: ",
-            stdout);
-    fwrite(((Node**)((Node*)function->ptr.fncdef)
-            ->childs)[1]->var->items->string.data, 1,
-            ((Node**)((Node*)function->ptr.fncdef)
-            ->childs)[1]->var->items->string.len,
-            stdout);
-    fputs("\n", stdout);
-    printf("Parent context: %ld\n", lisp->stack[lisp->stack_cur].parent);
-    puts("--------");
+                printf("Evaluating argument %ld in context %ld\n", n,
+                       *context);
 #endif
-        lisp->stack_cur++;
-        old_ctx = lisp->context;
-        lisp->context = lisp->stack_cur;
-        if(lisp->stack_cur >= TL_STACK_SZ) return TL_ERR_STACK_OVERFLOW;
-        line = lisp->line;
-        for(i=2;i<((Node*)function->ptr.fncdef)->childnum;i++){
-            rc = call_exec(lisp,
-                           ((Node**)((Node*)function->ptr.fncdef)->childs)[i],
-                           &call_return);
-            if(rc){
-                lisp->line =
-                    ((Node**)((Node*)function->ptr.fncdef)->childs)[i]->line;
-                lisp->context--;
-                return rc;
+                rc = call_push_node(lisp, arg->node, arg->context,
+                                    &arg->value, &arg->evaluated);
+                return rc ? rc : TL_PENDING;
             }
-            if(i < ((Node*)function->ptr.fncdef)->childnum-1){
-                var_free(&call_return);
+        }
+    }
+    if(src->type == TL_T_CALL){
+        /* Only the argument itself can still be a call, its value is kept
+         * until the function returns. */
+        if(!cont->args){
+            rc = call_cont_args(lisp, cont);
+            if(rc) return rc;
+        }
+        arg = cont->args+idx;
+        if(!arg->evaluated){
+            rc = call_push_node(lisp, child, cont->context, &arg->value,
+                                &arg->evaluated);
+            return rc ? rc : TL_PENDING;
+        }
+        src = &arg->value;
+        *constant = 0;
+    }
+    *var = src;
+    return TL_SUCCESS;
+}
+
+int call_eval_args(LizyLang *lisp, Cont *cont) {
+    Arg *arg;
+    Var *src;
+    Var parsed;
+    size_t context;
+    char constant;
+    int rc;
+    for(;cont->i<cont->evalnum;cont->i++){
+        arg = cont->args+cont->i;
+        if(arg->evaluated){
+            /* The argument is a call that returned. */
+            if(arg->value.type == TL_T_NAME){
+                rc = call_parse_arg(lisp, &arg->value, &parsed,
+                                    cont->context);
+                if(rc) return rc;
+                var_free(&lisp->alloc, &arg->value);
+                arg->value = parsed;
             }
+            continue;
         }
-        *returned = call_return;
-        lisp->line = line;
-        lisp->stack_cur--;
-        lisp->context = old_ctx;
-        if(((Node*)lisp->stack[lisp->stack_cur].function->ptr.fncdef)
-           ->childnum){
-            if(lisp->stack[lisp->stack_cur].evaluated){
-                for(i=0;i<((Node**)((Node*)lisp->stack[lisp->stack_cur]
-                           .function->ptr.fncdef)->childs)[1]->childnum;i++){
-                    if(lisp->stack[lisp->stack_cur].evaluated[i]){
-                        var_free(lisp->stack[lisp->stack_cur].args+i);
-                    }
+        if(((Node*)arg->node)->constant &&
+           ((Node*)arg->node)->var->type != TL_T_NAME){
+            /* Constants never change, so there is no need to copy them. */
+            var_ref(((Node*)arg->node)->var, &arg->value);
+            arg->evaluated = 1;
+            continue;
+        }
+        if(((Node*)arg->node)->var->type == TL_T_CALL){
+            return call_push_node(lisp, arg->node, cont->context, &arg->value,
+                                  &arg->evaluated);
+        }
+        rc = call_find_arg(lisp, cont, cont->i, &src, &constant, &context, 1);
+        if(rc == TL_PENDING) return TL_SUCCESS;
+        if(rc) return rc;
+        if(src->type == TL_T_NAME){
+            rc = call_parse_arg(lisp, src, &arg->value, context);
+        }else if(constant || (!cont->i && builtin_borrows(cont->function))){
+            /* A parameter is only lent, what is returned may be a view of it
+             * that call_keep gives its storage to later. */
+            rc = var_ref(src, &arg->value);
+        }else{
+            rc = var_copy(&lisp->alloc, src, &arg->value);
+        }
+        if(rc) return rc;
+        arg->evaluated = 1;
+    }
+    cont->state = TL_C_BUILTIN;
+    return call_builtin(lisp, cont);
+}
+
+int call_builtin(LizyLang *lisp, Cont *cont) {
+    Node *node = cont->node;
+    int rc;
+    lisp->context = cont->context;
+    rc = cont->function->ptr.f(lisp, node, node->childnum, cont->dest);
+    if(rc == TL_PENDING){
+        if(cont->then_node){
+            /* Perform another call instead. */
+            call_free_cont_args(lisp, cont);
+            cont->node = cont->then_node;
+            cont->function = cont->then_function;
+            cont->offset = cont->then_offset;
+            cont->then_node = NULL;
+            cont->state = TL_C_START;
+        }
+        /* Otherwise the function is called again once what it needs is
+         * evaluated. */
+        return TL_SUCCESS;
+    }
+    if(rc) return rc;
+    if(cont->done) *cont->done = 1;
+    return call_pop_cont(lisp);
+}
+
+int call_strict(LizyLang *lisp, Cont *cont) {
+    Frame *frame = TL_FRAME(lisp, cont->context-1);
+    Arg *arg;
+    size_t argnum = VAR_LEN((Var*)frame->function->params);
+    while(cont->i < argnum && cont->i < TL_STRICT_MAX){
+        arg = frame->args+cont->i;
+        if(arg->thunk) arg = arg->thunk;
+        cont->i++;
+        /* Evaluating a pure argument that is used before any side effect
+         * earlier does not change anything, but it does not have to be
+         * looked up and evaluated lazily later. */
+        if(!(frame->function->strict & (1<<(cont->i-1))) || arg->evaluated ||
+           ((Node*)arg->node)->var->type != TL_T_CALL ||
+           !call_pure(lisp, arg->node, arg->context)){
+            continue;
+        }
+        return call_push_node(lisp, arg->node, arg->context, &arg->value,
+                              &arg->evaluated);
+    }
+    if(frame->function->memo && lisp->opt & TL_OPT_MEMO){
+        cont->state = TL_C_MEMO;
+        cont->i = 0;
+        return TL_SUCCESS;
+    }
+    return call_enter_body(lisp, cont);
+}
+
+int call_memo(LizyLang *lisp, Cont *cont) {
+    Frame *frame = TL_FRAME(lisp, cont->context-1);
+    Function *function = frame->function;
+    Var *values[TL_STRICT_MAX];
+    MemoEntry *entry;
+    Node *node;
+    Arg *arg;
+    size_t passed = VAR_LEN((Var*)function->params)-function->lets;
+    size_t i;
+    unsigned long hash;
+    int rc;
+    /* Every argument is used, so they can all be evaluated now. */
+    for(;cont->i<passed;cont->i++){
+        arg = frame->args+cont->i;
+        if(arg->thunk) arg = arg->thunk;
+        node = arg->node;
+        if(arg->evaluated) continue;
+        if(node->var->type == TL_T_CALL){
+            if(!call_pure(lisp, node, arg->context)){
+                /* Evaluating it now could change the order of the side
+                 * effects. */
+                return call_enter_body(lisp, cont);
+            }
+            return call_push_node(lisp, node, arg->context, &arg->value,
+                                  &arg->evaluated);
+        }
+        if(node->var->type == TL_T_NAME){
+            rc = call_parse_arg(lisp, node->var, &arg->value, arg->context);
+            if(rc) return rc;
+            arg->evaluated = 1;
+        }
+    }
+    for(i=0;i<passed;i++){
+        arg = frame->args+i;
+        if(arg->thunk) arg = arg->thunk;
+        values[i] = arg->evaluated ? &arg->value : ((Node*)arg->node)->var;
+        if(VAR_LEN(values[i]) > TL_MEMO_ARG_MAX){
+            return call_enter_body(lisp, cont);
+        }
+    }
+    hash = memo_hash(values, passed);
+    entry = memo_find(lisp, function->ptr.fncdef, values, passed, hash);
+    if(entry){
+        rc = var_copy(&lisp->alloc, &entry->value, cont->dest);
+        if(rc) return rc;
+        if(cont->done) *cont->done = 1;
+        return call_pop_cont(lisp);
+    }
+    /* The result is cached once the body returned, if there is memory left
+     * for it. */
+    if(memo_new(lisp, function->ptr.fncdef, values, passed, hash,
+                &cont->memo)){
+        cont->memo = NULL;
+    }
+    return call_enter_body(lisp, cont);
+}
+
+int call_enter_body(LizyLang *lisp, Cont *cont) {
+    Function *function = TL_FRAME(lisp, cont->context-1)->function;
+    Code *code = function->code;
+    cont->state = TL_C_BODY;
+    cont->i = 2;
+    if(!(lisp->opt & TL_OPT_BYTECODE)) return TL_SUCCESS;
+    if(!code || code->gen != lisp->code_gen){
+        /* The tree is evaluated if there is no memory left to compile it. */
+        if(vm_compile(lisp, function)) return TL_SUCCESS;
+        code = function->code;
+    }
+    if(code->size){
+        cont->state = TL_C_VM;
+        cont->i = 0;
+        cont->code = code;
+    }
+    return TL_SUCCESS;
+}
+
+int call_body(LizyLang *lisp, Cont *cont) {
+    Node *fncdef = TL_FRAME(lisp, cont->context-1)->function->ptr.fncdef;
+    Node *body;
+    char last;
+    if(cont->tmp_set){
+        var_free(&lisp->alloc, &cont->tmp);
+        cont->tmp_set = 0;
+    }
+    if(cont->i < fncdef->childnum){
+        body = ((Node**)fncdef->childs)[cont->i];
+        /* The last call of the body is in tail position, and returns the
+         * value of the function. */
+        last = cont->i == fncdef->childnum-1;
+        cont->i++;
+        if(last){
+            return call_push_cont(lisp, body, cont->context, cont->dest, NULL,
+                                  1);
+        }
+        return call_push_cont(lisp, body, cont->context, &cont->tmp,
+                              &cont->tmp_set, 0);
+    }
+    return call_end_body(lisp, cont);
+}
+
+int call_end_body(LizyLang *lisp, Cont *cont) {
+    int rc;
+    if(cont->then_node){
+        cont->state = TL_C_TAIL;
+        cont->i = 0;
+        return TL_SUCCESS;
+    }
+    rc = call_keep(lisp, TL_FRAME(lisp, cont->context-1), cont->dest, NULL,
+                   0);
+    if(rc) return rc;
+    if(cont->memo){
+        rc = memo_add(lisp, cont->memo, cont->dest);
+        cont->memo = NULL;
+        if(rc) return rc;
+    }
+    if(cont->done) *cont->done = 1;
+    return call_pop_cont(lisp);
+}
+
+char call_needs_frame(LizyLang *lisp, Cont *cont, Function *function) {
+    Node *node = cont->node;
+    Node *child;
+    Frame *frame = TL_FRAME(lisp, cont->context-1);
+    Var *params = frame->function->params;
+    Arg *arg;
+    size_t passed = VAR_LEN((Var*)function->params)-function->lets;
+    size_t i, n;
+    for(i=0;i<passed;i++){
+        child = ((Node**)node->childs)[cont->offset+i];
+        if(child->var->type == TL_T_NAME &&
+           call_node_param(child, params, &n)){
+            /* A hidden parameter that was not evaluated yet is evaluated in
+             * the frame. */
+            arg = frame->args+n;
+            if(!arg->thunk && !arg->evaluated &&
+               arg->context == cont->context){
+                return 1;
+            }
+        }else if(child->var->type == TL_T_CALL &&
+                 call_uses_params(child, params) &&
+                 !(i < TL_STRICT_MAX && function->strict & (1<<i) &&
+                   call_pure(lisp, child, cont->context))){
+            /* It may never be evaluated, so it cannot be evaluated before
+             * the frame is reused. */
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int call_tail_frame(LizyLang *lisp, Cont *cont) {
+    Node *node = cont->then_node;
+    Node *child;
+    Function *function = cont->then_function;
+    size_t offset = cont->then_offset;
+    Frame *frame = TL_FRAME(lisp, cont->context-1);
+    Var *params = frame->function->params;
+    Arg *args;
+    Arg *arg;
+    size_t argnum = VAR_LEN((Var*)function->params);
+    size_t passed = argnum-function->lets;
+    size_t i, n;
+    int rc;
+    if(!cont->args){
+        /* The new arguments are put after the ones of the frame, as they may
+         * need them, and then moved down. */
+        rc = call_alloc_args(lisp, argnum, &cont->args, &cont->arg_chunk);
+        if(rc) return rc;
+        cont->argnum = argnum;
+        args = cont->args;
+        for(i=0;i<argnum;i++){
+            args[i].evaluated = 0;
+            args[i].thunk = NULL;
+        }
+        for(i=0;i<passed;i++){
+            child = ((Node**)node->childs)[offset+i];
+            /* Constants, global names and expressions that do not use the
+             * parameters of the current function do not need its frame. */
+            args[i].node = child;
+            args[i].context = 0;
+            if(child->var->type == TL_T_NAME &&
+               call_node_param(child, params, &n)){
+                /* Pass the argument of the current function through. */
+                arg = frame->args+n;
+                if(arg->thunk){
+                    /* It was passed through already, and its frame is not
+                     * the one that is reused. */
+                    args[i].thunk = arg->thunk;
+                    continue;
                 }
+                args[i].node = arg->node;
+                args[i].context = arg->context;
+                if(arg->evaluated){
+                    rc = var_copy(&lisp->alloc, &arg->value, &args[i].value);
+                    if(rc) return rc;
+                    args[i].evaluated = 1;
+                }
+            }else if(child->var->type == TL_T_CALL &&
+                     i < TL_STRICT_MAX && function->strict & (1<<i) &&
+                     call_pure(lisp, child, cont->context)){
+                /* Strict pure arguments would be evaluated anyway, so they
+                 * are evaluated now, in the frame that is about to be
+                 * reused. The other ones do not need it, or the call would
+                 * not reuse it. */
+                args[i].context = cont->context;
             }
-            free(lisp->stack[lisp->stack_cur].args);
-            lisp->stack[lisp->stack_cur].args = NULL;
-            free(lisp->stack[lisp->stack_cur].evaluated);
-            lisp->stack[lisp->stack_cur].evaluated = NULL;
+        }
+    }
+    args = cont->args;
+    for(;cont->i<passed;cont->i++){
+        /* Passed through arguments come from the callers of the frame. */
+        if(args[cont->i].context == cont->context &&
+           !args[cont->i].evaluated){
+            return call_push_node(lisp, args[cont->i].node, cont->context,
+                                  &args[cont->i].value,
+                                  &args[cont->i].evaluated);
+        }
+    }
+    for(i=0;i<passed;i++){
+        if(!args[i].evaluated) continue;
+        rc = call_keep(lisp, frame, &args[i].value, args+i+1, passed-i-1);
+        if(rc) return rc;
+    }
+    call_free_args(lisp, frame->args, VAR_LEN(params));
+    call_release_args(lisp, argnum, cont->arg_chunk);
+    call_release_args(lisp, VAR_LEN(params), frame->arg_chunk);
+    cont->args = NULL;
+    cont->argnum = 0;
+    /* This cannot fail: there is room where the old or the new arguments
+     * were. */
+    rc = call_alloc_args(lisp, argnum, &frame->args, &frame->arg_chunk);
+    if(rc) return rc;
+    memmove(frame->args, args, argnum*sizeof(Arg));
+    call_init_lets(function, frame->args, cont->context);
+    frame->function = function;
+    frame->call = node;
+    cont->then_node = NULL;
 #if TL_DEBUG_STACK
-            printf("Removed %ld from stack!\n", lisp->stack_cur);
+    printf("Reused %ld for a tail call!\n", cont->context-1);
 #endif
+    return call_enter_body(lisp, cont);
+}
+
+int call_strict_line(LizyLang *lisp, Cont *cont) {
+    Frame *frame = TL_FRAME(lisp, cont->context-1);
+    Node *fncdef = frame->function->ptr.fncdef;
+    Node *body;
+    size_t i;
+    char effects = 0;
+    for(i=2;i<fncdef->childnum;i++){
+        body = ((Node**)fncdef->childs)[i];
+        if(call_forces(lisp, body, frame->function->params,
+                       ((Node**)fncdef->childs)[1], frame->function->strict,
+                       &effects, 0) &
+           (1<<(cont->i-1))){
+            lisp->line = body->line;
+            break;
         }
     }
     return TL_SUCCESS;
 }
 
-int call_get_arg(LizyLang *lisp, Node *node, size_t idx, Var *dest,
-                 char parse) {
-    Var parsed;
+int call_loop(LizyLang *lisp, unsigned char loop) {
+    Cont *cont = TL_CONT(lisp, lisp->cont_cur-1);
+    int rc;
+    /* The continuation of the builtin function runs the loop, in the frame
+     * the loop is in. */
+    if(!cont->args){
+        rc = call_cont_args(lisp, cont);
+        if(rc) return rc;
+    }
+    cont->state = TL_C_LOOP;
+    cont->loop = loop;
+    cont->i = loop == TL_LOOP_FOR;
+    return TL_PENDING;
+}
+
+size_t call_loop_first(Cont *cont) {
+    /* The arguments before the body. */
+    return cont->loop == TL_LOOP_FOR ? 3 : 1;
+}
+
+int call_loop_num(LizyLang *lisp, Cont *cont, size_t idx, float *num) {
+    Arg *arg = cont->args+idx;
     Var *src;
-    Var returned;
+    Var value;
+    size_t context;
+    char constant;
     int rc;
-    size_t context, n, old_ctx;
-    Function *function;
-    char free_returned = 0;
-    old_ctx = lisp->context;
-#if TL_DEBUG_CONTEXT
-    puts("    GETTING ARGUMENT!");
-    puts("--------");
-    printf("Context: %ld\n", lisp->context);
-    fputs("Call: ", stdout);
-    fwrite(node->var->items->string.data, 1, node->var->items->string.len,
-           stdout);
-    fputc('\n', stdout);
-    printf("Argument index: %ld\n", idx);
-    if(parse) puts("Parsing? NO.");
-    else puts("Parsing? YES.");
-    puts("--------");
-#endif
-#if TL_DEBUG_CONTEXT
-    printf("Context: %ld\n", lisp->context);
-#endif
-    if(idx >= node->childnum) return TL_ERR_TOO_FEW_ARGS;
-    src = ((Node**)node->childs)[idx]->var;
-    context = lisp->context;
-#if TL_DEBUG_CONTEXT
-    if(!context) puts("    USING ROOT NODE CONTEXT!");
-    else puts("    USING FUNCTION CONTEXT!");
-#endif
-    if(src->type == TL_T_NAME && parse && context){
-        context--;
-        do{
-            context = lisp->stack[context].parent;
-            if(!context) break;
-            context--;
-#if TL_DEBUG_STACK
-            printf("Reading stack item %ld!\n", context);
-#endif
-            function = lisp->stack[context].function;
-            if(function->builtin) return TL_ERR_INTERNAL;
-            for(n=0;n<VAR_LEN((Var*)function->params);n++){
-                /*
-                fwrite(((Var*)function->params)->items[n].string.data, 1,
-                    ((Var*)function->params)->items[n].string.len, stdout);
-                */
-                if(src->items->string.len ==
-                ((Var*)function->params)->items[n].string.len){
-                    if(!memcmp(src->items->string.data,
-                    ((Var*)function->params)->items[n].string.data,
-                    src->items->string.len)){
-                        if(lisp->stack[context].evaluated[n]){
-#if TL_DEBUG_CONTEXT
-                            puts("    ARGUMENT ALREADY EVALUATED!");
-#endif
-                            rc = var_copy(lisp->stack[context].args+n,
-                                          &returned);
-                            if(rc) return rc;
-                            free_returned = 1;
-                            break;
-                        }
-                        src = ((Node**)((Node*)lisp->stack
-                                    [context].call)->childs)[n]->var;
-                        if(((Node**)((Node*)lisp->stack[context].call)
-                            ->childs)[n]->var->type == TL_T_CALL){
-                            lisp->context = context;
-#if TL_DEBUG_CONTEXT
-                            puts("    USING CONTEXT!");
-                            puts("--------");
-                            printf("Context: %ld\n", context+1);
-                            printf("Index: %ld\n", context);
-                            fputs("Function definition of: ",
-                                  stdout);
-                            fwrite(((Node**)((Node*)function->ptr.fncdef)
-                                   ->childs)[0]->var->items->string.data, 1,
-                                   ((Node**)((Node*)function->ptr.fncdef)
-                                   ->childs)[0]->var->items->string.len,
-                                   stdout);
-                            fputs("\n", stdout);
-                            fputs("Parameter definition function name: ",
-                                  stdout);
-                            fwrite(((Node**)((Node*)function->ptr.fncdef)
-                                   ->childs)[1]->var->items->string.data, 1,
-                                   ((Node**)((Node*)function->ptr.fncdef)
-                                   ->childs)[1]->var->items->string.len,
-                                   stdout);
-                            fputs("\n", stdout);
-                            fputs("Evaluating parameter \"", stdout);
-                            fwrite(((Var*)function->params)->items[n].string
-                                   .data, 1, ((Var*)function->params)->items[n]
-                                   .string.len, stdout);
-                            fputs("\"\n", stdout);
-                            printf("Parent context: %ld\n",
-                                   lisp->stack[context].parent);
-                            puts("--------");
-#endif
-                            rc = call_exec(lisp, ((Node**)((Node*)lisp->stack
-                                    [context].call)->childs)[n], &returned);
-                            if(rc){
-                                lisp->context = old_ctx;
-                                return rc;
-                            }
-                            src = &returned;
-                            rc = var_copy(&returned,
-                                          lisp->stack[context].args+n);
-                            if(rc){
-                                free(&returned);
-                                return rc;
-                            }
-                            lisp->stack[context].evaluated[n] = 1;
-                            free_returned = 1;
-                        }
-                        break;
-                    }
-                }
+    rc = call_find_arg(lisp, cont, idx, &src, &constant, &context, 1);
+    if(rc) return rc;
+    if(src->type == TL_T_NAME){
+        rc = call_parse_arg(lisp, src, &value, context);
+        if(rc) return rc;
+        src = &value;
+    }
+    if(VAR_LEN(src) != 1) rc = TL_ERR_INVALID_LIST_SIZE;
+    else if(src->type != TL_T_NUM) rc = TL_ERR_BAD_TYPE;
+    else *num = VAR_NUM_AT(src, 0);
+    if(src == &value) var_free(&lisp->alloc, &value);
+    if(arg->evaluated){
+        /* A condition is evaluated again before each iteration. */
+        var_free(&lisp->alloc, &arg->value);
+        arg->evaluated = 0;
+    }
+    return rc;
+}
+
+int call_loop_var(LizyLang *lisp, Cont *cont) {
+    Node *name = ((Node**)((Node*)cont->node)->childs)[0];
+    Frame *frame = NULL;
+    Var *var = NULL;
+    Var value;
+    String global;
+    Arg *arg;
+    size_t n;
+    int rc;
+    if(cont->context){
+        frame = TL_FRAME(lisp, cont->context-1);
+        if(call_node_param(name, frame->function->params, &n)){
+            /* The variable is a slot of the frame, that no longer shares
+             * the argument it was passed as. */
+            arg = frame->args+n;
+            arg->thunk = NULL;
+            if(arg->evaluated && arg->value.type != TL_T_NUM){
+                rc = call_unlend(lisp, frame, &arg->value);
+                if(rc) return rc;
+                var_free(&lisp->alloc, &arg->value);
+                arg->evaluated = 0;
+            }
+            if(!arg->evaluated){
+                rc = var_num_from_float(&lisp->alloc, &arg->value,
+                                        cont->loop_num);
+                if(rc) return rc;
+                arg->evaluated = 1;
+                return TL_SUCCESS;
             }
-        }while(context > 0);
+            var = &arg->value;
+        }else{
+            frame = NULL;
+        }
     }
-    /*if(src->type == TL_T_NAME){
-        fwrite(src->items[0].string.data, 1,
-                src->items[0].string.len, stdout);
-        puts("");
-    }*/
-    if(src->type == TL_T_CALL){
-#if TL_DEBUG_CONTEXT
-        printf("Context before call: %ld\n", lisp->context);
-#endif
-        rc = call_exec(lisp, ((Node**)node->childs)[idx], dest);
+    if(!var){
+        /* Outside of a function, it is a global variable. */
+        for(n=0;n<lisp->var_num;n++){
+            if(lisp->var_names[n].len == VAR_STR_LEN(name->var->items[0]) &&
+               !memcmp(VAR_RAW_STR_DATA(lisp->var_names+n),
+                       VAR_STR_DATA(name->var->items[0]),
+                       lisp->var_names[n].len)){
+                var = lisp->vars+n;
+                break;
+            }
+        }
+    }
+    if(!var){
+        rc = var_num_from_float(&lisp->alloc, &value, cont->loop_num);
+        if(rc) return rc;
+        rc = var_raw_str(&lisp->alloc, &global,
+                         VAR_STR_DATA(name->var->items[0]),
+                         VAR_STR_LEN(name->var->items[0]));
+        if(!rc) rc = tl_add_var(lisp, &value, &global);
         if(rc){
-            lisp->context = old_ctx;
-            if(free_returned) var_free(&returned);
-            return rc;
+            var_free(&lisp->alloc, &value);
+            var_free_str(&lisp->alloc, &global);
         }
+        return rc;
+    }
+    if(var->type != TL_T_NUM) return TL_ERR_BAD_TYPE;
+    if(var->size == 1 && !var->ref && var->storage == TL_S_ITEMS &&
+       !var->base){
+        /* Nothing is allocated from one iteration to the next. */
+        var->items->num = cont->loop_num;
+        return TL_SUCCESS;
+    }
+    if(frame){
+        rc = call_unlend(lisp, frame, var);
+        if(rc) return rc;
+    }
+    rc = var_num_from_float(&lisp->alloc, &value, cont->loop_num);
+    if(rc) return rc;
+    var_free(&lisp->alloc, var);
+    *var = value;
+    return TL_SUCCESS;
+}
+
+int call_loop_end(LizyLang *lisp, Cont *cont) {
+    int rc;
+    /* The loop gives the value of the last node of its body, or 0 if it
+     * never ran. */
+    if(cont->tmp_set){
+        *cont->dest = cont->tmp;
+        cont->tmp_set = 0;
     }else{
-        rc = var_copy(src, dest);
-        if(rc){
-            lisp->context = old_ctx;
-            if(free_returned) var_free(&returned);
-            return rc;
+        rc = var_num_from_float(&lisp->alloc, cont->dest, 0);
+        if(rc) return rc;
+    }
+    if(cont->done) *cont->done = 1;
+    return call_pop_cont(lisp);
+}
+
+int call_loop_step(LizyLang *lisp, Cont *cont) {
+    Node *node = cont->node;
+    Node *child;
+    size_t first = call_loop_first(cont);
+    float num;
+    int rc;
+    while(cont->i < first){
+        rc = call_loop_num(lisp, cont, cont->i, &num);
+        if(rc == TL_PENDING) return TL_SUCCESS;
+        if(rc) return rc;
+        if(cont->loop == TL_LOOP_WHILE){
+            if(num == 0) return call_loop_end(lisp, cont);
+        }else if(cont->loop == TL_LOOP_REPEAT){
+            cont->loop_num = 0;
+            cont->loop_end = num;
+            if(cont->loop_num >= cont->loop_end){
+                return call_loop_end(lisp, cont);
+            }
+        }else if(cont->i == 1){
+            cont->loop_num = num;
+        }else{
+            cont->loop_end = num;
+            if(cont->loop_num > cont->loop_end){
+                return call_loop_end(lisp, cont);
+            }
+            rc = call_loop_var(lisp, cont);
+            if(rc) return rc;
         }
+        cont->i++;
     }
-    if(parse){
-        rc = call_parse_arg(lisp, dest, &parsed, context);
-        var_free(dest);
-        if(rc){
-            lisp->context = old_ctx;
-            if(free_returned) var_free(&returned);
-            return rc;
+    if(cont->i < node->childnum){
+        child = ((Node**)node->childs)[cont->i];
+        if(cont->tmp_set){
+            var_free(&lisp->alloc, &cont->tmp);
+            cont->tmp_set = 0;
         }
-        rc = var_copy(&parsed, dest);
-        var_free(&parsed);
-        if(rc){
-            lisp->context = old_ctx;
-            if(free_returned) var_free(&returned);
-            return rc;
+        if(child->var->type != TL_T_CALL){
+            /* A node the optimiser replaced by its value. */
+            rc = call_get_arg(lisp, node, cont->i, &cont->tmp, 1);
+            if(rc == TL_PENDING) return TL_SUCCESS;
+            if(rc) return rc;
+            cont->tmp_set = 1;
+            cont->i++;
+            return TL_SUCCESS;
         }
+        cont->i++;
+        return call_push_node(lisp, child, cont->context, &cont->tmp,
+                              &cont->tmp_set);
     }
-    if(free_returned) var_free(&returned);
-    lisp->context = old_ctx;
+    /* The body ran, the next iteration starts. */
+    if(cont->loop == TL_LOOP_WHILE){
+        cont->i = 0;
+        return TL_SUCCESS;
+    }
+    cont->loop_num++;
+    if(cont->loop == TL_LOOP_REPEAT ? cont->loop_num >= cont->loop_end :
+       cont->loop_num > cont->loop_end){
+        return call_loop_end(lisp, cont);
+    }
+    if(cont->loop == TL_LOOP_FOR){
+        rc = call_loop_var(lisp, cont);
+        if(rc) return rc;
+    }
+    cont->i = first;
     return TL_SUCCESS;
 }
 
+int call_run(LizyLang *lisp, size_t base) {
+    Cont *cont;
+    Node *fncdef;
+    size_t old_ctx = lisp->context;
+    size_t i;
+    int rc = TL_SUCCESS;
+    /* The call on top of the stack is evaluated step by step: a step either
+     * pushes what it needs to be evaluated first or returns. */
+    while(lisp->cont_cur > base){
+        cont = TL_CONT(lisp, lisp->cont_cur-1);
+        lisp->context = cont->context;
+        switch(cont->state){
+            case TL_C_START:
+                rc = call_start(lisp, cont);
+                break;
+            case TL_C_ARGS:
+                rc = call_eval_args(lisp, cont);
+                break;
+            case TL_C_BUILTIN:
+                rc = call_builtin(lisp, cont);
+                break;
+            case TL_C_STRICT:
+                rc = call_strict(lisp, cont);
+                break;
+            case TL_C_MEMO:
+                rc = call_memo(lisp, cont);
+                break;
+            case TL_C_BODY:
+                rc = call_body(lisp, cont);
+                break;
+            case TL_C_VM:
+                /* FALLTHRU */
+            case TL_C_EXPR:
+                rc = vm_run(lisp, cont);
+                break;
+            case TL_C_TAIL:
+                rc = call_tail_frame(lisp, cont);
+                break;
+            case TL_C_LOOP:
+                rc = call_loop_step(lisp, cont);
+                break;
+            case TL_C_STREAM:
+                rc = stream_step(lisp, cont);
+                break;
+            default:
+                rc = TL_ERR_INTERNAL;
+        }
+        if(rc) break;
+    }
+    /* Unwind the stack after an error. The line of the body node the error
+     * happened in is kept for the error message. */
+    while(rc && lisp->cont_cur > base){
+        cont = TL_CONT(lisp, lisp->cont_cur-1);
+        if(cont->state == TL_C_BODY && cont->i > 2){
+            fncdef = TL_FRAME(lisp, cont->context-1)->function->ptr.fncdef;
+            lisp->line = ((Node**)fncdef->childs)[cont->i-1]->line;
+        }else if(cont->state == TL_C_VM){
+            lisp->line = vm_line(cont->code, cont->i);
+        }else if(cont->state == TL_C_TAIL){
+            lisp->line = ((Node*)cont->then_node)->line;
+        }else if(cont->state == TL_C_STRICT){
+            /* Report it where the argument would have been evaluated. */
+            call_strict_line(lisp, cont);
+        }else if(cont->state == TL_C_LOOP){
+            /* The argument of the loop being evaluated. */
+            i = cont->i < call_loop_first(cont) ? cont->i : cont->i-1;
+            if(i < ((Node*)cont->node)->childnum){
+                lisp->line = ((Node**)((Node*)cont->node)->childs)[i]->line;
+            }
+        }
+        call_pop_cont(lisp);
+    }
+    lisp->context = old_ctx;
+    return rc;
+}
+
+int call_function(LizyLang *lisp, Function *function, Node *node,
+                  size_t offset, Var *returned) {
+    Cont *cont = TL_CONT(lisp, lisp->cont_cur-1);
+    TL_UNUSED(returned);
+    if(function->builtin && offset) return TL_ERR_BAD_TYPE;
+    /* The builtin function being called returns the value of the call. */
+    cont->then_node = node;
+    cont->then_function = function;
+    cont->then_offset = offset;
+    return TL_PENDING;
+}
+
+int call_exec(LizyLang *lisp, Node *node, Var *returned) {
+    size_t base = lisp->cont_cur;
+    int rc;
+    rc = call_push_cont(lisp, node, lisp->context, returned, NULL, 0);
+    if(rc) return rc;
+    return call_run(lisp, base);
+}
+
+int call_get_arg(LizyLang *lisp, Node *node, size_t idx, Var *dest,
+                 char parse) {
+    Cont *cont = TL_CONT(lisp, lisp->cont_cur-1);
+    Arg *arg;
+    Var *src;
+    size_t context;
+    char constant;
+    int rc;
+#if TL_DEBUG_CONTEXT
+    printf("Getting argument %ld in context %ld\n", idx, lisp->context);
+#endif
+    if(idx >= node->childnum) return TL_ERR_TOO_FEW_ARGS;
+    if(idx < cont->evalnum){
+        /* The argument was already evaluated. */
+        arg = cont->args+idx;
+        if(!arg->evaluated) return TL_ERR_INTERNAL;
+        if(cont->function->parseargs != TL_ARGS_ALL){
+            /* The function may be called again, so it only borrows it. */
+            return var_ref(&arg->value, dest);
+        }
+        *dest = arg->value;
+        arg->evaluated = 0;
+        return TL_SUCCESS;
+    }
+    rc = call_find_arg(lisp, cont, idx, &src, &constant, &context, parse);
+    if(rc) return rc;
+    if(parse && src->type == TL_T_NAME){
+        return call_parse_arg(lisp, src, dest, context);
+    }else if(constant){
+        /* Constants never change, so there is no need to copy them. */
+        return var_ref(src, dest);
+    }
+    return var_copy(&lisp->alloc, src, dest);
+}
+
+int call_return_arg(LizyLang *lisp, Node *node, size_t idx, Var *dest) {
+    Cont *cont = TL_CONT(lisp, lisp->cont_cur-1);
+    Node *child;
+    if(idx >= node->childnum) return TL_ERR_TOO_FEW_ARGS;
+    child = ((Node**)node->childs)[idx];
+    if(child->var->type == TL_T_CALL){
+        /* The call takes the place of the one of the builtin function, so it
+         * is in tail position if it was. */
+        cont->then_node = child;
+        cont->then_function = NULL;
+        cont->then_offset = 0;
+        return TL_PENDING;
+    }
+    return call_get_arg(lisp, node, idx, dest, 1);
+}
+
 int call_get_arg_raw(Node *node, size_t idx, Var **var) {
     if(idx >= node->childnum) return TL_ERR_TOO_FEW_ARGS;
     *var = ((Node**)node->childs)[idx]->var;
@@ -365,11 +1529,14 @@ int call_parse_arg(LizyLang *lisp, Var *src, Var *dest, size_t context) {
     char found = 0;
     int rc;
     size_t n;
-    Function *function;
-    Var out;
+    TL_UNUSED(context);
     if(!src->size){
         dest->size = 0;
         dest->items = NULL;
+        dest->null = 0;
+        dest->ref = 0;
+        dest->storage = TL_S_ITEMS;
+        dest->base = NULL;
         if(src->type == TL_T_NAME){
             return TL_ERR_INVALID_NAME;
         }
@@ -379,20 +1546,20 @@ int call_parse_arg(LizyLang *lisp, Var *src, Var *dest, size_t context) {
         if(!found){
             for(n=0;n<lisp->var_num;n++){
 #if TL_DEBUG_VARS
-                fwrite(lisp->var_names[n].data, 1, lisp->var_names[n].len,
-                       stdout);
+                fwrite(VAR_RAW_STR_DATA(lisp->var_names+n), 1,
+                       lisp->var_names[n].len, stdout);
                 fputs(", ", stdout);
-                fwrite(src->items[0].string.data, 1,
+                fwrite(VAR_STR_DATA(src->items[0]), 1,
                        src->items[0].string.len, stdout);
                 fputc('\n', stdout);
 #endif
                 if(lisp->var_names[n].len != src->items[0].string.len){
                     continue;
                 }
-                if(!memcmp(lisp->var_names[n].data,
-                           src->items[0].string.data,
+                if(!memcmp(VAR_RAW_STR_DATA(lisp->var_names+n),
+                           VAR_STR_DATA(src->items[0]),
                            lisp->var_names[n].len)){
-                    rc = var_copy(lisp->vars+n, dest);
+                    rc = var_copy(&lisp->alloc, lisp->vars+n, dest);
                     if(rc){
                         return rc;
                     }
@@ -405,7 +1572,7 @@ int call_parse_arg(LizyLang *lisp, Var *src, Var *dest, size_t context) {
             return TL_ERR_NOT_DEF;
         }
     }else{
-        rc = var_copy(src, dest);
+        rc = var_copy(&lisp->alloc, src, dest);
         if(rc){
             return rc;
         }
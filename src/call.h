@@ -40,6 +40,11 @@
  * 2024/10/09: Parse single argument with call_parse_arg.
  * 2024/10/16: Started adding calling back.
  * 2024/10/19: Adding builtin function calling back.
+ * 2026/10/18: Tail calls. Call a function with arguments at an offset.
+ *             Argument pool. Continuation stack. Strictness analysis.
+ *             Hidden parameters. Memoisation. Bytecode. Bound nodes.
+ *             Loops. Streams. Check the functions again once one is
+ *             replaced.
  */
 
 #ifndef CALL_H
@@ -48,10 +53,72 @@
 #include <lisp.h>
 #include <defs.h>
 #include <var.h>
+#include <memo.h>
+#include <vm.h>
+#include <stream.h>
 
+int call_find_func(LizyLang *lisp, String *name, Function **function);
+char call_find_param(Var *params, Var *name, size_t *n);
+int call_node_func(LizyLang *lisp, Node *node, Function **function);
+char call_node_param(Node *node, Var *params, size_t *n);
+Node *call_let(Node *names, size_t n);
+char call_uses_params(Node *root, Var *params);
+char call_is_self(Node *node, Node *names);
+unsigned short call_forces(LizyLang *lisp, Node *node, Var *params,
+                           Node *names, unsigned short self, char *effects,
+                           size_t depth);
+unsigned short call_strict_params(LizyLang *lisp, Node *fncdef,
+                                  Var *params);
+char call_pure_body(LizyLang *lisp, Node *root, Var *params, String *name);
+char call_pure_func(LizyLang *lisp, Node *fncdef, Var *params,
+                    String *name);
+int call_check_pure(LizyLang *lisp);
+char call_pure(LizyLang *lisp, Node *node, size_t context);
+int call_free_args(LizyLang *lisp, Arg *args, size_t argnum);
+int call_keep(LizyLang *lisp, Frame *frame, Var *var, Arg *others,
+              size_t othernum);
+int call_own(LizyLang *lisp, Var *value);
+int call_unlend(LizyLang *lisp, Frame *frame, Var *var);
+int call_alloc_args(LizyLang *lisp, size_t argnum, Arg **args,
+                    size_t *chunk);
+int call_release_args(LizyLang *lisp, size_t argnum, size_t chunk);
+int call_push_frame(LizyLang *lisp, Function *function, Node *node,
+                    size_t offset);
+int call_init_lets(Function *function, Arg *args, size_t context);
+int call_pop_frame(LizyLang *lisp);
+int call_push_cont(LizyLang *lisp, Node *node, size_t context, Var *dest,
+                   char *done, char tail);
+int call_push_node(LizyLang *lisp, Node *node, size_t context, Var *dest,
+                   char *done);
+int call_free_cont_args(LizyLang *lisp, Cont *cont);
+int call_pop_cont(LizyLang *lisp);
+int call_cont_args(LizyLang *lisp, Cont *cont);
+int call_start(LizyLang *lisp, Cont *cont);
+int call_find_arg(LizyLang *lisp, Cont *cont, size_t idx, Var **var,
+                  char *constant, size_t *context, char parse);
+int call_eval_args(LizyLang *lisp, Cont *cont);
+int call_builtin(LizyLang *lisp, Cont *cont);
+int call_strict(LizyLang *lisp, Cont *cont);
+int call_memo(LizyLang *lisp, Cont *cont);
+int call_enter_body(LizyLang *lisp, Cont *cont);
+int call_body(LizyLang *lisp, Cont *cont);
+int call_end_body(LizyLang *lisp, Cont *cont);
+char call_needs_frame(LizyLang *lisp, Cont *cont, Function *function);
+int call_tail_frame(LizyLang *lisp, Cont *cont);
+int call_strict_line(LizyLang *lisp, Cont *cont);
+int call_loop(LizyLang *lisp, unsigned char loop);
+size_t call_loop_first(Cont *cont);
+int call_loop_num(LizyLang *lisp, Cont *cont, size_t idx, float *num);
+int call_loop_var(LizyLang *lisp, Cont *cont);
+int call_loop_end(LizyLang *lisp, Cont *cont);
+int call_loop_step(LizyLang *lisp, Cont *cont);
+int call_run(LizyLang *lisp, size_t base);
+int call_function(LizyLang *lisp, Function *function, Node *node,
+                  size_t offset, Var *returned);
 int call_exec(LizyLang *lisp, Node *node, Var *returned);
 int call_get_arg(LizyLang *lisp, Node *node, size_t idx, Var *dest,
                  char parse);
+int call_return_arg(LizyLang *lisp, Node *node, size_t idx, Var *dest);
 int call_get_arg_raw(Node *node, size_t idx, Var **var);
 int call_parse_arg(LizyLang *lisp, Var *src, Var *dest, size_t context);
 
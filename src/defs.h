@@ -44,6 +44,12 @@
  *             has no end. Added void list support.
  * 2024/10/13: Added list management functions.
  * 2024/10/16: Finish generating the tree.
+ * 2026/10/18: Added TL_STR_INLINE_SZ. Added allocators. Growable stack.
+ *             Continuation stack, TL_PENDING and TL_ARGS_ALL. Added
+ *             TL_STRICT_MAX. Optimisation passes, TL_OPT_CSE. Memoisation.
+ *             Bytecode. TL_OPT_BIND, TL_OPT_QUICKEN.
+ *             JIT. TL_INLINE_MAX, TL_OPT_INLINE. TL_OPT_TYPES.
+ *             TL_OPT_FUSE. TL_MEMO_ARG_MAX. TL_STRICT_DEPTH.
  */
 
 #ifndef DEFS_H
@@ -53,9 +59,75 @@
 
 #define TL_UNUSED(var) ((void)(var))
 #define TL_TOKEN_SZ    512
-#define TL_STACK_SZ    256
-#define TL_FSTACK_SZ   128
-#define TL_ARGSTACK_SZ 128
+/* Frames are allocated by segments of TL_FRAME_SEG_SZ frames, continuations
+ * by segments of TL_CONT_SEG_SZ and the arguments by chunks of at least
+ * TL_ARG_CHUNK_SZ arguments. */
+#define TL_FRAME_SEG_SZ 64
+#define TL_CONT_SEG_SZ  64
+#define TL_ARG_CHUNK_SZ 256
+/* Maximum depth of the calls that are not in tail position. Everything is on
+ * the heap, so this only stops runaway recursion before it uses all of the
+ * memory. */
+#define TL_MAX_DEPTH    65536
+/* A builtin function registered with TL_ARGS_ALL gets all of its arguments
+ * evaluated before it is called. */
+#define TL_ARGS_ALL     127
+/* Only the first TL_STRICT_MAX parameters of a function can be strict. A
+ * parameter is not strict if it is only used in calls nested deeper than
+ * TL_STRICT_DEPTH, so that checking it does not overflow the C stack. */
+#define TL_STRICT_MAX   16
+#define TL_STRICT_DEPTH 1024
+/* The results of the pure functions are cached in a table of TL_MEMO_BUCKETS
+ * buckets that holds up to TL_MEMO_MAX of them: the one that was used the
+ * least recently is dropped to make room. */
+#define TL_MEMO_BUCKETS 256
+#define TL_MEMO_MAX     1024
+/* The calls with a list longer than this as argument are not cached: hashing
+ * and copying it would cost as much as walking it in the function. */
+#define TL_MEMO_ARG_MAX 64
+/* Strings that are not longer than this are stored inline. The default makes
+ * a String as big as a Function, so that it does not make Item bigger. */
+#define TL_STR_INLINE_SZ 16
+/* A function is compiled to machine code once it was called TL_JIT_HOT
+ * times, if it has at most TL_JIT_ARGS parameters. The machine code calls
+ * itself up to TL_JIT_DEPTH times in a row before it gives up and lets the
+ * interpreter run the call. */
+#define TL_JIT_HOT       64
+#define TL_JIT_ARGS      16
+#define TL_JIT_DEPTH     4096
+/* The calls of a function whose body has at most TL_INLINE_MAX nodes are
+ * replaced by its body. */
+#define TL_INLINE_MAX    16
+
+/* The passes of the optimiser, that rewrites the tree before running it. */
+enum {
+    TL_OPT_COMMENTS = 1,
+    TL_OPT_FOLD = 2,
+    TL_OPT_IF = 4,
+    TL_OPT_DEAD = 8,
+    TL_OPT_CSE = 16,
+    TL_OPT_MEMO = 32,
+    TL_OPT_BYTECODE = 64,
+    TL_OPT_BIND = 128,
+    TL_OPT_QUICKEN = 256,
+    TL_OPT_JIT = 512,
+    TL_OPT_INLINE = 1024,
+    TL_OPT_TYPES = 2048,
+    TL_OPT_FUSE = 4096,
+    TL_OPT_ALL = 8191
+};
+
+/* Every allocation of an interpreter goes through its allocator. */
+typedef struct {
+    void *(*alloc)(void *ctx, size_t size);
+    void *(*realloc)(void *ctx, void *ptr, size_t size);
+    void (*free)(void *ctx, void *ptr);
+    void *ctx;
+} TlAllocator;
+
+#define TL_MALLOC(a, size)       (a)->alloc((a)->ctx, size)
+#define TL_REALLOC(a, ptr, size) (a)->realloc((a)->ctx, ptr, size)
+#define TL_FREE(a, ptr)          (a)->free((a)->ctx, ptr)
 
 enum {
     TL_SUCCESS,
@@ -83,7 +155,10 @@ enum {
     TL_ERR_BAD_INPUT,
     TL_ERR_OUT_OF_RANGE,
     TL_ERR_VALUE_OUTSIDE_OF_CALL,
-    TL_RC_AMOUNT
+    TL_RC_AMOUNT,
+    /* Not an error: a builtin function has to be called again once what it
+     * needs has been evaluated. */
+    TL_PENDING
 };
 
 #endif
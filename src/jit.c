@@ -0,0 +1,530 @@
+/* A small interpreter for a lisp like language, targetting embedded systems.
+ * by Mibi88
+ *
+ * This software is licensed under the BSD-3-Clause license:
+ *
+ * Copyright 2024 Mibi88
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* CHANGELOG
+ *
+ * 2026/10/18: Created this file. Compile the hot numeric functions to x86-64
+ *             machine code.
+ */
+
+#include <jit.h>
+#include <call.h>
+#include <builtin.h>
+#include <aot.h>
+#include <num.h>
+
+/* A function can be compiled if its body is a single expression made of
+ * numbers, of its parameters and of calls of the arithmetic and comparison
+ * builtins, of if and of itself. As its parameters are numbers, the values
+ * are always numbers: they are kept unboxed, as floats. The machine code is
+ * made of a template for each kind of node, with the value of each node in
+ * xmm0. It gives up, so that the interpreter runs the call instead, when it
+ * would divide by zero or when it called itself too many times in a row. */
+
+int jit_builtin_op(int f(void*, void*, size_t, void*)) {
+    if(f == builtin_if) return TL_JIT_IF;
+    if(f == builtin_add) return TL_JIT_ADD;
+    if(f == builtin_substract) return TL_JIT_SUB;
+    if(f == builtin_multiply) return TL_JIT_MUL;
+    if(f == builtin_divide) return TL_JIT_DIV;
+    if(f == builtin_modulo) return TL_JIT_MOD;
+    if(f == builtin_smaller) return TL_JIT_LT;
+    if(f == builtin_bigger) return TL_JIT_GT;
+    if(f == builtin_smaller_or_equal) return TL_JIT_LE;
+    if(f == builtin_bigger_or_equal) return TL_JIT_GE;
+    if(f == builtin_equal) return TL_JIT_EQ;
+    if(f == builtin_not_equal) return TL_JIT_NE;
+    return TL_JIT_NONE;
+}
+
+#if TL_JIT
+int jit_op(JitCompiler *c, Node *node) {
+    Function *function;
+    if(call_find_func(c->lisp, &node->var->items->call.function,
+                      &function)){
+        return TL_JIT_NONE;
+    }
+    if(!function->builtin){
+        return function->ptr.fncdef == c->fncdef ? TL_JIT_SELF : TL_JIT_NONE;
+    }
+    return jit_builtin_op(function->ptr.f);
+}
+
+char jit_supported(JitCompiler *c, Node *node, char in_self) {
+    Var *var = node->var;
+    size_t i, n;
+    int op;
+    if(var->type == TL_T_NUM) return VAR_LEN(var) == 1;
+    if(var->type == TL_T_NAME){
+        return VAR_LEN(var) == 1 && call_node_param(node, c->params, &n) &&
+               n < c->visible;
+    }
+    if(var->type != TL_T_CALL || VAR_LEN(var) != 1) return 0;
+    op = jit_op(c, node);
+    if(op == TL_JIT_NONE) return 0;
+    if(op == TL_JIT_SELF){
+        /* Its arguments are evaluated before the call instead of when they
+         * are used, so they must not be able to recurse forever. */
+        if(in_self || node->childnum != c->passed) return 0;
+        in_self = 1;
+    }else if(node->childnum != (op == TL_JIT_IF ? 3 : 2)){
+        return 0;
+    }
+    for(i=0;i<node->childnum;i++){
+        if(!jit_supported(c, ((Node**)node->childs)[i], in_self)) return 0;
+    }
+    return 1;
+}
+
+void jit_bytes(JitCompiler *c, unsigned char *bytes, size_t num) {
+    unsigned char *buf;
+    size_t max;
+    if(c->rc) return;
+    if(c->size+num > c->max){
+        max = c->max ? c->max*2 : 256;
+        while(max < c->size+num) max *= 2;
+        buf = TL_REALLOC(&c->lisp->alloc, c->buf, max);
+        if(!buf){
+            c->rc = TL_ERR_OUT_OF_MEM;
+            return;
+        }
+        c->buf = buf;
+        c->max = max;
+    }
+    memcpy(c->buf+c->size, bytes, num);
+    c->size += num;
+}
+
+void jit_u32(JitCompiler *c, unsigned long value) {
+    unsigned char bytes[4];
+    bytes[0] = value&0xFF;
+    bytes[1] = (value>>8)&0xFF;
+    bytes[2] = (value>>16)&0xFF;
+    bytes[3] = (value>>24)&0xFF;
+    jit_bytes(c, bytes, 4);
+}
+
+/* movss between xmm0 and a temporary value: op is 0x10 to load it and 0x11
+ * to store it. */
+void jit_stack(JitCompiler *c, unsigned char op, size_t temp) {
+    unsigned char bytes[5] = {0xF3, 0x0F, 0x00, 0x84, 0x24};
+    bytes[2] = op;
+    jit_bytes(c, bytes, 5);
+    jit_u32(c, temp*4);
+}
+
+/* movss between xmm0 and a parameter, pointed to by rbx. */
+void jit_param(JitCompiler *c, unsigned char op, size_t n) {
+    unsigned char bytes[4] = {0xF3, 0x0F, 0x00, 0x83};
+    bytes[2] = op;
+    jit_bytes(c, bytes, 4);
+    jit_u32(c, n*4);
+}
+
+/* Emits a jump and returns the offset of its target, to patch. */
+size_t jit_jump(JitCompiler *c, unsigned char *op, size_t size) {
+    jit_bytes(c, op, size);
+    jit_u32(c, 0);
+    return c->size-4;
+}
+
+void jit_set(JitCompiler *c, size_t at, unsigned long value) {
+    if(c->rc) return;
+    c->buf[at] = value&0xFF;
+    c->buf[at+1] = (value>>8)&0xFF;
+    c->buf[at+2] = (value>>16)&0xFF;
+    c->buf[at+3] = (value>>24)&0xFF;
+}
+
+/* Makes the jump whose target is at the given offset go to target. */
+void jit_patch(JitCompiler *c, size_t at, size_t target) {
+    jit_set(c, at, (unsigned long)(target-(at+4)));
+}
+
+/* Emits a jump to the code that gives up. */
+void jit_bail(JitCompiler *c, unsigned char *op, size_t size) {
+    size_t *bails;
+    size_t max;
+    size_t at = jit_jump(c, op, size);
+    if(c->rc) return;
+    if(c->bail_num == c->bail_max){
+        max = c->bail_max ? c->bail_max*2 : 16;
+        bails = TL_REALLOC(&c->lisp->alloc, c->bails, max*sizeof(size_t));
+        if(!bails){
+            c->rc = TL_ERR_OUT_OF_MEM;
+            return;
+        }
+        c->bails = bails;
+        c->bail_max = max;
+    }
+    c->bails[c->bail_num++] = at;
+}
+
+/* Returns from the function, with eax set to 1 if it gave up. */
+void jit_ret(JitCompiler *c, char bail) {
+    /* mov eax, 1 or xor eax, eax. */
+    unsigned char set[5] = {0xB8, 0x01, 0x00, 0x00, 0x00};
+    unsigned char clear[2] = {0x31, 0xC0};
+    /* lea rsp, [rbp-16]; pop r12; pop rbx; pop rbp; ret. */
+    unsigned char ret[9] = {0x48, 0x8D, 0x65, 0xF0, 0x41, 0x5C, 0x5B, 0x5D,
+                            0xC3};
+    if(bail) jit_bytes(c, set, 5);
+    else jit_bytes(c, clear, 2);
+    jit_bytes(c, ret, 9);
+}
+
+void jit_self(JitCompiler *c, Node *node, char tail) {
+    /* lea rdi, [rsp+disp32]. */
+    unsigned char args[4] = {0x48, 0x8D, 0xBC, 0x24};
+    /* lea esi, [r12+1]; call rel32. */
+    unsigned char depth[5] = {0x41, 0x8D, 0x74, 0x24, 0x01};
+    unsigned char call = 0xE8;
+    /* test eax, eax; jnz rel32. */
+    unsigned char test[2] = {0x85, 0xC0};
+    unsigned char jnz[2] = {0x0F, 0x85};
+    unsigned char jmp = 0xE9;
+    size_t base = c->temps;
+    size_t i;
+    /* The arguments are put in temporary values. A call that is not in tail
+     * position gets room for the hidden parameters of the frame too. */
+    c->temps += tail ? c->passed : VAR_LEN(c->params);
+    if(c->temps > c->temp_max) c->temp_max = c->temps;
+    for(i=0;i<node->childnum;i++){
+        jit_expr(c, ((Node**)node->childs)[i], 0);
+        jit_stack(c, 0x11, base+i);
+    }
+    if(tail){
+        /* The frame is reused. */
+        for(i=0;i<node->childnum;i++){
+            jit_stack(c, 0x10, base+i);
+            jit_param(c, 0x11, i);
+        }
+        jit_patch(c, jit_jump(c, &jmp, 1), c->body);
+    }else{
+        jit_bytes(c, args, 4);
+        jit_u32(c, base*4);
+        jit_bytes(c, depth, 5);
+        jit_patch(c, jit_jump(c, &call, 1), c->inner);
+        jit_bytes(c, test, 2);
+        jit_bail(c, jnz, 2);
+    }
+    c->temps = base;
+}
+
+void jit_if(JitCompiler *c, Node *node, char tail) {
+    /* xorps xmm1, xmm1; ucomiss xmm0, xmm1. */
+    unsigned char test[6] = {0x0F, 0x57, 0xC9, 0x0F, 0x2E, 0xC1};
+    /* NaN is not 0: jp rel32 to the first branch, je rel32 to the other. */
+    unsigned char jp[2] = {0x0F, 0x8A};
+    unsigned char je[2] = {0x0F, 0x84};
+    unsigned char jmp = 0xE9;
+    size_t then, other, end;
+    jit_expr(c, ((Node**)node->childs)[0], 0);
+    jit_bytes(c, test, 6);
+    then = jit_jump(c, jp, 2);
+    other = jit_jump(c, je, 2);
+    jit_patch(c, then, c->size);
+    jit_expr(c, ((Node**)node->childs)[1], tail);
+    end = jit_jump(c, &jmp, 1);
+    jit_patch(c, other, c->size);
+    jit_expr(c, ((Node**)node->childs)[2], tail);
+    jit_patch(c, end, c->size);
+}
+
+void jit_binary(JitCompiler *c, Node *node, int op) {
+    /* movaps xmm1, xmm0. */
+    unsigned char move[3] = {0x0F, 0x28, 0xC8};
+    /* addss, subss, mulss or divss xmm0, xmm1. */
+    unsigned char arith[4] = {0xF3, 0x0F, 0x00, 0xC1};
+    /* xorps xmm2, xmm2; ucomiss xmm1, xmm2: the builtin fails on a division
+     * by zero. */
+    unsigned char zero[6] = {0x0F, 0x57, 0xD2, 0x0F, 0x2E, 0xCA};
+    unsigned char je[2] = {0x0F, 0x84};
+    /* cvtss2sd xmm0, xmm0; cvtss2sd xmm1, xmm1; mov rax, imm64. */
+    unsigned char fmod_args[10] = {0xF3, 0x0F, 0x5A, 0xC0, 0xF3, 0x0F, 0x5A,
+                                   0xC9, 0x48, 0xB8};
+    /* call rax; cvtsd2ss xmm0, xmm0. */
+    unsigned char fmod_call[6] = {0xFF, 0xD0, 0xF2, 0x0F, 0x5A, 0xC0};
+    double (*f)(double, double) = fmod;
+    unsigned char ptr[sizeof(f)];
+    /* ucomiss between xmm0 and xmm1 and setcc al, with setcc cl and and/or
+     * al, cl for the ones that handle NaN. */
+    unsigned char compare[3] = {0x0F, 0x2E, 0xC1};
+    unsigned char set[3] = {0x0F, 0x00, 0xC0};
+    unsigned char nan[5] = {0x0F, 0x00, 0xC1, 0x00, 0xC8};
+    /* movzx eax, al; cvtsi2ss xmm0, eax. */
+    unsigned char convert[7] = {0x0F, 0xB6, 0xC0, 0xF3, 0x0F, 0x2A, 0xC0};
+    size_t temp = c->temps++;
+    if(c->temps > c->temp_max) c->temp_max = c->temps;
+    jit_expr(c, ((Node**)node->childs)[0], 0);
+    jit_stack(c, 0x11, temp);
+    jit_expr(c, ((Node**)node->childs)[1], 0);
+    jit_bytes(c, move, 3);
+    jit_stack(c, 0x10, temp);
+    c->temps--;
+    if(op == TL_JIT_DIV || op == TL_JIT_MOD){
+        jit_bytes(c, zero, 6);
+        jit_bail(c, je, 2);
+    }
+    switch(op){
+        case TL_JIT_ADD:
+            arith[2] = 0x58;
+            break;
+        case TL_JIT_SUB:
+            arith[2] = 0x5C;
+            break;
+        case TL_JIT_MUL:
+            arith[2] = 0x59;
+            break;
+        case TL_JIT_DIV:
+            arith[2] = 0x5E;
+            break;
+        case TL_JIT_MOD:
+            memcpy(ptr, &f, sizeof(f));
+            jit_bytes(c, fmod_args, 10);
+            jit_bytes(c, ptr, sizeof(f));
+            jit_bytes(c, fmod_call, 6);
+            return;
+        case TL_JIT_LT:
+            /* ucomiss xmm1, xmm0; seta al. */
+            compare[2] = 0xC8;
+            set[1] = 0x97;
+            break;
+        case TL_JIT_GT:
+            set[1] = 0x97;
+            break;
+        case TL_JIT_LE:
+            /* ucomiss xmm1, xmm0; setae al. */
+            compare[2] = 0xC8;
+            set[1] = 0x93;
+            break;
+        case TL_JIT_GE:
+            set[1] = 0x93;
+            break;
+        case TL_JIT_EQ:
+            /* sete al; setnp cl; and al, cl. */
+            set[1] = 0x94;
+            nan[1] = 0x9B;
+            nan[3] = 0x20;
+            break;
+        default:
+            /* setne al; setp cl; or al, cl. */
+            set[1] = 0x95;
+            nan[1] = 0x9A;
+            nan[3] = 0x08;
+    }
+    if(arith[2]){
+        jit_bytes(c, arith, 4);
+        return;
+    }
+    jit_bytes(c, compare, 3);
+    jit_bytes(c, set, 3);
+    if(nan[1]) jit_bytes(c, nan, 5);
+    jit_bytes(c, convert, 7);
+}
+
+void jit_expr(JitCompiler *c, Node *node, char tail) {
+    Var *var = node->var;
+    /* mov eax, imm32; movd xmm0, eax. */
+    unsigned char num[5] = {0xB8, 0x00, 0x00, 0x00, 0x00};
+    unsigned char movd[4] = {0x66, 0x0F, 0x6E, 0xC0};
+    float value;
+    size_t n;
+    int op;
+    if(var->type == TL_T_NUM){
+        value = VAR_NUM_AT(var, 0);
+        memcpy(num+1, &value, 4);
+        jit_bytes(c, num, 5);
+        jit_bytes(c, movd, 4);
+        return;
+    }
+    if(var->type == TL_T_NAME){
+        call_node_param(node, c->params, &n);
+        jit_param(c, 0x10, n);
+        return;
+    }
+    op = jit_op(c, node);
+    if(op == TL_JIT_SELF) jit_self(c, node, tail);
+    else if(op == TL_JIT_IF) jit_if(c, node, tail);
+    else jit_binary(c, node, op);
+}
+
+int jit_compile(LizyLang *lisp, Function *function, Code *code) {
+    Node *fncdef = function->ptr.fncdef;
+    Node *names = ((Node**)fncdef->childs)[1];
+    JitCompiler c;
+    size_t argnum = VAR_LEN((Var*)function->params);
+    size_t frame, i;
+    void *mem;
+    /* push rbx; mov rbx, rdx; call rel32 to the function. */
+    unsigned char entry[5] = {0x53, 0x48, 0x89, 0xD3, 0xE8};
+    /* movss [rbx], xmm0; pop rbx; ret: the result is stored. */
+    unsigned char entry_ret[6] = {0xF3, 0x0F, 0x11, 0x03, 0x5B, 0xC3};
+    /* push rbp; mov rbp, rsp; push rbx; push r12; sub rsp, imm32. */
+    unsigned char prologue[10] = {0x55, 0x48, 0x89, 0xE5, 0x53, 0x41, 0x54,
+                                  0x48, 0x81, 0xEC};
+    /* mov rbx, rdi; mov r12d, esi: the parameters and the depth. */
+    unsigned char regs[6] = {0x48, 0x89, 0xFB, 0x41, 0x89, 0xF4};
+    /* cmp r12d, imm32; jae rel32. */
+    unsigned char depth[3] = {0x41, 0x81, 0xFC};
+    unsigned char jae[2] = {0x0F, 0x83};
+    if(argnum > TL_JIT_ARGS || fncdef->childnum != 3 ||
+       names->childnum != argnum){
+        return TL_SUCCESS;
+    }
+    /* The calls it makes to itself would not use the cache. */
+    if(function->memo && lisp->opt & TL_OPT_MEMO) return TL_SUCCESS;
+    c.lisp = lisp;
+    c.fncdef = fncdef;
+    c.params = function->params;
+    c.passed = argnum-function->lets;
+    c.visible = argnum;
+    if(!jit_supported(&c, ((Node**)fncdef->childs)[2], 0)) return TL_SUCCESS;
+    for(i=c.passed;i<argnum;i++){
+        c.visible = i;
+        if(!jit_supported(&c, call_let(names, i), 1)) return TL_SUCCESS;
+    }
+    c.buf = NULL;
+    c.size = 0;
+    c.max = 0;
+    c.temps = 0;
+    c.temp_max = 0;
+    c.bails = NULL;
+    c.bail_num = 0;
+    c.bail_max = 0;
+    c.rc = TL_SUCCESS;
+    c.inner = sizeof(entry)+4+sizeof(entry_ret);
+    jit_bytes(&c, entry, sizeof(entry));
+    jit_u32(&c, c.inner-sizeof(entry)-4);
+    jit_bytes(&c, entry_ret, sizeof(entry_ret));
+    jit_bytes(&c, prologue, sizeof(prologue));
+    frame = c.size;
+    jit_u32(&c, 0);
+    jit_bytes(&c, regs, sizeof(regs));
+    jit_bytes(&c, depth, sizeof(depth));
+    jit_u32(&c, TL_JIT_DEPTH);
+    jit_bail(&c, jae, 2);
+    c.body = c.size;
+    /* The hidden parameters are computed first. */
+    for(i=c.passed;i<argnum;i++){
+        jit_expr(&c, call_let(names, i), 0);
+        jit_param(&c, 0x11, i);
+    }
+    jit_expr(&c, ((Node**)fncdef->childs)[2], 1);
+    jit_ret(&c, 0);
+    for(i=0;i<c.bail_num;i++) jit_patch(&c, c.bails[i], c.size);
+    jit_ret(&c, 1);
+    if(!c.rc){
+        /* The stack stays aligned on 16 bytes for the calls. */
+        jit_set(&c, frame, (c.temp_max*4+15)/16*16);
+        mem = platform_code_alloc(c.size);
+        if(!mem){
+            c.rc = TL_ERR_OUT_OF_MEM;
+        }else{
+            memcpy(mem, c.buf, c.size);
+            if(platform_code_exec(mem, c.size)){
+                platform_code_free(mem, c.size);
+                c.rc = TL_ERR_OUT_OF_MEM;
+            }else{
+                code->jit = mem;
+                code->jit_size = c.size;
+                memcpy(&code->native, &mem, sizeof(code->native));
+            }
+        }
+    }
+    TL_FREE(&lisp->alloc, c.buf);
+    TL_FREE(&lisp->alloc, c.bails);
+    return c.rc;
+}
+#endif
+
+int jit_call(LizyLang *lisp, Cont *cont, char *done) {
+    Frame *frame = TL_FRAME(lisp, cont->context-1);
+    Function *function = frame->function;
+    Code *code = cont->code;
+    Arg *arg;
+    Var *value;
+    float args[TL_JIT_ARGS];
+    float result;
+    size_t passed = VAR_LEN((Var*)function->params)-function->lets;
+    size_t i;
+    *done = 0;
+    if(!code->calls++){
+        /* It may have been compiled ahead of time. */
+        aot_attach(lisp, function, code);
+        /* Else it may run on unboxed numbers, unless it was already
+         * compiled for it when a function that calls it was. */
+        if(code->typed == TL_NUM_UNKNOWN) num_compile(lisp, function, code);
+    }
+#if TL_JIT
+    if(code->calls == TL_JIT_HOT && !code->native && lisp->opt & TL_OPT_JIT){
+        /* It is interpreted if it cannot be compiled. */
+        jit_compile(lisp, function, code);
+    }
+#endif
+    if(!code->native && code->typed != TL_NUM_YES) return TL_SUCCESS;
+    for(i=0;i<passed;i++){
+        arg = frame->args+i;
+        if(arg->thunk) arg = arg->thunk;
+        value = arg->evaluated ? &arg->value : ((Node*)arg->node)->var;
+        /* The arguments that still have to be evaluated are left to the
+         * interpreter. */
+        if(value->type != TL_T_NUM || VAR_LEN(value) != 1){
+            return TL_SUCCESS;
+        }
+        args[i] = VAR_NUM_AT(value, 0);
+    }
+    if(code->native){
+        if(code->native(args, 0, &result)){
+            /* It gave up, the interpreter runs it from now on. */
+            jit_free(code);
+            return TL_SUCCESS;
+        }
+    }else if(num_run(lisp, code, args, passed, &result)){
+        /* The functions that call it may still run its unboxed code. */
+        code->typed = TL_NUM_NO;
+        return TL_SUCCESS;
+    }
+    *done = 1;
+    return var_num_from_float(&lisp->alloc, cont->dest, result);
+}
+
+int jit_free(Code *code) {
+#if TL_JIT
+    if(code->jit) platform_code_free(code->jit, code->jit_size);
+#endif
+    code->jit = NULL;
+    code->native = NULL;
+    return TL_SUCCESS;
+}
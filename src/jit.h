@@ -0,0 +1,115 @@
+/* A small interpreter for a lisp like language, targetting embedded systems.
+ * by Mibi88
+ *
+ * This software is licensed under the BSD-3-Clause license:
+ *
+ * Copyright 2024 Mibi88
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* CHANGELOG
+ *
+ * 2026/10/18: Created this file. Compile the hot numeric functions to x86-64
+ *             machine code.
+ */
+
+#ifndef JIT_H
+#define JIT_H
+
+#include <lisp.h>
+#include <var.h>
+#include <tree.h>
+
+/* What a call of the body of a function compiled to machine code does. */
+enum {
+    TL_JIT_NONE,
+    TL_JIT_SELF,
+    /* A call of another function, compiled ahead of time. */
+    TL_JIT_CALL,
+    TL_JIT_IF,
+    TL_JIT_ADD,
+    TL_JIT_SUB,
+    TL_JIT_MUL,
+    TL_JIT_DIV,
+    TL_JIT_MOD,
+    TL_JIT_LT,
+    TL_JIT_GT,
+    TL_JIT_LE,
+    TL_JIT_GE,
+    TL_JIT_EQ,
+    TL_JIT_NE
+};
+
+typedef struct {
+    LizyLang *lisp;
+    Node *fncdef;
+    Var *params;
+    size_t passed;
+    /* Only the first visible parameters can be used: the hidden ones are
+     * computed one after the other. */
+    size_t visible;
+    unsigned char *buf;
+    size_t size;
+    size_t max;
+    /* Temporary values in the stack frame of the machine code. */
+    size_t temps;
+    size_t temp_max;
+    /* Offset of the function the machine code calls to call itself, and of
+     * its body, where the calls in tail position jump to. */
+    size_t inner;
+    size_t body;
+    /* Offsets of the jumps to the code that gives up. */
+    size_t *bails;
+    size_t bail_num;
+    size_t bail_max;
+    int rc;
+} JitCompiler;
+
+int jit_builtin_op(int f(void*, void*, size_t, void*));
+#if TL_JIT
+int jit_op(JitCompiler *c, Node *node);
+char jit_supported(JitCompiler *c, Node *node, char in_self);
+void jit_bytes(JitCompiler *c, unsigned char *bytes, size_t num);
+void jit_u32(JitCompiler *c, unsigned long value);
+void jit_stack(JitCompiler *c, unsigned char op, size_t temp);
+void jit_param(JitCompiler *c, unsigned char op, size_t n);
+size_t jit_jump(JitCompiler *c, unsigned char *op, size_t size);
+void jit_set(JitCompiler *c, size_t at, unsigned long value);
+void jit_patch(JitCompiler *c, size_t at, size_t target);
+void jit_bail(JitCompiler *c, unsigned char *op, size_t size);
+void jit_ret(JitCompiler *c, char bail);
+void jit_self(JitCompiler *c, Node *node, char tail);
+void jit_if(JitCompiler *c, Node *node, char tail);
+void jit_binary(JitCompiler *c, Node *node, int op);
+void jit_expr(JitCompiler *c, Node *node, char tail);
+int jit_compile(LizyLang *lisp, Function *function, Code *code);
+#endif
+int jit_call(LizyLang *lisp, Cont *cont, char *done);
+int jit_free(Code *code);
+
+#endif
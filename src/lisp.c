@@ -53,6 +53,19 @@
  * 2024/10/19: Handle errors when calling functions. Fixed error handling.
  * 2024/10/20: Fixed line number in error message. New stack.
  * 2024/10/21: Perform calls in the right context.
+ * 2026/10/18: Store short strings inline. Fixed moving the variables when
+ *             deleting one. Store literals in a constant pool. Allocate
+ *             memory with the allocator passed to tl_init. Keep track of the
+ *             memory usage and fail allocations above the memory limit. Fixed
+ *             leaks when running out of memory. Tail calls. Growable stack.
+ *             Continuation stack. Optimise the tree before running it.
+ *             Cache the results of pure functions, save them to a file.
+ *             Compile the functions to bytecode. Parse the program and
+ *             run it separately, functions compiled ahead of time. Stack
+ *             of the unboxed numeric code. Copy the views stored in a
+ *             variable. Bytecode translated to C ahead of time. Find the
+ *             constants with a hash table. Check if the functions are pure
+ *             again once a function is deleted or replaced.
  */
 
 #include <lisp.h>
@@ -60,47 +73,133 @@
 #include <call.h>
 #include <builtin.h>
 #include <tree.h>
+#include <opt.h>
+#include <vm.h>
 
-int tl_init(LizyLang *lisp, char *buffer, size_t sz) {
+/* Stored before every block to know its size when freeing it. The union keeps
+ * the data after it correctly aligned. */
+typedef union {
+    size_t size;
+    double align_float;
+    long align_long;
+    void *align_ptr;
+} MemHeader;
+
+void *lisp_alloc(void *_lisp, size_t size) {
+    LizyLang *lisp = _lisp;
+    MemHeader *header;
+    if(lisp->mem.limit && (lisp->mem.live > lisp->mem.limit ||
+       size > lisp->mem.limit-lisp->mem.live)){
+        return NULL;
+    }
+    header = TL_MALLOC(&lisp->backend, sizeof(MemHeader)+size);
+    if(!header) return NULL;
+    header->size = size;
+    lisp->mem.live += size;
+    lisp->mem.allocs++;
+    if(lisp->mem.live > lisp->mem.peak) lisp->mem.peak = lisp->mem.live;
+    return header+1;
+}
+
+void *lisp_realloc(void *_lisp, void *ptr, size_t size) {
+    LizyLang *lisp = _lisp;
+    MemHeader *header;
+    size_t old_size;
+    if(!ptr) return lisp_alloc(lisp, size);
+    header = (MemHeader*)ptr-1;
+    old_size = header->size;
+    if(lisp->mem.limit && size > old_size &&
+       (lisp->mem.live > lisp->mem.limit ||
+       size-old_size > lisp->mem.limit-lisp->mem.live)){
+        return NULL;
+    }
+    header = TL_REALLOC(&lisp->backend, header, sizeof(MemHeader)+size);
+    if(!header) return NULL;
+    header->size = size;
+    lisp->mem.live = lisp->mem.live-old_size+size;
+    lisp->mem.allocs++;
+    if(lisp->mem.live > lisp->mem.peak) lisp->mem.peak = lisp->mem.live;
+    return header+1;
+}
+
+void lisp_free(void *_lisp, void *ptr) {
+    LizyLang *lisp = _lisp;
+    MemHeader *header;
+    if(!ptr) return;
+    header = (MemHeader*)ptr-1;
+    lisp->mem.live -= header->size;
+    lisp->mem.frees++;
+    TL_FREE(&lisp->backend, header);
+}
+
+int tl_init(LizyLang *lisp, char *buffer, size_t sz, TlAllocator *alloc) {
+    int rc;
+    if(alloc){
+        lisp->backend = *alloc;
+    }else{
+        lisp->backend.alloc = platform_alloc;
+        lisp->backend.realloc = platform_realloc;
+        lisp->backend.free = platform_free;
+        lisp->backend.ctx = NULL;
+    }
+    lisp->alloc.alloc = lisp_alloc;
+    lisp->alloc.realloc = lisp_realloc;
+    lisp->alloc.free = lisp_free;
+    lisp->alloc.ctx = lisp;
+    lisp->mem.live = 0;
+    lisp->mem.peak = 0;
+    lisp->mem.allocs = 0;
+    lisp->mem.frees = 0;
+    lisp->mem.limit = 0;
     lisp->buffer = buffer;
     lisp->sz = sz;
     lisp->var_num = 0;
     lisp->vars = NULL;
     lisp->var_names = NULL;
+    lisp->consts = NULL;
+    lisp->const_num = 0;
+    lisp->const_max = 0;
+    lisp->const_table = NULL;
+    lisp->const_buckets = 0;
     lisp->stack_cur = 0;
-    lisp->fstack_cur = 0;
-    lisp->argstack_cur = 0;
+    lisp->frames = NULL;
+    lisp->frame_segs = 0;
+    lisp->conts = NULL;
+    lisp->cont_segs = 0;
+    lisp->cont_cur = 0;
+    lisp->arg_chunks = NULL;
+    lisp->arg_chunk_num = 0;
+    lisp->arg_chunk_cur = 0;
+    lisp->opt = TL_OPT_ALL;
+    lisp->opt_redefined = NULL;
+    lisp->memo = NULL;
+    lisp->memo_newest = NULL;
+    lisp->memo_oldest = NULL;
+    lisp->memo_num = 0;
+    lisp->memo_funcs = NULL;
+    lisp->memo_func_num = 0;
+    lisp->memo_file = NULL;
+    lisp->codes = NULL;
+    lisp->code_gen = 0;
+    lisp->natives = NULL;
+    lisp->native_num = 0;
+    lisp->compiled = NULL;
+    lisp->compiled_num = 0;
+    lisp->num_stack = NULL;
+    lisp->num_max = 0;
+    lisp->num_frames = NULL;
+    lisp->num_frame_max = 0;
     node_init(&lisp->node, NULL);
     lisp->node.line = 0;
 #if TL_LEAK_CHECK
     mtrace();
 #endif
-    builtin_register_funcs(lisp);
-    return var_num_from_float(&lisp->last, 0);
+    rc = builtin_register_funcs(lisp);
+    if(rc) return rc;
+    return var_num_from_float(&lisp->alloc, &lisp->last, 0);
 }
 
-#define TL_ERROR(err) error((char*)messages[err], data); return err
-#define TL_TOK_ADD(c) token[token_cur++] = c; \
-                      if(token_cur >= TL_TOKEN_SZ){ \
-                          TL_ERROR(TL_ERR_TOKFULL); \
-                          return TL_ERR_TOKFULL; \
-                      }
-
-int tl_run(LizyLang *lisp, void error(char*, void*), void *data) {
-    char c;
-    char token[TL_TOKEN_SZ];
-    size_t token_cur = 0;
-    char in_string = 0;
-    char escaped = 0;
-    char in_hex = 0;
-    char hexnum;
-    int rc;
-    size_t i;
-    Node *allocated;
-    Node *current = &lisp->node;
-    Node *node;
-    Var *node_data;
-    Var returned;
+const char *tl_message(int rc) {
     const char *messages[TL_RC_AMOUNT] = {
         "Unknown error!",
         "Token full!",
@@ -128,12 +227,36 @@ int tl_run(LizyLang *lisp, void error(char*, void*), void *data) {
         "Index out of range!",
         "Value outside of call!"
     };
+    if(rc < 0 || rc >= TL_RC_AMOUNT) rc = 0;
+    return messages[rc];
+}
+
+#define TL_ERROR(err) error((char*)tl_message(err), data); return err
+#define TL_TOK_ADD(c) token[token_cur++] = c; \
+                      if(token_cur >= TL_TOKEN_SZ){ \
+                          TL_ERROR(TL_ERR_TOKFULL); \
+                          return TL_ERR_TOKFULL; \
+                      }
+
+int tl_parse(LizyLang *lisp, void error(char*, void*), void *data) {
+    char c;
+    char token[TL_TOKEN_SZ];
+    size_t token_cur = 0;
+    char in_string = 0;
+    char escaped = 0;
+    char in_hex = 0;
+    char hexnum;
+    int rc;
+    size_t i;
+    Node *allocated;
+    Node *current = &lisp->node;
+    Var *node_data;
+    Var value;
     lisp->line = 1;
     for(i=0;i<lisp->sz;i++){
         c = lisp->buffer[i];
 #if TL_DEBUG_CHAR
-        printf("%ld%ld, %c\n", lisp->fstack_cur,
-               lisp->fstack[lisp->fstack_cur].argstack_cur, c);
+        printf("%ld, %c\n", lisp->line, c);
 #endif
         if(c == '\\' && !escaped){
             escaped = 1;
@@ -160,30 +283,33 @@ int tl_run(LizyLang *lisp, void error(char*, void*), void *data) {
                                 fwrite(token, 1, token_cur, stdout);
                                 puts("\"");
 #endif
-                                allocated = malloc(sizeof(Node));
+                                allocated = TL_MALLOC(&lisp->alloc,
+                                                      sizeof(Node));
                                 if(!allocated){
                                     TL_ERROR(TL_ERR_OUT_OF_MEM);
                                 }
-                                node_data = malloc(sizeof(Node));
-                                if(!node_data){
-                                    free(allocated);
-                                    TL_ERROR(TL_ERR_OUT_OF_MEM);
+                                rc = var_auto(&lisp->alloc, &value, token,
+                                              token_cur);
+                                if(rc){
+                                    TL_FREE(&lisp->alloc, allocated);
+                                    TL_ERROR(rc);
                                 }
-                                rc = var_auto(node_data, token, token_cur);
+                                rc = tl_add_const(lisp, &value, &node_data);
                                 if(rc){
+                                    TL_FREE(&lisp->alloc, allocated);
                                     TL_ERROR(rc);
                                 }
                                 rc = node_init(allocated, node_data);
                                 if(rc){
-                                    free(allocated);
-                                    free(node_data);
+                                    TL_FREE(&lisp->alloc, allocated);
                                     TL_ERROR(rc);
                                 }
+                                allocated->constant = 1;
                                 allocated->line = lisp->line;
-                                rc = node_add_child(current, allocated);
+                                rc = node_add_child(&lisp->alloc, current,
+                                                    allocated);
                                 if(rc){
-                                    free(allocated);
-                                    free(node_data);
+                                    TL_FREE(&lisp->alloc, allocated);
                                     TL_ERROR(rc);
                                 }
                             }else{
@@ -193,9 +319,11 @@ int tl_run(LizyLang *lisp, void error(char*, void*), void *data) {
                                 fwrite(token, 1, token_cur, stdout);
                                 puts("\"");
     #endif
-                                var_free_str(&current->var->items->call.function);
-                                var_raw_str(&current->var->items->call.function,
-                                            token, token_cur);
+                                var_free_str(&lisp->alloc, &current->var
+                                             ->items->call.function);
+                                var_raw_str(&lisp->alloc, &current->var
+                                            ->items->call.function, token,
+                                            token_cur);
                                 current->var->items->call.has_func = 1;
                             }
                             token_cur = 0;
@@ -206,30 +334,34 @@ int tl_run(LizyLang *lisp, void error(char*, void*), void *data) {
                 }
                 if(c == '('){
                     /* Create new call. */
-                    allocated = malloc(sizeof(Node));
+                    allocated = TL_MALLOC(&lisp->alloc, sizeof(Node));
                     if(!allocated){
                         TL_ERROR(TL_ERR_OUT_OF_MEM);
                     }
-                    node_data = malloc(sizeof(Node));
+                    node_data = TL_MALLOC(&lisp->alloc, sizeof(Node));
                     if(!node_data){
-                        free(allocated);
+                        TL_FREE(&lisp->alloc, allocated);
                         TL_ERROR(TL_ERR_OUT_OF_MEM);
                     }
-                    rc = var_call(node_data, "", 0);
+                    rc = var_call(&lisp->alloc, node_data, "", 0);
                     if(rc){
+                        TL_FREE(&lisp->alloc, allocated);
+                        TL_FREE(&lisp->alloc, node_data);
                         TL_ERROR(rc);
                     }
                     rc = node_init(allocated, node_data);
                     if(rc){
-                        free(allocated);
-                        free(node_data);
+                        TL_FREE(&lisp->alloc, allocated);
+                        var_free(&lisp->alloc, node_data);
+                        TL_FREE(&lisp->alloc, node_data);
                         TL_ERROR(rc);
                     }
                     allocated->line = lisp->line;
-                    rc = node_add_child(current, allocated);
+                    rc = node_add_child(&lisp->alloc, current, allocated);
                     if(rc){
-                        free(allocated);
-                        free(node_data);
+                        TL_FREE(&lisp->alloc, allocated);
+                        var_free(&lisp->alloc, node_data);
+                        TL_FREE(&lisp->alloc, node_data);
                         TL_ERROR(rc);
                     }
                     current = allocated;
@@ -266,30 +398,30 @@ int tl_run(LizyLang *lisp, void error(char*, void*), void *data) {
                         TL_ERROR(TL_ERR_STR_OUT_OF_CALL);
                     }
                     /* Add a node for the value */
-                    allocated = malloc(sizeof(Node));
+                    allocated = TL_MALLOC(&lisp->alloc, sizeof(Node));
                     if(!allocated){
                         TL_ERROR(TL_ERR_OUT_OF_MEM);
                     }
-                    node_data = malloc(sizeof(Node));
-                    if(!node_data){
-                        free(allocated);
-                        TL_ERROR(TL_ERR_OUT_OF_MEM);
+                    rc = var_str(&lisp->alloc, &value, token, token_cur);
+                    if(rc){
+                        TL_FREE(&lisp->alloc, allocated);
+                        TL_ERROR(rc);
                     }
-                    rc = var_str(node_data, token, token_cur);
+                    rc = tl_add_const(lisp, &value, &node_data);
                     if(rc){
+                        TL_FREE(&lisp->alloc, allocated);
                         TL_ERROR(rc);
                     }
                     rc = node_init(allocated, node_data);
                     if(rc){
-                        free(allocated);
-                        free(node_data);
+                        TL_FREE(&lisp->alloc, allocated);
                         TL_ERROR(rc);
                     }
+                    allocated->constant = 1;
                     allocated->line = lisp->line;
-                    rc = node_add_child(current, allocated);
+                    rc = node_add_child(&lisp->alloc, current, allocated);
                     if(rc){
-                        free(allocated);
-                        free(node_data);
+                        TL_FREE(&lisp->alloc, allocated);
                         TL_ERROR(rc);
                     }
                     token_cur = 0;
@@ -348,6 +480,18 @@ int tl_run(LizyLang *lisp, void error(char*, void*), void *data) {
         }
         escaped = 0;
     }
+    rc = opt_run(lisp);
+    if(rc){
+        TL_ERROR(rc);
+    }
+    return TL_SUCCESS;
+}
+
+int tl_exec(LizyLang *lisp, void error(char*, void*), void *data) {
+    Node *node;
+    Var returned;
+    size_t i;
+    int rc;
     for(i=0;i<lisp->node.childnum;i++){
         node = ((Node**)lisp->node.childs)[i];
         lisp->line = node->line;
@@ -356,72 +500,149 @@ int tl_run(LizyLang *lisp, void error(char*, void*), void *data) {
         if(rc){
             TL_ERROR(rc);
         }
-        var_free(&returned);
+        var_free(&lisp->alloc, &returned);
     }
     return TL_SUCCESS;
 }
 
+int tl_run(LizyLang *lisp, void error(char*, void*), void *data) {
+    int rc;
+    rc = tl_parse(lisp, error, data);
+    if(rc) return rc;
+    return tl_exec(lisp, error, data);
+}
+
 #undef TL_TOK_ADD
 #undef TL_ERROR
 
 void lisp_free_nodes(Node *node, void *_lisp) {
     LizyLang *lisp = _lisp;
-    free(node->var);
+    if(!node->constant) TL_FREE(&lisp->alloc, node->var);
     node->var = NULL;
-    if(node != &lisp->node) free(node);
+    if(node != &lisp->node) TL_FREE(&lisp->alloc, node);
 }
 
 int tl_free(LizyLang *lisp) {
-    size_t i, n;
+    size_t i;
     int out = TL_SUCCESS;
-    for(i=0;i<lisp->stack_cur;i++){
-        if(((Node*)lisp->stack[i].function->ptr.fncdef)->childnum){
-            if(lisp->stack[i].evaluated){
-                for(n=0;n<((Node**)((Node*)lisp->stack[i].function->ptr.fncdef)
-                           ->childs)[1]->childnum;n++){
-                    if(lisp->stack[i].evaluated[n]){
-                        var_free(lisp->stack[i].args+n);
-                    }
-                }
-            }
-            free(lisp->stack[i].args);
-            lisp->stack[i].args = NULL;
-            free(lisp->stack[i].evaluated);
-            lisp->stack[i].evaluated = NULL;
-        }
+    /* Free the frames left on the stack after an error. */
+    while(lisp->cont_cur) call_pop_cont(lisp);
+    while(lisp->stack_cur) call_pop_frame(lisp);
+    if(lisp->memo_file) memo_save(lisp);
+    memo_clear(lisp);
+    TL_FREE(&lisp->alloc, lisp->memo_funcs);
+    TL_FREE(&lisp->alloc, lisp->memo_file);
+    vm_free(lisp);
+    TL_FREE(&lisp->alloc, lisp->natives);
+    TL_FREE(&lisp->alloc, lisp->compiled);
+    TL_FREE(&lisp->alloc, lisp->num_stack);
+    TL_FREE(&lisp->alloc, lisp->num_frames);
+    for(i=0;i<lisp->frame_segs;i++) TL_FREE(&lisp->alloc, lisp->frames[i]);
+    TL_FREE(&lisp->alloc, lisp->frames);
+    for(i=0;i<lisp->cont_segs;i++) TL_FREE(&lisp->alloc, lisp->conts[i]);
+    TL_FREE(&lisp->alloc, lisp->conts);
+    for(i=0;i<lisp->arg_chunk_num;i++){
+        TL_FREE(&lisp->alloc, lisp->arg_chunks[i].args);
     }
+    TL_FREE(&lisp->alloc, lisp->arg_chunks);
     for(i=0;i<lisp->var_num;i++){
-        var_free(lisp->vars+i);
-        var_free_str(lisp->var_names+i);
+        var_free(&lisp->alloc, lisp->vars+i);
+        var_free_str(&lisp->alloc, lisp->var_names+i);
     }
-    node_free_childs(&lisp->node, lisp_free_nodes, lisp);
-    free(lisp->vars);
-    free(lisp->var_names);
-    var_free(&lisp->last);
+    node_free_childs(&lisp->alloc, &lisp->node, lisp_free_nodes, lisp);
+    for(i=0;i<lisp->const_num;i++){
+        var_free(&lisp->alloc, lisp->consts[i]);
+        TL_FREE(&lisp->alloc, lisp->consts[i]);
+    }
+    TL_FREE(&lisp->alloc, lisp->consts);
+    TL_FREE(&lisp->alloc, lisp->const_table);
+    TL_FREE(&lisp->alloc, lisp->vars);
+    TL_FREE(&lisp->alloc, lisp->var_names);
+    var_free(&lisp->alloc, &lisp->last);
 #if TL_LEAK_CHECK
     muntrace();
 #endif
     return out;
 }
 
+int tl_set_mem_limit(LizyLang *lisp, size_t limit) {
+    lisp->mem.limit = limit;
+    return TL_SUCCESS;
+}
+
+int tl_get_mem_stats(LizyLang *lisp, TlMemStats *stats) {
+    *stats = lisp->mem;
+    return TL_SUCCESS;
+}
+
+int tl_set_opt(LizyLang *lisp, int passes) {
+    lisp->opt = passes;
+    return TL_SUCCESS;
+}
+
+int tl_add_native(LizyLang *lisp, size_t statement, TlNative f,
+                  TlNativeDep *deps, size_t dep_num) {
+    TlNativeFunc *natives;
+    if(statement >= lisp->node.childnum) return TL_ERR_OUT_OF_RANGE;
+    natives = TL_REALLOC(&lisp->alloc, lisp->natives,
+                         (lisp->native_num+1)*sizeof(TlNativeFunc));
+    if(!natives) return TL_ERR_OUT_OF_MEM;
+    lisp->natives = natives;
+    natives[lisp->native_num].fncdef = ((Node**)lisp->node.childs)[statement];
+    natives[lisp->native_num].f = f;
+    natives[lisp->native_num].deps = deps;
+    natives[lisp->native_num].dep_num = dep_num;
+    lisp->native_num++;
+    return TL_SUCCESS;
+}
+
+int tl_add_compiled(LizyLang *lisp, size_t statement, TlCompiled f,
+                    unsigned char *ops, size_t size) {
+    TlCompiledFunc *compiled;
+    if(statement >= lisp->node.childnum) return TL_ERR_OUT_OF_RANGE;
+    compiled = TL_REALLOC(&lisp->alloc, lisp->compiled,
+                          (lisp->compiled_num+1)*sizeof(TlCompiledFunc));
+    if(!compiled) return TL_ERR_OUT_OF_MEM;
+    lisp->compiled = compiled;
+    compiled[lisp->compiled_num].fncdef =
+        ((Node**)lisp->node.childs)[statement];
+    compiled[lisp->compiled_num].f = f;
+    compiled[lisp->compiled_num].ops = ops;
+    compiled[lisp->compiled_num].size = size;
+    lisp->compiled_num++;
+    return TL_SUCCESS;
+}
+
 int tl_add_var(LizyLang *lisp, Var *var, String *name) {
     Var *var_ptr;
     String *name_ptr;
+    Var copy;
     size_t i;
+    int rc;
     for(i=0;i<lisp->var_num;i++){
         if(lisp->var_names[i].len != name->len) continue;
-        if(!memcmp(name->data, lisp->var_names[i].data, name->len)){
+        if(!memcmp(VAR_RAW_STR_DATA(name),
+                   VAR_RAW_STR_DATA(lisp->var_names+i), name->len)){
             return TL_ERR_NAME_EXISTS;
         }
     }
+    if(var->ref && var->base){
+        /* A view may borrow the storage of a parameter, that is freed before
+         * the variable. */
+        rc = var_copy(&lisp->alloc, var, &copy);
+        if(rc) return rc;
+        var_free(&lisp->alloc, var);
+        *var = copy;
+    }
     lisp->var_num++;
-    var_ptr = realloc(lisp->vars, lisp->var_num*sizeof(Var));
+    var_ptr = TL_REALLOC(&lisp->alloc, lisp->vars, lisp->var_num*sizeof(Var));
     if(!var_ptr){
         lisp->var_num--;
         return TL_ERR_OUT_OF_MEM;
     }
     lisp->vars = var_ptr;
-    name_ptr = realloc(lisp->var_names, lisp->var_num*sizeof(String));
+    name_ptr = TL_REALLOC(&lisp->alloc, lisp->var_names,
+                          lisp->var_num*sizeof(String));
     if(!name_ptr){
         lisp->var_num--;
         return TL_ERR_OUT_OF_MEM;
@@ -432,6 +653,61 @@ int tl_add_var(LizyLang *lisp, Var *var, String *name) {
     return TL_SUCCESS;
 }
 
+void tl_index_const(LizyLang *lisp, size_t n) {
+    size_t mask = lisp->const_buckets-1;
+    size_t i = var_hash(lisp->consts[n], 2166136261UL)&mask;
+    while(lisp->const_table[i]) i = (i+1)&mask;
+    lisp->const_table[i] = n+1;
+}
+
+int tl_add_const(LizyLang *lisp, Var *var, Var **constant) {
+    Var **consts_ptr;
+    Var *new;
+    size_t *table;
+    size_t i, n, max, mask = lisp->const_buckets-1;
+    if(lisp->const_buckets){
+        i = var_hash(var, 2166136261UL)&mask;
+        for(;(n = lisp->const_table[i]);i=(i+1)&mask){
+            if(var_same(var, lisp->consts[n-1])){
+                /* This value is already in the pool. */
+                var_free(&lisp->alloc, var);
+                *constant = lisp->consts[n-1];
+                return TL_SUCCESS;
+            }
+        }
+    }
+    new = TL_MALLOC(&lisp->alloc, sizeof(Var));
+    if(!new){
+        var_free(&lisp->alloc, var);
+        return TL_ERR_OUT_OF_MEM;
+    }
+    if(lisp->const_num == lisp->const_max){
+        max = lisp->const_max ? lisp->const_max*2 : 16;
+        consts_ptr = TL_REALLOC(&lisp->alloc, lisp->consts,
+                                max*sizeof(Var*));
+        /* The table is kept at most half full. */
+        table = consts_ptr ? TL_MALLOC(&lisp->alloc, max*2*sizeof(size_t)) :
+                NULL;
+        if(consts_ptr) lisp->consts = consts_ptr;
+        if(!table){
+            TL_FREE(&lisp->alloc, new);
+            var_free(&lisp->alloc, var);
+            return TL_ERR_OUT_OF_MEM;
+        }
+        for(i=0;i<max*2;i++) table[i] = 0;
+        TL_FREE(&lisp->alloc, lisp->const_table);
+        lisp->const_table = table;
+        lisp->const_buckets = max*2;
+        lisp->const_max = max;
+        for(i=0;i<lisp->const_num;i++) tl_index_const(lisp, i);
+    }
+    *new = *var;
+    lisp->consts[lisp->const_num] = new;
+    tl_index_const(lisp, lisp->const_num++);
+    *constant = new;
+    return TL_SUCCESS;
+}
+
 int tl_set_var(LizyLang *lisp, Var *var, String *name) {
     size_t i;
     char found = 0;
@@ -442,15 +718,24 @@ int tl_set_var(LizyLang *lisp, Var *var, String *name) {
     if(!found){
         for(i=0;i<lisp->var_num;i++){
             if(lisp->var_names[i].len != name->len) continue;
-            if(!memcmp(name->data, lisp->var_names[i].data, name->len)){
+            if(!memcmp(VAR_RAW_STR_DATA(name),
+                       VAR_RAW_STR_DATA(lisp->var_names+i), name->len)){
                 /* Set the variable */
                 if(var->type != lisp->vars[i].type){
                     return TL_ERR_BAD_TYPE;
                 }
-                rc = var_free(lisp->vars+i);
+                /* The bytecode may call the function it replaces. */
+                if(var->type == TL_T_FUNC) lisp->code_gen++;
+                rc = var_free(&lisp->alloc, lisp->vars+i);
                 if(rc) return rc;
-                rc = var_copy(var, lisp->vars+i);
+                rc = var_copy(&lisp->alloc, var, lisp->vars+i);
                 if(rc) return rc;
+                if(var->type == TL_T_FUNC){
+                    /* The functions that used it may not be pure anymore. */
+                    rc = memo_clear(lisp);
+                    if(rc) return rc;
+                    return call_check_pure(lisp);
+                }
                 found = 1;
                 break;
             }
@@ -465,22 +750,32 @@ int tl_set_var(LizyLang *lisp, Var *var, String *name) {
 int tl_del_var(LizyLang *lisp, String *name) {
     size_t i;
     char found = 0;
+    char function = 0;
     int rc;
     for(i=0;i<lisp->var_num;i++){
         if(lisp->var_names[i].len != name->len) continue;
-        if(!memcmp(name->data, lisp->var_names[i].data, name->len)){
+        if(!memcmp(VAR_RAW_STR_DATA(name),
+                   VAR_RAW_STR_DATA(lisp->var_names+i), name->len)){
             /* Delete the variable */
-            rc = var_free(lisp->vars+i);
+            if(lisp->vars[i].type == TL_T_FUNC){
+                /* The functions that used it may not be pure anymore. */
+                rc = memo_clear(lisp);
+                if(rc) return rc;
+                lisp->code_gen++;
+                function = 1;
+            }
+            rc = var_free(&lisp->alloc, lisp->vars+i);
             if(rc) return rc;
-            rc = var_free_str(lisp->var_names+i);
+            rc = var_free_str(&lisp->alloc, lisp->var_names+i);
             if(rc) return rc;
             if(i < lisp->var_num-1){
                 memmove(lisp->vars+i, lisp->vars+i+1,
-                        sizeof(Var)*lisp->var_num-i-1);
+                        sizeof(Var)*(lisp->var_num-i-1));
                 memmove(lisp->var_names+i, lisp->var_names+i+1,
-                        sizeof(String)*lisp->var_num-i-1);
+                        sizeof(String)*(lisp->var_num-i-1));
             }
             lisp->var_num--;
+            if(function) return call_check_pure(lisp);
             found = 1;
             break;
         }
@@ -48,6 +48,17 @@
  * 2024/10/19: Preparing call-by-need evaluation.
  * 2024/10/20: New stack.
  * 2024/10/21: Perform calls in the right context.
+ * 2026/10/18: Constant pool. Per interpreter allocator. Memory accounting and
+ *             memory limit. Arguments of user defined functions, tail calls.
+ *             Growable stack and argument pool, removed the unused stacks.
+ *             Continuation stack. Share the arguments passed through.
+ *             Evaluate strict arguments first.
+ *             Optimise the tree before running it. Cache the results of
+ *             pure functions, save them to a file. Bytecode.
+ *             Specialised calls in the bytecode. Machine code. Functions
+ *             compiled ahead of time. Unboxed numeric code. Loops.
+ *             Streams. Bytecode translated to C ahead of time. Builtins
+ *             redefined by the program.
  */
 
 #ifndef LISP_H
@@ -58,36 +69,330 @@
 #include <var.h>
 
 typedef struct {
+    size_t live;
+    size_t peak;
+    size_t allocs;
+    size_t frees;
+    /* The maximum amount of live bytes, 0 if there is no limit. */
+    size_t limit;
+} TlMemStats;
+
+/* An argument passed to a user defined function: node is evaluated in context
+ * the first time the argument is used, and value is used afterwards. */
+typedef struct Arg {
+    void *node;
+    size_t context;
+    Var value;
+    char evaluated;
+    /* If a parameter was passed through, the argument it was passed as, that
+     * is evaluated instead, so that it is only evaluated once. */
+    struct Arg *thunk;
+} Arg;
+
+typedef struct {
+    Function *function;
+    void *call;
+    Arg *args;
+    /* Chunk of the argument pool args is in. */
+    size_t arg_chunk;
+    size_t parent;
+} Frame;
+
+typedef struct {
+    Arg *args;
+    size_t size;
+    size_t used;
+} ArgChunk;
+
+#define TL_FRAME(lisp, i) ((lisp)->frames[(i)/TL_FRAME_SEG_SZ]+ \
+                           (i)%TL_FRAME_SEG_SZ)
+
+/* The result of a call to a pure user defined function, with the values of
+ * its arguments. */
+typedef struct MemoEntry {
+    /* NULL if it was loaded from a file and its function is not defined
+     * yet, it is then found with the hash of the body of the function. */
+    void *fncdef;
+    unsigned long body;
+    unsigned long hash;
+    Var *args;
+    size_t argnum;
+    Var value;
+    /* Next entry of the bucket. */
+    struct MemoEntry *next;
+    /* The entries ordered by when they were last used. */
+    struct MemoEntry *newer;
+    struct MemoEntry *older;
+} MemoEntry;
+
+/* The hash of the body of a pure function, that changes when its code or
+ * the code of the functions it calls changes. */
+typedef struct {
+    void *fncdef;
+    unsigned long body;
+} MemoFunc;
+
+/* A node the bytecode uses. */
+typedef struct {
+    void *node;
+    /* Index the global variable or function the node names was last found
+     * at, checked before it is used. */
+    size_t var;
+    /* The builtin function the node calls, when it is called directly. */
+    Function function;
+    /* The call was run with arguments it cannot be specialised for. */
+    char generic;
+} CodeRef;
+
+/* A function compiled to native code. It gets the values of its parameters,
+ * that are all numbers, followed by room for the hidden ones, and returns 1
+ * if it gives up, to let the interpreter run the call. */
+typedef int (*TlNative)(float *args, unsigned int depth, float *result);
+
+/* A function called by a function compiled ahead of time: a builtin function
+ * if f is set, or else the function defined by a statement of the program. */
+typedef struct {
+    char *name;
+    size_t statement;
+    int (*f)(void *lisp, void* node, size_t argnum, void* returned);
+} TlNativeDep;
+
+/* A function of the program compiled ahead of time. It is used as long as
+ * the functions it calls are the ones it was compiled with. */
+typedef struct {
+    void *fncdef;
+    TlNative f;
+    TlNativeDep *deps;
+    size_t dep_num;
+} TlNativeFunc;
+
+/* The bytecode of a function of the program translated to C ahead of time.
+ * It runs the continuation like vm_run, from the instruction it is at. */
+typedef int (*TlCompiled)(void *lisp, void *cont);
+
+/* A function of the program whose bytecode was translated to C. It is used
+ * if the function is compiled to the same bytecode when the program runs. */
+typedef struct {
+    void *fncdef;
+    TlCompiled f;
+    unsigned char *ops;
+    size_t size;
+} TlCompiledFunc;
+
+/* An instruction of the code that runs a function on unboxed numbers. */
+typedef struct {
+    unsigned char op;
+    /* The parameter, the instruction jumped to or the amount of arguments
+     * passed. */
+    size_t arg;
+    float num;
+    /* The function called. */
+    struct Code *code;
+} NumOp;
+
+/* The body of a user defined function compiled to bytecode. */
+typedef struct Code {
+    void *fncdef;
+    unsigned char *ops;
+    size_t size;
+    CodeRef *refs;
+    size_t ref_num;
+    /* Offset of the first instruction of each body node, followed by its
+     * line. */
+    size_t *lines;
+    size_t line_num;
+    /* Amount of values on the stack at most. */
+    size_t stack;
+    /* Value of code_gen of the interpreter it was compiled with. */
+    size_t gen;
+    /* Times it was run, it is compiled to machine code once it is hot. */
+    unsigned long calls;
+    /* The machine code the JIT generated, or NULL. */
+    void *jit;
+    size_t jit_size;
+    /* The native code it runs, from the JIT or compiled ahead of time. */
+    TlNative native;
+    /* Its bytecode translated to C ahead of time, or NULL. */
+    TlCompiled compiled;
+    /* If it always gives a number when its arguments are numbers, the code
+     * that runs it on unboxed numbers, with the amount of parameters and of
+     * values on its stack. It is bounded if it never calls itself, so that
+     * its cost does not depend on its arguments. */
+    char typed;
+    char num_bounded;
+    NumOp *num;
+    size_t num_size;
+    size_t num_params;
+    size_t num_depth;
+    struct Code *next;
+} Code;
+
+enum {
+    /* The function to call has to be found. */
+    TL_C_START,
+    /* The arguments of a builtin function are evaluated. */
+    TL_C_ARGS,
+    TL_C_BUILTIN,
+    /* The strict arguments of a user defined function are evaluated. */
+    TL_C_STRICT,
+    /* The arguments of a pure user defined function are evaluated to look
+     * its result up in the cache. */
+    TL_C_MEMO,
+    /* The body of a user defined function is evaluated. */
+    TL_C_BODY,
+    /* The bytecode of the body of a user defined function is run. */
+    TL_C_VM,
+    /* The bytecode of an argument is run. */
+    TL_C_EXPR,
+    /* The arguments of a tail call are evaluated. */
+    TL_C_TAIL,
+    /* A loop runs its body. */
+    TL_C_LOOP,
+    /* A take pulls the elements of a stream. */
+    TL_C_STREAM
+};
+
+/* The loops of the builtin functions while, repeat and for. */
+enum {
+    TL_LOOP_WHILE,
+    TL_LOOP_REPEAT,
+    TL_LOOP_FOR
+};
+
+/* A call being evaluated by the evaluator: the value it returns is put in
+ * dest, and done is set to 1 once it is there. */
+typedef struct {
+    void *node;
+    size_t context;
+    Var *dest;
+    char *done;
+    Function *function;
+    /* Index of the first argument in the childs of node. */
+    size_t offset;
+    /* The arguments of a builtin function, or the arguments of a tail call
+     * being prepared. */
+    Arg *args;
+    size_t argnum;
+    size_t arg_chunk;
+    /* Amount of arguments evaluated before calling the builtin function. */
+    size_t evalnum;
+    /* Argument being evaluated, or body node to evaluate next. */
+    size_t i;
+    /* Value returned by the last body node. */
+    Var tmp;
+    char tmp_set;
+    /* Call to perform instead of this one once it returns, or tail call to
+     * perform in the frame of this one. */
+    void *then_node;
+    Function *then_function;
+    size_t then_offset;
+    unsigned char state;
+    /* The call is the last one of the body of the function below it. */
+    char tail;
+    /* Entry the result goes in once the body returned. */
+    MemoEntry *memo;
+    /* The bytecode being run, i is then the offset of the instruction to run
+     * next, args the stack and sp the amount of values on it. */
+    Code *code;
+    size_t sp;
+    /* The loop being run, i is then the argument to evaluate next. num is
+     * the value of the variable of a for or the amount of times a repeat
+     * ran, and end the value it stops at. */
+    unsigned char loop;
+    float loop_num;
+    float loop_end;
+} Cont;
+
+#define TL_CONT(lisp, i) ((lisp)->conts[(i)/TL_CONT_SEG_SZ]+ \
+                          (i)%TL_CONT_SEG_SZ)
+
+typedef struct {
+    /* Allocator used by the interpreter, it keeps track of the memory usage
+     * and allocates memory with backend. */
+    TlAllocator alloc;
+    TlAllocator backend;
+    TlMemStats mem;
     char *buffer;
     size_t sz;
     Var *vars;
     String *var_names;
     size_t var_num;
-    struct{
-        Function *function;
-        void *call;
-        Var *args;
-        char *evaluated;
-        size_t parent;
-    }stack[TL_STACK_SZ];
+    /* The literal values of the program, every value is only stored once.
+     * They are found with a hash table of const_buckets entries, that are
+     * the index of a value plus one, or 0. */
+    Var **consts;
+    size_t const_num;
+    size_t const_max;
+    size_t *const_table;
+    size_t const_buckets;
+    /* The frames of the calls to user defined functions. Segments are kept
+     * once allocated, so that a frame never moves. */
+    Frame **frames;
+    size_t frame_segs;
     size_t stack_cur;
-    Call fstack[TL_FSTACK_SZ];
-    size_t fstack_cur;
-    Var argstack[TL_ARGSTACK_SZ];
-    size_t argstack_fnc[TL_ARGSTACK_SZ];
-    size_t argstack_cur;
+    /* Pool the arguments of the frames are taken from. */
+    ArgChunk *arg_chunks;
+    size_t arg_chunk_num;
+    size_t arg_chunk_cur;
+    /* The calls being evaluated, the last one is evaluated next. It is
+     * segmented like the frames, so that a continuation never moves. */
+    Cont **conts;
+    size_t cont_segs;
+    size_t cont_cur;
     size_t line;
     Var last;
     Node node;
     void *current_node;
     size_t context;
+    /* The optimisation passes that are enabled. */
+    int opt;
+    /* While the tree is optimised, the variables the program may redefine,
+     * with the index they have in vars. */
+    char *opt_redefined;
+    /* The results of the calls to pure user defined functions. */
+    MemoEntry **memo;
+    MemoEntry *memo_newest;
+    MemoEntry *memo_oldest;
+    size_t memo_num;
+    MemoFunc *memo_funcs;
+    size_t memo_func_num;
+    /* File the cache is saved to when the interpreter is freed. */
+    char *memo_file;
+    /* Every bytecode compiled. The functions are compiled again when
+     * code_gen changes, because a function they call was replaced. */
+    Code *codes;
+    size_t code_gen;
+    /* The functions compiled ahead of time. */
+    TlNativeFunc *natives;
+    size_t native_num;
+    /* The bytecode translated ahead of time. */
+    TlCompiledFunc *compiled;
+    size_t compiled_num;
+    /* The values and the calls of the unboxed numeric code. */
+    float *num_stack;
+    size_t num_max;
+    void *num_frames;
+    size_t num_frame_max;
 } LizyLang;
 
-int tl_init(LizyLang *lisp, char *buffer, size_t sz);
+int tl_init(LizyLang *lisp, char *buffer, size_t sz, TlAllocator *alloc);
 int tl_add_var(LizyLang *lisp, Var *var, String *name);
+void tl_index_const(LizyLang *lisp, size_t n);
+int tl_add_const(LizyLang *lisp, Var *var, Var **constant);
 int tl_set_var(LizyLang *lisp, Var *var, String *name);
 int tl_del_var(LizyLang *lisp, String *name);
+const char *tl_message(int rc);
+int tl_parse(LizyLang *lisp, void error(char*, void*), void *data);
+int tl_exec(LizyLang *lisp, void error(char*, void*), void *data);
 int tl_run(LizyLang *lisp, void error(char*, void*), void *data);
+int tl_add_native(LizyLang *lisp, size_t statement, TlNative f,
+                  TlNativeDep *deps, size_t dep_num);
+int tl_add_compiled(LizyLang *lisp, size_t statement, TlCompiled f,
+                    unsigned char *ops, size_t size);
 int tl_free(LizyLang *lisp);
+int tl_set_mem_limit(LizyLang *lisp, size_t limit);
+int tl_get_mem_stats(LizyLang *lisp, TlMemStats *stats);
+int tl_set_opt(LizyLang *lisp, int passes);
+void lisp_free_nodes(Node *node, void *_lisp);
 
 #endif
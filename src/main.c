@@ -37,12 +37,17 @@
  * 2024/09/28: Started developement. File loading and error handler.
  * 2024/10/12: Avoid segfault if the file isn't found. Error message if the
  *             file isn't found.
+ * 2026/10/18: Use the default allocator. Optional memory limit. Optional
+ *             optimisation passes. Compile the program to C with --emit-c.
  */
 
 #include <lisp.h>
+#include <platform.h>
+#include <aot.h>
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 char *file = NULL;
 
@@ -56,9 +61,20 @@ int main(int argc, char **argv) {
     LizyLang lisp;
     size_t sz;
     char *buffer;
+    char emit = 0;
     int rc;
+#if TL_DEBUG_MEM
+    TlMemStats stats;
+#endif
+    if(argc > 1 && !strcmp(argv[1], "--emit-c")){
+        /* The C code is written to stdout. */
+        emit = 1;
+        argc--;
+        argv++;
+    }
     if(argc < 2){
-        fputs("USAGE: lizylang [INPUT]\n", stderr);
+        fputs("USAGE: lizylang [--emit-c] [INPUT] [MEMORY LIMIT IN BYTES] "
+              "[OPTIMISATION PASSES]\n", stderr);
         return EXIT_FAILURE;
     }
     file = argv[1];
@@ -77,9 +93,23 @@ int main(int argc, char **argv) {
     }
     fread(buffer, 1, sz, fp);
     fclose(fp);
-    tl_init(&lisp, buffer, sz);
-    rc = tl_run(&lisp, onerror, &lisp);
+    tl_init(&lisp, buffer, sz, NULL);
+    if(argc > 2) tl_set_mem_limit(&lisp, strtoul(argv[2], NULL, 10));
+    if(argc > 3) tl_set_opt(&lisp, strtol(argv[3], NULL, 10));
+    if(emit){
+        rc = tl_parse(&lisp, onerror, &lisp);
+        if(!rc) rc = aot_emit(&lisp, file, stdout);
+    }else{
+        rc = tl_run(&lisp, onerror, &lisp);
+    }
     tl_free(&lisp);
+#if TL_DEBUG_MEM
+    tl_get_mem_stats(&lisp, &stats);
+    fprintf(stderr, "[lizylang] Peak: %lu bytes, allocations: %lu, "
+            "frees: %lu, leaked: %lu bytes\n", (unsigned long)stats.peak,
+            (unsigned long)stats.allocs, (unsigned long)stats.frees,
+            (unsigned long)stats.live);
+#endif
     free(buffer);
     return rc;
 }
@@ -0,0 +1,427 @@
+/* A small interpreter for a lisp like language, targetting embedded systems.
+ * by Mibi88
+ *
+ * This software is licensed under the BSD-3-Clause license:
+ *
+ * Copyright 2024 Mibi88
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* CHANGELOG
+ *
+ * 2026/10/18: Created this file. Cache of the results of pure functions.
+ *             Save the cache to a file. Hash the bodies without recursing.
+ */
+
+#include <memo.h>
+#include <call.h>
+
+unsigned long memo_hash(Var **values, size_t num) {
+    unsigned long hash = 2166136261UL;
+    size_t i;
+    for(i=0;i<num;i++){
+        hash = var_hash(values[i], hash);
+    }
+    return hash;
+}
+
+MemoEntry *memo_find(LizyLang *lisp, void *fncdef, Var **values, size_t num,
+                     unsigned long hash) {
+    MemoEntry *entry;
+    size_t i;
+    if(!lisp->memo) return NULL;
+    for(entry=lisp->memo[hash%TL_MEMO_BUCKETS];entry;entry=entry->next){
+        if(entry->hash != hash || entry->fncdef != fncdef ||
+           entry->argnum != num){
+            continue;
+        }
+        for(i=0;i<num;i++){
+            if(!var_same(entry->args+i, values[i])) break;
+        }
+        if(i < num) continue;
+        /* It becomes the most recently used one. */
+        if(entry != lisp->memo_newest){
+            entry->newer->older = entry->older;
+            if(entry->older) entry->older->newer = entry->newer;
+            else lisp->memo_oldest = entry->newer;
+            entry->older = lisp->memo_newest;
+            entry->newer = NULL;
+            lisp->memo_newest->newer = entry;
+            lisp->memo_newest = entry;
+        }
+        return entry;
+    }
+    return NULL;
+}
+
+int memo_new(LizyLang *lisp, void *fncdef, Var **values, size_t num,
+             unsigned long hash, MemoEntry **entry) {
+    size_t i;
+    int rc;
+    *entry = TL_MALLOC(&lisp->alloc, sizeof(MemoEntry));
+    if(!*entry) return TL_ERR_OUT_OF_MEM;
+    (*entry)->fncdef = fncdef;
+    (*entry)->body = 0;
+    (*entry)->hash = hash;
+    (*entry)->argnum = 0;
+    (*entry)->args = NULL;
+    if(num){
+        (*entry)->args = TL_MALLOC(&lisp->alloc, num*sizeof(Var));
+        if(!(*entry)->args){
+            TL_FREE(&lisp->alloc, *entry);
+            *entry = NULL;
+            return TL_ERR_OUT_OF_MEM;
+        }
+    }
+    for(i=0;i<num;i++){
+        rc = var_copy(&lisp->alloc, values[i], (*entry)->args+i);
+        if(rc){
+            memo_free_entry(lisp, *entry);
+            *entry = NULL;
+            return rc;
+        }
+        (*entry)->argnum++;
+    }
+    return TL_SUCCESS;
+}
+
+int memo_free_entry(LizyLang *lisp, MemoEntry *entry) {
+    size_t i;
+    for(i=0;i<entry->argnum;i++){
+        var_free(&lisp->alloc, entry->args+i);
+    }
+    TL_FREE(&lisp->alloc, entry->args);
+    TL_FREE(&lisp->alloc, entry);
+    return TL_SUCCESS;
+}
+
+int memo_unlink(LizyLang *lisp, MemoEntry *entry) {
+    MemoEntry **link = lisp->memo+entry->hash%TL_MEMO_BUCKETS;
+    while(*link != entry) link = &(*link)->next;
+    *link = entry->next;
+    if(entry->newer) entry->newer->older = entry->older;
+    else lisp->memo_newest = entry->older;
+    if(entry->older) entry->older->newer = entry->newer;
+    else lisp->memo_oldest = entry->newer;
+    lisp->memo_num--;
+    return TL_SUCCESS;
+}
+
+int memo_add(LizyLang *lisp, MemoEntry *entry, Var *value) {
+    MemoEntry *oldest;
+    size_t i;
+    int rc;
+    /* The cache only saves time, so it is not an error if there is no
+     * memory left for it. */
+    if(!lisp->memo){
+        lisp->memo = TL_MALLOC(&lisp->alloc,
+                               TL_MEMO_BUCKETS*sizeof(MemoEntry*));
+        if(!lisp->memo){
+            memo_free_entry(lisp, entry);
+            return TL_SUCCESS;
+        }
+        for(i=0;i<TL_MEMO_BUCKETS;i++) lisp->memo[i] = NULL;
+    }
+    rc = var_copy(&lisp->alloc, value, &entry->value);
+    if(rc){
+        memo_free_entry(lisp, entry);
+        return TL_SUCCESS;
+    }
+    if(lisp->memo_num >= TL_MEMO_MAX){
+        oldest = lisp->memo_oldest;
+        memo_unlink(lisp, oldest);
+        var_free(&lisp->alloc, &oldest->value);
+        memo_free_entry(lisp, oldest);
+    }
+    entry->next = lisp->memo[entry->hash%TL_MEMO_BUCKETS];
+    lisp->memo[entry->hash%TL_MEMO_BUCKETS] = entry;
+    entry->newer = NULL;
+    entry->older = lisp->memo_newest;
+    if(lisp->memo_newest) lisp->memo_newest->newer = entry;
+    else lisp->memo_oldest = entry;
+    lisp->memo_newest = entry;
+    lisp->memo_num++;
+    return TL_SUCCESS;
+}
+
+int memo_clear(LizyLang *lisp) {
+    MemoEntry *entry;
+    while(lisp->memo_oldest){
+        entry = lisp->memo_oldest;
+        memo_unlink(lisp, entry);
+        var_free(&lisp->alloc, &entry->value);
+        memo_free_entry(lisp, entry);
+    }
+    TL_FREE(&lisp->alloc, lisp->memo);
+    lisp->memo = NULL;
+    return TL_SUCCESS;
+}
+
+unsigned long memo_body_hash(LizyLang *lisp, Node *root, unsigned long hash) {
+    Function *function;
+    String *name;
+    Node *node;
+    Var tmp;
+    /* Each node is hashed before its children. */
+    for(node=root;node;node=node_next(root, node)){
+        if(node->var->type == TL_T_CALL && node->var->size == 1){
+            name = &node->var->items->call.function;
+            tmp.type = TL_T_NAME;
+            tmp.size = 1;
+            tmp.storage = TL_S_ITEMS;
+            tmp.items = (Item*)name;
+            hash = var_hash(&tmp, hash);
+            /* A change in a function that is called changes the result
+             * too. */
+            if(!call_find_func(lisp, name, &function) && !function->builtin){
+                hash = ((hash^memo_func_body(lisp, function->ptr.fncdef))*
+                        16777619UL)&0xFFFFFFFFUL;
+            }
+        }else{
+            hash = var_hash(node->var, hash);
+        }
+        hash = ((hash^(node->childnum&0xFF))*16777619UL)&0xFFFFFFFFUL;
+    }
+    return hash;
+}
+
+unsigned long memo_func_body(LizyLang *lisp, void *fncdef) {
+    size_t i;
+    for(i=0;i<lisp->memo_func_num;i++){
+        if(lisp->memo_funcs[i].fncdef == fncdef){
+            return lisp->memo_funcs[i].body;
+        }
+    }
+    return 0;
+}
+
+int memo_add_func(LizyLang *lisp, Node *fncdef) {
+    MemoFunc *funcs;
+    MemoEntry *entry;
+    unsigned long body = memo_body_hash(lisp, fncdef, 2166136261UL);
+    funcs = TL_REALLOC(&lisp->alloc, lisp->memo_funcs,
+                       (lisp->memo_func_num+1)*sizeof(MemoFunc));
+    if(!funcs) return TL_ERR_OUT_OF_MEM;
+    lisp->memo_funcs = funcs;
+    funcs[lisp->memo_func_num].fncdef = fncdef;
+    funcs[lisp->memo_func_num].body = body;
+    lisp->memo_func_num++;
+    /* The results loaded for this code are the ones of this function. */
+    for(entry=lisp->memo_newest;entry;entry=entry->older){
+        if(!entry->fncdef && entry->body == body) entry->fncdef = fncdef;
+    }
+    return TL_SUCCESS;
+}
+
+char memo_storable(Var *var) {
+    return var->type == TL_T_NUM || var->type == TL_T_STR ||
+           var->type == TL_T_NAME;
+}
+
+int memo_write_num(FILE *fp, unsigned long num) {
+    size_t i;
+    /* Numbers are stored in little endian, with 4 bytes. */
+    for(i=0;i<4;i++){
+        fputc((num>>(i*8))&0xFF, fp);
+    }
+    return TL_SUCCESS;
+}
+
+char memo_read_num(FILE *fp, unsigned long *num) {
+    size_t i;
+    int c;
+    *num = 0;
+    for(i=0;i<4;i++){
+        c = fgetc(fp);
+        if(c == EOF) return 0;
+        *num |= (unsigned long)c<<(i*8);
+    }
+    return 1;
+}
+
+int memo_write_var(FILE *fp, Var *var) {
+    size_t i;
+    float num;
+    fputc(var->type, fp);
+    memo_write_num(fp, var->size);
+    for(i=0;i<var->size;i++){
+        if(var->type == TL_T_NUM){
+            /* The file is meant to be used on the machine that wrote it. */
+            num = VAR_NUM_AT(var, i);
+            fwrite(&num, 1, sizeof(float), fp);
+        }else if(var->type == TL_T_STR){
+            memo_write_num(fp, VAR_STR_LEN_AT(var, i));
+            fwrite(VAR_STR_AT(var, i), 1, VAR_STR_LEN_AT(var, i), fp);
+        }else{
+            memo_write_num(fp, var->items[i].string.len);
+            fwrite(VAR_STR_DATA(var->items[i]), 1, var->items[i].string.len,
+                   fp);
+        }
+    }
+    return TL_SUCCESS;
+}
+
+int memo_read_var(LizyLang *lisp, FILE *fp, Var *var, unsigned long max) {
+    unsigned long size, len;
+    size_t i;
+    char *data;
+    int type;
+    int rc = TL_SUCCESS;
+    type = fgetc(fp);
+    if(type != TL_T_NUM && type != TL_T_STR && type != TL_T_NAME){
+        return TL_ERR_BAD_TYPE;
+    }
+    /* Nothing can be bigger than the file. */
+    if(!memo_read_num(fp, &size) || size > max) return TL_ERR_BAD_TYPE;
+    var->type = type;
+    var->size = 0;
+    var->null = 0;
+    var->ref = 0;
+    var->storage = TL_S_ITEMS;
+    var->base = NULL;
+    var->items = NULL;
+    if(size){
+        var->items = TL_MALLOC(&lisp->alloc, size*sizeof(Item));
+        if(!var->items) return TL_ERR_OUT_OF_MEM;
+    }
+    for(i=0;i<size;i++){
+        if(type == TL_T_NUM){
+            if(fread(&var->items[i].num, 1, sizeof(float), fp) !=
+               sizeof(float)){
+                rc = TL_ERR_BAD_TYPE;
+                break;
+            }
+            var->size++;
+            continue;
+        }
+        if(!memo_read_num(fp, &len) || len > max){
+            rc = TL_ERR_BAD_TYPE;
+            break;
+        }
+        rc = var_raw_str_alloc(&lisp->alloc, &var->items[i].string, len);
+        if(rc) break;
+        var->size++;
+        data = VAR_RAW_STR_DATA(&var->items[i].string);
+        if(fread(data, 1, len, fp) != len){
+            rc = TL_ERR_BAD_TYPE;
+            break;
+        }
+    }
+    if(i < size){
+        var_free_items(&lisp->alloc, var, 0, var->size);
+        TL_FREE(&lisp->alloc, var->items);
+        return rc;
+    }
+    return TL_SUCCESS;
+}
+
+int memo_load_entry(LizyLang *lisp, FILE *fp, unsigned long max) {
+    MemoEntry *entry;
+    Var *values[TL_STRICT_MAX];
+    Var args[TL_STRICT_MAX];
+    Var value;
+    unsigned long body, num;
+    size_t i, n;
+    int rc = TL_SUCCESS;
+    if(!memo_read_num(fp, &body) || !memo_read_num(fp, &num) ||
+       num > TL_STRICT_MAX){
+        return TL_ERR_BAD_TYPE;
+    }
+    for(n=0;n<num;n++){
+        rc = memo_read_var(lisp, fp, args+n, max);
+        if(rc) break;
+        values[n] = args+n;
+    }
+    if(!rc) rc = memo_read_var(lisp, fp, &value, max);
+    if(!rc){
+        rc = memo_new(lisp, NULL, values, num, memo_hash(values, num),
+                      &entry);
+        if(!rc){
+            entry->body = body;
+            /* The function may be defined already. */
+            for(i=0;i<lisp->memo_func_num;i++){
+                if(lisp->memo_funcs[i].body == body){
+                    entry->fncdef = lisp->memo_funcs[i].fncdef;
+                }
+            }
+            rc = memo_add(lisp, entry, &value);
+        }
+        var_free(&lisp->alloc, &value);
+    }
+    for(i=0;i<n;i++) var_free(&lisp->alloc, args+i);
+    return rc;
+}
+
+int memo_load(LizyLang *lisp, char *path, size_t len) {
+    FILE *fp;
+    char magic[8];
+    unsigned long sz;
+    TL_FREE(&lisp->alloc, lisp->memo_file);
+    lisp->memo_file = TL_MALLOC(&lisp->alloc, len+1);
+    if(!lisp->memo_file) return TL_ERR_OUT_OF_MEM;
+    memcpy(lisp->memo_file, path, len);
+    lisp->memo_file[len] = '\0';
+    /* There is nothing to load the first time. */
+    fp = fopen(lisp->memo_file, "rb");
+    if(!fp) return TL_SUCCESS;
+    fseek(fp, 0L, SEEK_END);
+    sz = ftell(fp);
+    rewind(fp);
+    if(fread(magic, 1, 8, fp) == 8 && !memcmp(magic, "LZYMEMO1", 8)){
+        /* A damaged end is ignored. */
+        while(!memo_load_entry(lisp, fp, sz));
+    }
+    fclose(fp);
+    return TL_SUCCESS;
+}
+
+int memo_save(LizyLang *lisp) {
+    FILE *fp;
+    MemoEntry *entry;
+    size_t i;
+    fp = fopen(lisp->memo_file, "wb");
+    if(!fp) return TL_ERR_BAD_INPUT;
+    fwrite("LZYMEMO1", 1, 8, fp);
+    /* The least recently used results are loaded first, so that they are
+     * dropped first again. */
+    for(entry=lisp->memo_oldest;entry;entry=entry->newer){
+        if(!memo_storable(&entry->value)) continue;
+        for(i=0;i<entry->argnum;i++){
+            if(!memo_storable(entry->args+i)) break;
+        }
+        if(i < entry->argnum) continue;
+        memo_write_num(fp, entry->fncdef ?
+                       memo_func_body(lisp, entry->fncdef) : entry->body);
+        memo_write_num(fp, entry->argnum);
+        for(i=0;i<entry->argnum;i++) memo_write_var(fp, entry->args+i);
+        memo_write_var(fp, &entry->value);
+    }
+    fclose(fp);
+    return TL_SUCCESS;
+}
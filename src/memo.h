@@ -0,0 +1,70 @@
+/* A small interpreter for a lisp like language, targetting embedded systems.
+ * by Mibi88
+ *
+ * This software is licensed under the BSD-3-Clause license:
+ *
+ * Copyright 2024 Mibi88
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* CHANGELOG
+ *
+ * 2026/10/18: Created this file. Cache of the results of pure functions.
+ *             Save the cache to a file.
+ */
+
+#ifndef MEMO_H
+#define MEMO_H
+
+#include <lisp.h>
+#include <var.h>
+#include <tree.h>
+
+unsigned long memo_hash(Var **values, size_t num);
+MemoEntry *memo_find(LizyLang *lisp, void *fncdef, Var **values, size_t num,
+                     unsigned long hash);
+int memo_new(LizyLang *lisp, void *fncdef, Var **values, size_t num,
+             unsigned long hash, MemoEntry **entry);
+int memo_free_entry(LizyLang *lisp, MemoEntry *entry);
+int memo_unlink(LizyLang *lisp, MemoEntry *entry);
+int memo_add(LizyLang *lisp, MemoEntry *entry, Var *value);
+int memo_clear(LizyLang *lisp);
+unsigned long memo_body_hash(LizyLang *lisp, Node *root, unsigned long hash);
+unsigned long memo_func_body(LizyLang *lisp, void *fncdef);
+int memo_add_func(LizyLang *lisp, Node *fncdef);
+char memo_storable(Var *var);
+int memo_write_num(FILE *fp, unsigned long num);
+char memo_read_num(FILE *fp, unsigned long *num);
+int memo_write_var(FILE *fp, Var *var);
+int memo_read_var(LizyLang *lisp, FILE *fp, Var *var, unsigned long max);
+int memo_load_entry(LizyLang *lisp, FILE *fp, unsigned long max);
+int memo_load(LizyLang *lisp, char *path, size_t len);
+int memo_save(LizyLang *lisp);
+
+#endif
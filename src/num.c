@@ -0,0 +1,432 @@
+/* A small interpreter for a lisp like language, targetting embedded systems.
+ * by Mibi88
+ *
+ * This software is licensed under the BSD-3-Clause license:
+ *
+ * Copyright 2024 Mibi88
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* CHANGELOG
+ *
+ * 2026/10/18: Created this file. Type inference, run the numeric functions
+ *             on unboxed numbers.
+ */
+
+#include <num.h>
+#include <call.h>
+#include <builtin.h>
+#include <vm.h>
+
+#include <math.h>
+#include <string.h>
+
+/* The type of the body of a function is inferred the first time it is run
+ * from bytecode, assuming that its arguments are numbers: numbers and
+ * parameters are numbers, and so are the results of the arithmetic and
+ * comparison builtins, floor, ceil and if when their arguments are numbers,
+ * and of the functions that always give numbers. If the whole body is made
+ * of numbers, it is compiled to code that runs on a stack of floats, without
+ * allocating any value. It runs when the arguments are numbers that were
+ * already evaluated, and gives up, so that the interpreter runs the call
+ * instead, when it would divide by zero or when the calls are too deep. */
+
+int num_builtin_op(int f(void*, void*, size_t, void*)) {
+    if(f == builtin_add) return TL_NUM_ADD;
+    if(f == builtin_substract) return TL_NUM_SUB;
+    if(f == builtin_multiply) return TL_NUM_MUL;
+    if(f == builtin_divide) return TL_NUM_DIV;
+    if(f == builtin_modulo) return TL_NUM_MOD;
+    if(f == builtin_smaller) return TL_NUM_LT;
+    if(f == builtin_bigger) return TL_NUM_GT;
+    if(f == builtin_smaller_or_equal) return TL_NUM_LE;
+    if(f == builtin_bigger_or_equal) return TL_NUM_GE;
+    if(f == builtin_equal) return TL_NUM_EQ;
+    if(f == builtin_not_equal) return TL_NUM_NE;
+    if(f == builtin_floor) return TL_NUM_FLOOR;
+    if(f == builtin_ceil) return TL_NUM_CEIL;
+    return TL_NUM_NONE;
+}
+
+/* Finds the code of the user defined function called, if it always gives a
+ * number. */
+char num_callee(NumCompiler *c, Node *node, Code **callee) {
+    Function *function;
+    if(call_node_func(c->lisp, node, &function)) return 0;
+    if(node->childnum != VAR_LEN((Var*)function->params)-function->lets){
+        return 0;
+    }
+    if(function->ptr.fncdef == c->function->ptr.fncdef){
+        *callee = c->code;
+        return 1;
+    }
+    if(!function->code ||
+       ((Code*)function->code)->gen != c->lisp->code_gen){
+        if(vm_compile(c->lisp, function)) return 0;
+    }
+    *callee = function->code;
+    /* The functions that call each other are left to the interpreter, as
+     * their type would depend on itself. */
+    if((*callee)->typed == TL_NUM_UNKNOWN){
+        num_compile(c->lisp, function, *callee);
+    }
+    /* The calls would not use the cache, it is only worth it if the
+     * function recurses. */
+    if(function->memo && c->lisp->opt & TL_OPT_MEMO &&
+       !(*callee)->num_bounded){
+        return 0;
+    }
+    return (*callee)->typed == TL_NUM_YES;
+}
+
+char num_infer(NumCompiler *c, Node *node, char in_call) {
+    Function *function;
+    Code *callee;
+    Var *var = node->var;
+    size_t i, n;
+    int op;
+    if(var->type == TL_T_NUM) return VAR_LEN(var) == 1;
+    if(var->type == TL_T_NAME){
+        return VAR_LEN(var) == 1 && call_node_param(node, c->params, &n) &&
+               n < c->visible;
+    }
+    if(var->type != TL_T_CALL || VAR_LEN(var) != 1) return 0;
+    if(call_node_func(c->lisp, node, &function)) return 0;
+    if(!function->builtin){
+        if(!num_callee(c, node, &callee)) return 0;
+        /* Its arguments are evaluated before the call instead of when they
+         * are used, so they must not be able to recurse: they would cost
+         * more than the lazy call when it does not use them. */
+        if(callee == c->code || !callee->num_bounded){
+            if(in_call) return 0;
+            c->bounded = 0;
+        }
+        in_call = 1;
+    }else if(function->ptr.f == builtin_if){
+        if(node->childnum != 3) return 0;
+    }else{
+        op = num_builtin_op(function->ptr.f);
+        if(op == TL_NUM_NONE ||
+           node->childnum != (op == TL_NUM_FLOOR || op == TL_NUM_CEIL ? 1 :
+                              2)){
+            return 0;
+        }
+    }
+    for(i=0;i<node->childnum;i++){
+        if(!num_infer(c, ((Node**)node->childs)[i], in_call)) return 0;
+    }
+    return 1;
+}
+
+void num_emit(NumCompiler *c, unsigned char op, size_t arg, float num,
+              Code *callee) {
+    Code *code = c->code;
+    NumOp *ops;
+    size_t max;
+    if(c->rc) return;
+    if(code->num_size >= c->max){
+        max = c->max ? c->max*2 : 32;
+        ops = TL_REALLOC(&c->lisp->alloc, code->num, max*sizeof(NumOp));
+        if(!ops){
+            c->rc = TL_ERR_OUT_OF_MEM;
+            return;
+        }
+        code->num = ops;
+        c->max = max;
+    }
+    ops = code->num+code->num_size++;
+    ops->op = op;
+    ops->arg = arg;
+    ops->num = num;
+    ops->code = callee;
+}
+
+void num_push(NumCompiler *c, size_t n) {
+    c->sp += n;
+    if(c->sp > c->code->num_depth) c->code->num_depth = c->sp;
+}
+
+void num_expr(NumCompiler *c, Node *node, char tail) {
+    Function *function;
+    Code *callee;
+    Var *var = node->var;
+    size_t i, n, jump, end;
+    int op;
+    if(var->type == TL_T_NUM){
+        num_emit(c, TL_NUM_CONST, 0, VAR_NUM_AT(var, 0), NULL);
+        num_push(c, 1);
+        return;
+    }
+    if(var->type == TL_T_NAME){
+        call_node_param(node, c->params, &n);
+        num_emit(c, TL_NUM_PARAM, n, 0, NULL);
+        num_push(c, 1);
+        return;
+    }
+    call_node_func(c->lisp, node, &function);
+    if(function->builtin && function->ptr.f == builtin_if){
+        num_expr(c, ((Node**)node->childs)[0], 0);
+        jump = c->code->num_size;
+        num_emit(c, TL_NUM_JUMP_IF_NOT, 0, 0, NULL);
+        c->sp--;
+        num_expr(c, ((Node**)node->childs)[1], tail);
+        end = c->code->num_size;
+        num_emit(c, TL_NUM_JUMP, 0, 0, NULL);
+        c->sp--;
+        if(!c->rc) c->code->num[jump].arg = c->code->num_size;
+        num_expr(c, ((Node**)node->childs)[2], tail);
+        if(!c->rc) c->code->num[end].arg = c->code->num_size;
+        return;
+    }
+    for(i=0;i<node->childnum;i++){
+        num_expr(c, ((Node**)node->childs)[i], 0);
+    }
+    if(!function->builtin){
+        num_callee(c, node, &callee);
+        /* A call of itself in tail position is a jump. */
+        num_emit(c, tail && callee == c->code ? TL_NUM_TAIL : TL_NUM_CALL,
+                 node->childnum, 0, callee);
+        c->sp -= node->childnum;
+        num_push(c, 1);
+        return;
+    }
+    op = num_builtin_op(function->ptr.f);
+    num_emit(c, op, 0, 0, NULL);
+    if(op != TL_NUM_FLOOR && op != TL_NUM_CEIL) c->sp--;
+}
+
+int num_compile(LizyLang *lisp, Function *function, Code *code) {
+    Node *fncdef = function->ptr.fncdef;
+    Node *names = ((Node**)fncdef->childs)[1];
+    NumCompiler c;
+    size_t argnum = VAR_LEN((Var*)function->params);
+    size_t i;
+    code->typed = TL_NUM_NO;
+    if(!(lisp->opt & TL_OPT_TYPES) || fncdef->childnum < 3 ||
+       names->childnum != argnum || argnum-function->lets > TL_JIT_ARGS){
+        return TL_SUCCESS;
+    }
+    code->typed = TL_NUM_BUSY;
+    c.lisp = lisp;
+    c.function = function;
+    c.code = code;
+    c.params = function->params;
+    c.passed = argnum-function->lets;
+    c.visible = argnum;
+    c.max = 0;
+    c.bounded = 1;
+    c.sp = 0;
+    c.rc = TL_SUCCESS;
+    for(i=2;i<fncdef->childnum;i++){
+        if(!num_infer(&c, ((Node**)fncdef->childs)[i], 0)){
+            code->typed = TL_NUM_NO;
+            return TL_SUCCESS;
+        }
+    }
+    for(i=c.passed;i<argnum;i++){
+        c.visible = i;
+        if(!num_infer(&c, call_let(names, i), 1)){
+            code->typed = TL_NUM_NO;
+            return TL_SUCCESS;
+        }
+    }
+    /* The hidden parameters are computed first. */
+    for(i=c.passed;i<argnum;i++){
+        num_expr(&c, call_let(names, i), 0);
+        num_emit(&c, TL_NUM_SET, i, 0, NULL);
+        c.sp--;
+    }
+    for(i=2;i<fncdef->childnum;i++){
+        num_expr(&c, ((Node**)fncdef->childs)[i], i == fncdef->childnum-1);
+        if(i < fncdef->childnum-1){
+            num_emit(&c, TL_NUM_POP, 0, 0, NULL);
+            c.sp--;
+        }
+    }
+    num_emit(&c, TL_NUM_RET, 0, 0, NULL);
+    /* The calls it makes to itself would not use the cache. */
+    if(c.rc || (function->memo && lisp->opt & TL_OPT_MEMO && !c.bounded)){
+        TL_FREE(&lisp->alloc, code->num);
+        code->num = NULL;
+        code->num_size = 0;
+        code->typed = TL_NUM_NO;
+        return c.rc;
+    }
+    code->num_params = argnum;
+    code->num_bounded = c.bounded;
+    code->typed = TL_NUM_YES;
+    return TL_SUCCESS;
+}
+
+char num_reserve(LizyLang *lisp, size_t size) {
+    float *stack;
+    size_t max;
+    if(size <= lisp->num_max) return 0;
+    max = lisp->num_max ? lisp->num_max*2 : 256;
+    while(max < size) max *= 2;
+    stack = TL_REALLOC(&lisp->alloc, lisp->num_stack, max*sizeof(float));
+    if(!stack) return 1;
+    lisp->num_stack = stack;
+    lisp->num_max = max;
+    return 0;
+}
+
+char num_run(LizyLang *lisp, Code *code, float *args, size_t passed,
+             float *result) {
+    NumFrame *frame;
+    NumOp *op;
+    float *stack;
+    float value;
+    size_t fp = 0;
+    size_t base = 0;
+    size_t pc = 0;
+    size_t sp = code->num_params;
+    size_t max;
+    if(num_reserve(lisp, code->num_params+code->num_depth)) return 1;
+    stack = lisp->num_stack;
+    memcpy(stack, args, passed*sizeof(float));
+    for(;;){
+        op = code->num+pc++;
+        switch(op->op){
+            case TL_NUM_CONST:
+                stack[sp++] = op->num;
+                break;
+            case TL_NUM_PARAM:
+                stack[sp] = stack[base+op->arg];
+                sp++;
+                break;
+            case TL_NUM_SET:
+                stack[base+op->arg] = stack[--sp];
+                break;
+            case TL_NUM_POP:
+                sp--;
+                break;
+            case TL_NUM_ADD:
+                sp--;
+                stack[sp-1] += stack[sp];
+                break;
+            case TL_NUM_SUB:
+                sp--;
+                stack[sp-1] -= stack[sp];
+                break;
+            case TL_NUM_MUL:
+                sp--;
+                stack[sp-1] *= stack[sp];
+                break;
+            case TL_NUM_DIV:
+                sp--;
+                if(stack[sp] == 0) return 1;
+                stack[sp-1] /= stack[sp];
+                break;
+            case TL_NUM_MOD:
+                sp--;
+                if(stack[sp] == 0) return 1;
+                stack[sp-1] = fmod(stack[sp-1], stack[sp]);
+                break;
+            case TL_NUM_LT:
+                sp--;
+                stack[sp-1] = stack[sp-1] < stack[sp];
+                break;
+            case TL_NUM_GT:
+                sp--;
+                stack[sp-1] = stack[sp-1] > stack[sp];
+                break;
+            case TL_NUM_LE:
+                sp--;
+                stack[sp-1] = stack[sp-1] <= stack[sp];
+                break;
+            case TL_NUM_GE:
+                sp--;
+                stack[sp-1] = stack[sp-1] >= stack[sp];
+                break;
+            case TL_NUM_EQ:
+                sp--;
+                stack[sp-1] = stack[sp-1] == stack[sp];
+                break;
+            case TL_NUM_NE:
+                sp--;
+                stack[sp-1] = stack[sp-1] != stack[sp];
+                break;
+            case TL_NUM_FLOOR:
+                stack[sp-1] = floor(stack[sp-1]);
+                break;
+            case TL_NUM_CEIL:
+                stack[sp-1] = ceil(stack[sp-1]);
+                break;
+            case TL_NUM_JUMP_IF_NOT:
+                if(stack[--sp] == 0) pc = op->arg;
+                break;
+            case TL_NUM_JUMP:
+                pc = op->arg;
+                break;
+            case TL_NUM_TAIL:
+                sp -= op->arg;
+                memmove(stack+base, stack+sp, op->arg*sizeof(float));
+                sp = base+code->num_params;
+                pc = 0;
+                break;
+            case TL_NUM_CALL:
+                if(fp+1 >= TL_JIT_DEPTH) return 1;
+                if(fp >= lisp->num_frame_max){
+                    max = lisp->num_frame_max ? lisp->num_frame_max*2 : 64;
+                    frame = TL_REALLOC(&lisp->alloc, lisp->num_frames,
+                                       max*sizeof(NumFrame));
+                    if(!frame) return 1;
+                    lisp->num_frames = frame;
+                    lisp->num_frame_max = max;
+                }
+                frame = (NumFrame*)lisp->num_frames+fp++;
+                frame->code = code;
+                frame->pc = pc;
+                frame->base = base;
+                /* The arguments become the parameters of the callee. */
+                base = sp-op->arg;
+                code = op->code;
+                if(num_reserve(lisp, base+code->num_params+code->num_depth)){
+                    return 1;
+                }
+                stack = lisp->num_stack;
+                sp = base+code->num_params;
+                pc = 0;
+                break;
+            default:
+                value = stack[sp-1];
+                if(!fp){
+                    *result = value;
+                    return 0;
+                }
+                frame = (NumFrame*)lisp->num_frames+--fp;
+                sp = base;
+                stack[sp++] = value;
+                code = frame->code;
+                pc = frame->pc;
+                base = frame->base;
+        }
+    }
+}
@@ -0,0 +1,118 @@
+/* A small interpreter for a lisp like language, targetting embedded systems.
+ * by Mibi88
+ *
+ * This software is licensed under the BSD-3-Clause license:
+ *
+ * Copyright 2024 Mibi88
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* CHANGELOG
+ *
+ * 2026/10/18: Created this file. Type inference, run the numeric functions
+ *             on unboxed numbers.
+ */
+
+#ifndef NUM_H
+#define NUM_H
+
+#include <lisp.h>
+#include <var.h>
+#include <tree.h>
+
+/* If a function was proved to always give a number. */
+enum {
+    TL_NUM_UNKNOWN,
+    TL_NUM_BUSY,
+    TL_NUM_YES,
+    TL_NUM_NO
+};
+
+enum {
+    TL_NUM_CONST,
+    TL_NUM_PARAM,
+    TL_NUM_SET,
+    TL_NUM_POP,
+    TL_NUM_ADD,
+    TL_NUM_SUB,
+    TL_NUM_MUL,
+    TL_NUM_DIV,
+    TL_NUM_MOD,
+    TL_NUM_LT,
+    TL_NUM_GT,
+    TL_NUM_LE,
+    TL_NUM_GE,
+    TL_NUM_EQ,
+    TL_NUM_NE,
+    TL_NUM_FLOOR,
+    TL_NUM_CEIL,
+    TL_NUM_JUMP_IF_NOT,
+    TL_NUM_JUMP,
+    TL_NUM_CALL,
+    TL_NUM_TAIL,
+    TL_NUM_RET,
+    TL_NUM_NONE
+};
+
+/* A call being run, to return to. */
+typedef struct {
+    Code *code;
+    size_t pc;
+    size_t base;
+} NumFrame;
+
+typedef struct {
+    LizyLang *lisp;
+    Function *function;
+    Code *code;
+    Var *params;
+    size_t passed;
+    /* Only the first visible parameters can be used: the hidden ones are
+     * computed one after the other. */
+    size_t visible;
+    size_t max;
+    char bounded;
+    /* Amount of values on the stack. */
+    size_t sp;
+    int rc;
+} NumCompiler;
+
+int num_builtin_op(int f(void*, void*, size_t, void*));
+char num_callee(NumCompiler *c, Node *node, Code **callee);
+char num_infer(NumCompiler *c, Node *node, char in_call);
+void num_emit(NumCompiler *c, unsigned char op, size_t arg, float num,
+              Code *callee);
+void num_push(NumCompiler *c, size_t n);
+void num_expr(NumCompiler *c, Node *node, char tail);
+int num_compile(LizyLang *lisp, Function *function, Code *code);
+char num_reserve(LizyLang *lisp, size_t size);
+char num_run(LizyLang *lisp, Code *code, float *args, size_t passed,
+             float *result);
+
+#endif
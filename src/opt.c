@@ -0,0 +1,1003 @@
+/* A small interpreter for a lisp like language, targetting embedded systems.
+ * by Mibi88
+ *
+ * This software is licensed under the BSD-3-Clause license:
+ *
+ * Copyright 2024 Mibi88
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* CHANGELOG
+ *
+ * 2026/10/18: Created this file. Constant folding, removal of comments and
+ *             unused pure expressions, simplification of if. Common
+ *             subexpression elimination. Binding of the names to the
+ *             parameters. Inlining. Variables of the loops. Streams.
+ *             Leave the calls of the redefined builtins as they are.
+ */
+
+#include <opt.h>
+
+/* The optimiser rewrites the tree once it is parsed, before it runs. Each
+ * pass can be turned on or off with tl_set_opt. */
+
+char opt_is(LizyLang *lisp, Node *node,
+            int f(void*, void*, size_t, void*)) {
+    Function *function;
+    if(node->var->type != TL_T_CALL || node->var->size != 1) return 0;
+    if(call_find_func(lisp, &node->var->items->call.function, &function)){
+        return 0;
+    }
+    return function->builtin && function->ptr.f == f;
+}
+
+char opt_find_param(Node *params, Var *name, size_t *n) {
+    Node *param;
+    size_t i;
+    if(!params) return 0;
+    for(i=0;i<params->childnum;i++){
+        param = ((Node**)params->childs)[i];
+        if(param->var->type != TL_T_NAME || VAR_LEN(param->var) != 1){
+            continue;
+        }
+        if(VAR_STR_LEN(VAR_GET_ITEM(param->var, 0)) !=
+           VAR_STR_LEN(VAR_GET_ITEM(name, 0))){
+            continue;
+        }
+        if(!memcmp(VAR_STR_DATA(VAR_GET_ITEM(param->var, 0)),
+                   VAR_STR_DATA(VAR_GET_ITEM(name, 0)),
+                   VAR_STR_LEN(VAR_GET_ITEM(name, 0)))){
+            *n = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+char opt_is_param(Node *params, Var *name) {
+    size_t n;
+    return opt_find_param(params, name, &n);
+}
+
+char opt_literal_params(LizyLang *lisp, Node *names) {
+    Node *name;
+    size_t i;
+    if(!opt_is(lisp, names, builtin_params)) return 0;
+    for(i=0;i<names->childnum;i++){
+        name = ((Node**)names->childs)[i];
+        if(name->var->type != TL_T_NAME || VAR_LEN(name->var) != 1){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+char opt_is_const(Node *node) {
+    return node->var->type != TL_T_CALL && node->var->type != TL_T_NAME;
+}
+
+int opt_remove(LizyLang *lisp, Node *parent, size_t idx) {
+    Node **childs = parent->childs;
+    size_t i;
+    node_free_childs(&lisp->alloc, childs[idx], lisp_free_nodes, lisp);
+    memmove(childs+idx, childs+idx+1,
+            (parent->childnum-idx-1)*sizeof(Node*));
+    parent->childnum--;
+    for(i=idx;i<parent->childnum;i++) childs[i]->idx = i;
+    return TL_SUCCESS;
+}
+
+int opt_replace(LizyLang *lisp, Node *node, size_t idx) {
+    Node *child = ((Node**)node->childs)[idx];
+    Node *parent = node->parent;
+    size_t line = node->line;
+    size_t pos = node->idx;
+    size_t i;
+    /* The child takes the place of node. */
+    ((Node**)node->childs)[idx] = ((Node**)node->childs)[node->childnum-1];
+    node->childnum--;
+    node_free_childs(&lisp->alloc, node, lisp_free_nodes, lisp);
+    ((Node**)parent->childs)[pos] = child;
+    child->parent = parent;
+    child->idx = pos;
+    child->line = line;
+    for(i=0;i<child->childnum;i++){
+        ((Node**)child->childs)[i]->parent = child;
+    }
+    return TL_SUCCESS;
+}
+
+/* Marks the variables that a call of a function that gives a name to its
+ * first argument may define, in lisp->opt_redefined. */
+void opt_redefines(LizyLang *lisp) {
+    Node *node;
+    Var *var;
+    size_t i;
+    for(node=&lisp->node;node;node=node_next(&lisp->node, node)){
+        if(node == &lisp->node || !node->childnum ||
+           (!opt_is(lisp, node, builtin_fncdef) &&
+            !opt_is(lisp, node, builtin_set) &&
+            !opt_is(lisp, node, builtin_del) &&
+            !opt_is(lisp, node, builtin_strdef) &&
+            !opt_is(lisp, node, builtin_numdef))){
+            continue;
+        }
+        var = ((Node**)node->childs)[0]->var;
+        if(var->type == TL_T_CALL){
+            /* The name may be computed. */
+            memset(lisp->opt_redefined, 1, lisp->var_num);
+            return;
+        }
+        if((var->type != TL_T_NAME && var->type != TL_T_STR) ||
+           VAR_LEN(var) != 1){
+            continue;
+        }
+        for(i=0;i<lisp->var_num;i++){
+            if(lisp->var_names[i].len == VAR_STR_LEN(VAR_GET_ITEM(var, 0)) &&
+               !memcmp(VAR_RAW_STR_DATA(lisp->var_names+i),
+                       VAR_STR_DATA(VAR_GET_ITEM(var, 0)),
+                       lisp->var_names[i].len)){
+                lisp->opt_redefined[i] = 1;
+            }
+        }
+    }
+}
+
+/* If node calls a builtin function that the program may redefine, so that
+ * what it does is not known before it runs. */
+char opt_redefined(LizyLang *lisp, Node *node) {
+    String *name;
+    size_t i;
+    if(node->var->type != TL_T_CALL || node->var->size != 1) return 1;
+    name = &node->var->items->call.function;
+    for(i=0;i<lisp->var_num;i++){
+        if(lisp->var_names[i].len == name->len &&
+           !memcmp(VAR_RAW_STR_DATA(lisp->var_names+i),
+                   VAR_RAW_STR_DATA(name), name->len)){
+            return !lisp->opt_redefined || lisp->opt_redefined[i];
+        }
+    }
+    return 1;
+}
+
+int opt_fold(LizyLang *lisp, Node *node) {
+    Function *function;
+    Var value;
+    Var copy;
+    Var *constant;
+    size_t i, old_ctx;
+    int rc;
+    if(call_find_func(lisp, &node->var->items->call.function, &function)){
+        return TL_SUCCESS;
+    }
+    if(!function->builtin || !function->pure ||
+       opt_redefined(lisp, node)){
+        return TL_SUCCESS;
+    }
+    for(i=0;i<node->childnum;i++){
+        if(!opt_is_const(((Node**)node->childs)[i])) return TL_SUCCESS;
+    }
+    old_ctx = lisp->context;
+    lisp->context = 0;
+    rc = call_exec(lisp, node, &value);
+    lisp->context = old_ctx;
+    /* Errors are reported when the call runs. */
+    if(rc) return TL_SUCCESS;
+    if(value.type == TL_T_NAME){
+        /* A name would be looked up instead of being used as is. */
+        var_free(&lisp->alloc, &value);
+        return TL_SUCCESS;
+    }
+    if(value.ref){
+        rc = var_copy(&lisp->alloc, &value, &copy);
+        var_free(&lisp->alloc, &value);
+        if(rc) return rc;
+        value = copy;
+    }
+    rc = tl_add_const(lisp, &value, &constant);
+    if(rc) return rc;
+    for(i=0;i<node->childnum;i++){
+        node_free_childs(&lisp->alloc, ((Node**)node->childs)[i],
+                         lisp_free_nodes, lisp);
+    }
+    TL_FREE(&lisp->alloc, node->childs);
+    node->childs = NULL;
+    node->childnum = 0;
+    var_free(&lisp->alloc, node->var);
+    TL_FREE(&lisp->alloc, node->var);
+    node->var = constant;
+    node->constant = 1;
+    return TL_SUCCESS;
+}
+
+int opt_if(LizyLang *lisp, Node *node, Node *parent, char statement) {
+    Node *condition;
+    Node *branch;
+    Function *function;
+    size_t idx;
+    if(!opt_is(lisp, node, builtin_if) || node->childnum != 3 ||
+       opt_redefined(lisp, node)){
+        return TL_SUCCESS;
+    }
+    condition = ((Node**)node->childs)[0];
+    if(!condition->constant || condition->var->type != TL_T_NUM ||
+       VAR_LEN(condition->var) != 1){
+        return TL_SUCCESS;
+    }
+    idx = VAR_NUM_AT(condition->var, 0) != 0 ? 1 : 2;
+    branch = ((Node**)node->childs)[idx];
+    if(branch->var->type != TL_T_CALL){
+        /* Body nodes have to be calls. */
+        if(statement) return TL_SUCCESS;
+        /* The branch is looked up if if is replaced by a name, so the
+         * function it is passed to has to look it up too. */
+        if(branch->var->type == TL_T_NAME &&
+           (call_find_func(lisp, &parent->var->items->call.function,
+                           &function) ||
+            (function->builtin && function->parseargs != TL_ARGS_ALL))){
+            return TL_SUCCESS;
+        }
+    }
+    return opt_replace(lisp, node, idx);
+}
+
+char opt_same(Node *a, Node *b) {
+    size_t i;
+    if(a->var->type != b->var->type || a->childnum != b->childnum) return 0;
+    if(a->var->type == TL_T_CALL){
+        if(a->var->size != 1 || b->var->size != 1) return 0;
+        if(a->var->items->call.function.len !=
+           b->var->items->call.function.len){
+            return 0;
+        }
+        if(memcmp(VAR_RAW_STR_DATA(&a->var->items->call.function),
+                  VAR_RAW_STR_DATA(&b->var->items->call.function),
+                  a->var->items->call.function.len)){
+            return 0;
+        }
+    }else if(!var_same(a->var, b->var)){
+        return 0;
+    }
+    for(i=0;i<a->childnum;i++){
+        if(!opt_same(((Node**)a->childs)[i], ((Node**)b->childs)[i])){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+size_t opt_size(Node *node) {
+    size_t i;
+    size_t size = 1;
+    for(i=0;i<node->childnum;i++){
+        size += opt_size(((Node**)node->childs)[i]);
+    }
+    return size;
+}
+
+char opt_looks_up(LizyLang *lisp, Node *parent, size_t idx) {
+    Function *function;
+    /* A call can only be replaced by a name where the name is looked up. */
+    if(call_find_func(lisp, &parent->var->items->call.function, &function) ||
+       !function->builtin){
+        return 1;
+    }
+    if(function->parseargs == TL_ARGS_ALL) return 1;
+    if(function->ptr.f == builtin_if || function->ptr.f == builtin_while ||
+       function->ptr.f == builtin_repeat){
+        return 1;
+    }
+    if(function->ptr.f == builtin_callif) return idx != 1;
+    if(function->ptr.f == builtin_for) return idx != 0;
+    if(function->ptr.f == builtin_iterate ||
+       function->ptr.f == builtin_stream_map ||
+       function->ptr.f == builtin_stream_filter ||
+       function->ptr.f == builtin_map || function->ptr.f == builtin_filter ||
+       function->ptr.f == builtin_reduce){
+        /* The function is given by its name. */
+        return idx != 0;
+    }
+    if(function->ptr.f == builtin_take || function->ptr.f == builtin_drop){
+        return 1;
+    }
+    return idx == 1 && (function->ptr.f == builtin_set ||
+                        function->ptr.f == builtin_strdef ||
+                        function->ptr.f == builtin_numdef);
+}
+
+char opt_barrier(LizyLang *lisp, Node *node) {
+    Function *function;
+    size_t i;
+    if(node->var->type != TL_T_CALL) return 0;
+    /* User defined functions may change any global. */
+    if(node->var->size != 1 ||
+       call_find_func(lisp, &node->var->items->call.function, &function) ||
+       !function->builtin || function->ptr.f == builtin_callif ||
+       function->ptr.f == builtin_take || function->ptr.f == builtin_map ||
+       function->ptr.f == builtin_filter ||
+       function->ptr.f == builtin_reduce ||
+       function->ptr.f == builtin_fncdef){
+        return 1;
+    }
+    for(i=0;i<node->childnum;i++){
+        if(opt_barrier(lisp, ((Node**)node->childs)[i])) return 1;
+    }
+    return 0;
+}
+
+int opt_assigned(LizyLang *lisp, OptCse *cse, Node *node) {
+    Node *name;
+    Var **assigned;
+    size_t i;
+    int rc;
+    if(node->var->type != TL_T_CALL) return TL_SUCCESS;
+    if((opt_is(lisp, node, builtin_set) || opt_is(lisp, node, builtin_del) ||
+        opt_is(lisp, node, builtin_strdef) ||
+        opt_is(lisp, node, builtin_numdef) ||
+        opt_is(lisp, node, builtin_for)) && node->childnum){
+        name = ((Node**)node->childs)[0];
+        assigned = TL_REALLOC(&lisp->alloc, cse->assigned,
+                              (cse->assigned_num+1)*sizeof(Var*));
+        if(!assigned) return TL_ERR_OUT_OF_MEM;
+        cse->assigned = assigned;
+        cse->assigned[cse->assigned_num++] = name->var;
+    }
+    for(i=0;i<node->childnum;i++){
+        rc = opt_assigned(lisp, cse, ((Node**)node->childs)[i]);
+        if(rc) return rc;
+    }
+    return TL_SUCCESS;
+}
+
+/* Sets flags to -1 if the node cannot be shared, or to a combination of 1 if
+ * it uses names and 2 if some of them are global. */
+int opt_collect(LizyLang *lisp, OptCse *cse, Node *node, size_t segment,
+                char barrier, int *flags) {
+    Function *function;
+    OptExpr *exprs;
+    Node *child;
+    size_t i;
+    int child_flags;
+    int rc;
+    *flags = 0;
+    if(node->var->type == TL_T_NAME){
+        *flags = 1;
+        if(VAR_LEN(node->var) != 1) *flags = -1;
+        /* The variables of the loops are assigned too. */
+        for(i=0;i<cse->assigned_num && *flags > 0;i++){
+            if(var_same(cse->assigned[i], node->var)) *flags = -1;
+        }
+        if(*flags > 0 && !opt_is_param(cse->names, node->var)) *flags = 3;
+        return TL_SUCCESS;
+    }
+    if(node->var->type != TL_T_CALL) return TL_SUCCESS;
+    /* Other functions are optimised on their own. */
+    if(opt_is(lisp, node, builtin_fncdef)){
+        *flags = -1;
+        return TL_SUCCESS;
+    }
+    if(node->var->size != 1 ||
+       call_find_func(lisp, &node->var->items->call.function, &function) ||
+       !function->builtin || !function->pure ||
+       function->ptr.f == builtin_params ||
+       function->ptr.f == builtin_comment || opt_redefined(lisp, node)){
+        *flags = -1;
+    }
+    for(i=0;i<node->childnum;i++){
+        child = ((Node**)node->childs)[i];
+        rc = opt_collect(lisp, cse, child, segment, barrier, &child_flags);
+        if(rc) return rc;
+        if(child_flags < 0){
+            *flags = -1;
+            continue;
+        }
+        if(child->var->type == TL_T_CALL && child_flags & 1 &&
+           !(child_flags & 2 && barrier) && opt_looks_up(lisp, node, i)){
+            exprs = TL_REALLOC(&lisp->alloc, cse->exprs,
+                               (cse->num+1)*sizeof(OptExpr));
+            if(!exprs) return TL_ERR_OUT_OF_MEM;
+            cse->exprs = exprs;
+            exprs[cse->num].node = child;
+            exprs[cse->num].size = opt_size(child);
+            exprs[cse->num].segment = segment;
+            exprs[cse->num].global = (child_flags & 2) != 0;
+            exprs[cse->num].dead = 0;
+            cse->num++;
+        }
+        if(*flags >= 0) *flags |= child_flags;
+    }
+    return TL_SUCCESS;
+}
+
+int opt_name(LizyLang *lisp, Var *name, Node *at, Node **node) {
+    *node = TL_MALLOC(&lisp->alloc, sizeof(Node));
+    if(!*node) return TL_ERR_OUT_OF_MEM;
+    node_init(*node, name);
+    (*node)->constant = 1;
+    (*node)->line = at->line;
+    return TL_SUCCESS;
+}
+
+int opt_share(LizyLang *lisp, OptCse *cse, size_t n) {
+    OptExpr *expr = cse->exprs+n;
+    Node *parent;
+    Node *node;
+    Node *name_node;
+    Node *up;
+    Var value;
+    Var *name;
+    char buffer[32];
+    size_t i, j, idx;
+    int rc;
+    /* The expression becomes a hidden parameter of the function, and it and
+     * its copies are replaced by its name, that the user cannot write. */
+    sprintf(buffer, " %lu", (unsigned long)cse->names->childnum);
+    rc = var_str(&lisp->alloc, &value, buffer, strlen(buffer));
+    if(rc) return rc;
+    value.type = TL_T_NAME;
+    rc = tl_add_const(lisp, &value, &name);
+    if(rc) return rc;
+    rc = opt_name(lisp, name, cse->names, &name_node);
+    if(rc) return rc;
+    rc = node_add_child(&lisp->alloc, cse->names, name_node);
+    if(rc){
+        TL_FREE(&lisp->alloc, name_node);
+        return rc;
+    }
+    for(i=n;i<cse->num;i++){
+        if(cse->exprs[i].dead || cse->exprs[i].size != expr->size ||
+           (expr->global && cse->exprs[i].segment != expr->segment) ||
+           !opt_same(cse->exprs[i].node, expr->node)){
+            continue;
+        }
+        node = cse->exprs[i].node;
+        parent = node->parent;
+        idx = node->idx;
+        rc = opt_name(lisp, name, node, (Node**)parent->childs+idx);
+        if(rc) return rc;
+        ((Node**)parent->childs)[idx]->parent = parent;
+        ((Node**)parent->childs)[idx]->idx = idx;
+        if(i == n){
+            rc = node_add_child(&lisp->alloc, name_node, node);
+            if(rc){
+                /* Leave the tree as it was. */
+                TL_FREE(&lisp->alloc, ((Node**)parent->childs)[idx]);
+                ((Node**)parent->childs)[idx] = node;
+                cse->names->childnum--;
+                TL_FREE(&lisp->alloc, name_node);
+                return rc;
+            }
+            continue;
+        }
+        /* The expressions in the copy are gone. */
+        for(j=0;j<cse->num;j++){
+            if(cse->exprs[j].dead) continue;
+            for(up=cse->exprs[j].node;up != cse->fncdef;up=up->parent){
+                if(up == node){
+                    cse->exprs[j].dead = 1;
+                    break;
+                }
+            }
+        }
+        node->parent = NULL;
+        node_free_childs(&lisp->alloc, node, lisp_free_nodes, lisp);
+    }
+    expr->dead = 1;
+    return TL_SUCCESS;
+}
+
+int opt_compare_exprs(const void *a, const void *b) {
+    const OptExpr *expr_a = a;
+    const OptExpr *expr_b = b;
+    /* The biggest expressions are shared first, keep the order otherwise. */
+    if(expr_a->size != expr_b->size){
+        return expr_a->size > expr_b->size ? -1 : 1;
+    }
+    return expr_a->node->line < expr_b->node->line ? -1 :
+           expr_a->node->line > expr_b->node->line;
+}
+
+int opt_cse(LizyLang *lisp, Node *fncdef) {
+    OptCse cse;
+    Node *names = ((Node**)fncdef->childs)[1];
+    Node *body;
+    size_t i, j;
+    size_t segment = 0;
+    char barrier;
+    char shared;
+    int flags;
+    int rc = TL_SUCCESS;
+    if(!opt_is(lisp, names, builtin_params)) return TL_SUCCESS;
+    for(i=0;i<names->childnum;i++){
+        if(((Node**)names->childs)[i]->var->type != TL_T_NAME){
+            return TL_SUCCESS;
+        }
+    }
+    cse.exprs = NULL;
+    cse.num = 0;
+    cse.assigned = NULL;
+    cse.assigned_num = 0;
+    cse.names = names;
+    cse.fncdef = fncdef;
+    for(i=2;i<fncdef->childnum && !rc;i++){
+        rc = opt_assigned(lisp, &cse, ((Node**)fncdef->childs)[i]);
+    }
+    for(i=2;i<fncdef->childnum && !rc;i++){
+        body = ((Node**)fncdef->childs)[i];
+        barrier = opt_barrier(lisp, body);
+        if(barrier) segment++;
+        rc = opt_collect(lisp, &cse, body, segment, barrier, &flags);
+        if(barrier) segment++;
+    }
+    if(!rc && cse.num){
+        qsort(cse.exprs, cse.num, sizeof(OptExpr), opt_compare_exprs);
+    }
+    for(i=0;i<cse.num && !rc;i++){
+        if(cse.exprs[i].dead) continue;
+        shared = 0;
+        for(j=i+1;j<cse.num && !shared;j++){
+            shared = !cse.exprs[j].dead &&
+                     cse.exprs[j].size == cse.exprs[i].size &&
+                     (!cse.exprs[i].global ||
+                      cse.exprs[j].segment == cse.exprs[i].segment) &&
+                     opt_same(cse.exprs[j].node, cse.exprs[i].node);
+        }
+        if(shared) rc = opt_share(lisp, &cse, i);
+    }
+    TL_FREE(&lisp->alloc, cse.exprs);
+    TL_FREE(&lisp->alloc, cse.assigned);
+    return rc;
+}
+
+int opt_walk(LizyLang *lisp, Node *node, Node *params) {
+    Node *child;
+    size_t i;
+    int rc;
+    if(opt_is(lisp, node, builtin_fncdef)){
+        if(node->childnum < 3) return TL_SUCCESS;
+        rc = opt_statements(lisp, node, 2, ((Node**)node->childs)[1]);
+        if(rc) return rc;
+        return lisp->opt & TL_OPT_CSE ? opt_cse(lisp, node) : TL_SUCCESS;
+    }
+    for(i=0;i<node->childnum;i++){
+        child = ((Node**)node->childs)[i];
+        if(child->var->type != TL_T_CALL) continue;
+        rc = opt_walk(lisp, child, params);
+        if(rc) return rc;
+        if(lisp->opt & TL_OPT_FOLD){
+            rc = opt_fold(lisp, child);
+            if(rc) return rc;
+        }
+        if(lisp->opt & TL_OPT_IF && child->var->type == TL_T_CALL){
+            rc = opt_if(lisp, child, node, 0);
+            if(rc) return rc;
+        }
+    }
+    return TL_SUCCESS;
+}
+
+int opt_statements(LizyLang *lisp, Node *node, size_t first, Node *params) {
+    Node *child;
+    size_t i = first;
+    char last;
+    int rc;
+    while(i < node->childnum){
+        child = ((Node**)node->childs)[i];
+        /* The last node of a body returns the value of the function. */
+        last = node != &lisp->node && i == node->childnum-1;
+        if(child->var->type == TL_T_CALL){
+            rc = opt_walk(lisp, child, params);
+            if(rc) return rc;
+            if(lisp->opt & TL_OPT_IF){
+                rc = opt_if(lisp, child, node, 1);
+                if(rc) return rc;
+                child = ((Node**)node->childs)[i];
+            }
+        }
+        if(!last && lisp->opt & TL_OPT_COMMENTS &&
+           opt_is(lisp, child, builtin_comment) &&
+           !opt_redefined(lisp, child)){
+            rc = opt_remove(lisp, node, i);
+            if(rc) return rc;
+            continue;
+        }
+        /* Only the statements that can be computed without errors are
+         * removed, so that the errors are still reported. */
+        if(!last && lisp->opt & TL_OPT_DEAD){
+            if(child->var->type == TL_T_CALL){
+                rc = opt_fold(lisp, child);
+                if(rc) return rc;
+            }
+            if(opt_is_const(child)){
+                rc = opt_remove(lisp, node, i);
+                if(rc) return rc;
+                continue;
+            }
+        }
+        i++;
+    }
+    return TL_SUCCESS;
+}
+
+/* Binds the names to the parameters of the function they are in. If known is
+ * zero the parameters are not known before the function is defined. */
+int opt_bind(LizyLang *lisp, Node *node, Node *params, char known) {
+    Node *names;
+    size_t i;
+    if(node->var->type == TL_T_NAME){
+        if(!known || VAR_LEN(node->var) != 1) return TL_SUCCESS;
+        if(opt_find_param(params, node->var, &i)){
+            node->param = TL_PARAM_FIRST+i;
+        }else{
+            node->param = TL_PARAM_NONE;
+        }
+        return TL_SUCCESS;
+    }
+    if(opt_is(lisp, node, builtin_fncdef) && node->childnum >= 2){
+        /* The names in the body refer to the parameters of the function,
+         * if they are listed in the fncdef. */
+        names = ((Node**)node->childs)[1];
+        known = opt_literal_params(lisp, names);
+        for(i=0;i<names->childnum;i++){
+            if(((Node**)names->childs)[i]->childnum){
+                opt_bind(lisp, call_let(names, i), names, known);
+            }
+        }
+        for(i=2;i<node->childnum;i++){
+            opt_bind(lisp, ((Node**)node->childs)[i], names, known);
+        }
+        return TL_SUCCESS;
+    }
+    for(i=0;i<node->childnum;i++){
+        opt_bind(lisp, ((Node**)node->childs)[i], params, known);
+    }
+    return TL_SUCCESS;
+}
+
+/* If a call of a function that gives name to its first argument may
+ * define the name, except the one given. */
+char opt_defines(LizyLang *lisp, Node *node, String *name, Node *except) {
+    Var *var;
+    size_t i;
+    if(node != except && node != &lisp->node && node->childnum &&
+       (opt_is(lisp, node, builtin_fncdef) ||
+        opt_is(lisp, node, builtin_set) || opt_is(lisp, node, builtin_del) ||
+        opt_is(lisp, node, builtin_strdef) ||
+        opt_is(lisp, node, builtin_numdef))){
+        var = ((Node**)node->childs)[0]->var;
+        /* The name may be computed. */
+        if(var->type == TL_T_CALL) return 1;
+        if((var->type == TL_T_NAME || var->type == TL_T_STR) &&
+           VAR_LEN(var) == 1 &&
+           VAR_STR_LEN(VAR_GET_ITEM(var, 0)) == name->len &&
+           !memcmp(VAR_STR_DATA(VAR_GET_ITEM(var, 0)),
+                   VAR_RAW_STR_DATA(name), name->len)){
+            return 1;
+        }
+    }
+    for(i=0;i<node->childnum;i++){
+        if(opt_defines(lisp, ((Node**)node->childs)[i], name, except)){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+size_t opt_uses(Node *node, Node *names, size_t n) {
+    size_t i, found;
+    size_t uses = 0;
+    if(node->var->type == TL_T_NAME){
+        return VAR_LEN(node->var) == 1 &&
+               opt_find_param(names, node->var, &found) && found == n;
+    }
+    for(i=0;i<node->childnum;i++){
+        uses += opt_uses(((Node**)node->childs)[i], names, n);
+    }
+    return uses;
+}
+
+/* If the body of a function can replace its calls: it only calls the
+ * builtins that are never redefined, and only uses its parameters, where
+ * they are looked up. */
+char opt_inlinable(LizyLang *lisp, Node *node, Node *names) {
+    Function *function;
+    Node *parent = node->parent;
+    size_t i;
+    if(node->var->type == TL_T_NAME){
+        return VAR_LEN(node->var) == 1 && opt_is_param(names, node->var) &&
+               opt_looks_up(lisp, parent, node->idx);
+    }
+    if(node->var->type != TL_T_CALL) return node->constant;
+    if(node->var->size != 1 ||
+       call_find_func(lisp, &node->var->items->call.function, &function) ||
+       !function->builtin || function->ptr.f == builtin_fncdef ||
+       function->ptr.f == builtin_params ||
+       function->ptr.f == builtin_callif ||
+       function->ptr.f == builtin_while ||
+       function->ptr.f == builtin_repeat ||
+       function->ptr.f == builtin_for || opt_redefined(lisp, node)){
+        return 0;
+    }
+    for(i=0;i<node->childnum;i++){
+        if(!opt_inlinable(lisp, ((Node**)node->childs)[i], names)) return 0;
+    }
+    return 1;
+}
+
+int opt_copy(LizyLang *lisp, Node *node, Node **copy) {
+    Node *child;
+    Var *var = node->var;
+    size_t i;
+    int rc;
+    if(!node->constant){
+        var = TL_MALLOC(&lisp->alloc, sizeof(Var));
+        if(!var) return TL_ERR_OUT_OF_MEM;
+        rc = var_call(&lisp->alloc, var,
+                      VAR_RAW_STR_DATA(&node->var->items->call.function),
+                      node->var->items->call.function.len);
+        if(rc){
+            TL_FREE(&lisp->alloc, var);
+            return rc;
+        }
+        var->items->call.has_func = 1;
+    }
+    *copy = TL_MALLOC(&lisp->alloc, sizeof(Node));
+    if(!*copy){
+        if(!node->constant){
+            var_free(&lisp->alloc, var);
+            TL_FREE(&lisp->alloc, var);
+        }
+        return TL_ERR_OUT_OF_MEM;
+    }
+    node_init(*copy, var);
+    (*copy)->constant = node->constant;
+    /* The errors in the inlined body still point to where it was written. */
+    (*copy)->line = node->line;
+    (*copy)->parent = NULL;
+    for(i=0;i<node->childnum;i++){
+        rc = opt_copy(lisp, ((Node**)node->childs)[i], &child);
+        if(rc){
+            node_free_childs(&lisp->alloc, *copy, lisp_free_nodes, lisp);
+            return rc;
+        }
+        rc = node_add_child(&lisp->alloc, *copy, child);
+        if(rc){
+            node_free_childs(&lisp->alloc, child, lisp_free_nodes, lisp);
+            node_free_childs(&lisp->alloc, *copy, lisp_free_nodes, lisp);
+            return rc;
+        }
+    }
+    return TL_SUCCESS;
+}
+
+/* Puts the arguments in place of the parameters of the copy of a body. */
+int opt_substitute(LizyLang *lisp, Node *node, Node *names, Node **args) {
+    Node *child;
+    size_t i, n;
+    for(i=0;i<node->childnum;i++){
+        child = ((Node**)node->childs)[i];
+        if(child->var->type != TL_T_NAME){
+            opt_substitute(lisp, child, names, args);
+            continue;
+        }
+        opt_find_param(names, child->var, &n);
+        node_free_childs(&lisp->alloc, child, lisp_free_nodes, lisp);
+        ((Node**)node->childs)[i] = args[n];
+        args[n]->parent = node;
+        args[n]->idx = i;
+        args[n] = NULL;
+    }
+    return TL_SUCCESS;
+}
+
+int opt_inline_call(LizyLang *lisp, Node *node, Node *fncdef) {
+    Node **args = node->childs;
+    Node *parent = node->parent;
+    Node *copy;
+    size_t idx = node->idx;
+    size_t i;
+    int rc;
+    rc = opt_copy(lisp, ((Node**)fncdef->childs)[2], &copy);
+    if(rc) return rc;
+    opt_substitute(lisp, copy, ((Node**)fncdef->childs)[1], args);
+    /* The arguments that are not used would never be evaluated. */
+    for(i=0;i<node->childnum;i++){
+        if(args[i]) node_free_childs(&lisp->alloc, args[i], lisp_free_nodes,
+                                     lisp);
+    }
+    node->childnum = 0;
+    node_free_childs(&lisp->alloc, node, lisp_free_nodes, lisp);
+    ((Node**)parent->childs)[idx] = copy;
+    copy->parent = parent;
+    copy->idx = idx;
+    return TL_SUCCESS;
+}
+
+int opt_inline_calls(LizyLang *lisp, Node *node, Node *fncdef,
+                     String *name) {
+    Node *parent = node->parent;
+    size_t i;
+    int rc;
+    for(i=0;i<node->childnum;i++){
+        rc = opt_inline_calls(lisp, ((Node**)node->childs)[i], fncdef, name);
+        if(rc) return rc;
+    }
+    if(node->var->type != TL_T_CALL || node->var->size != 1 ||
+       node->var->items->call.function.len != name->len ||
+       memcmp(VAR_RAW_STR_DATA(&node->var->items->call.function),
+              VAR_RAW_STR_DATA(name), name->len) ||
+       node->childnum != ((Node**)fncdef->childs)[1]->childnum){
+        return TL_SUCCESS;
+    }
+    /* The call must be evaluated where it is. */
+    if(parent == &lisp->node ||
+       (opt_is(lisp, parent, builtin_fncdef) && node->idx >= 2) ||
+       (parent->var->type == TL_T_CALL &&
+        !opt_is(lisp, parent, builtin_fncdef) &&
+        opt_looks_up(lisp, parent, node->idx))){
+        return opt_inline_call(lisp, node, fncdef);
+    }
+    return TL_SUCCESS;
+}
+
+/* The calls of a small function are replaced by its body if the arguments
+ * are evaluated the same way: each parameter is used at most once, so that
+ * no argument is evaluated twice, and the function only calls builtins, so
+ * that it does not recurse. Only the calls that come after the function is
+ * defined are replaced, and the function must never be redefined. */
+int opt_inline(LizyLang *lisp) {
+    Node **statements = lisp->node.childs;
+    Node *node;
+    Node *names;
+    Node *body;
+    Var *name;
+    Function *function;
+    size_t i, j;
+    int rc;
+    for(i=0;i<lisp->node.childnum;i++){
+        node = statements[i];
+        if(!opt_is(lisp, node, builtin_fncdef) || node->childnum != 3){
+            continue;
+        }
+        name = ((Node**)node->childs)[0]->var;
+        names = ((Node**)node->childs)[1];
+        body = ((Node**)node->childs)[2];
+        if((name->type != TL_T_NAME && name->type != TL_T_STR) ||
+           VAR_LEN(name) != 1 || !opt_literal_params(lisp, names) ||
+           body->var->type != TL_T_CALL || opt_size(body) > TL_INLINE_MAX ||
+           !call_find_func(lisp, &VAR_GET_ITEM(name, 0).string, &function) ||
+           opt_defines(lisp, &lisp->node, &VAR_GET_ITEM(name, 0).string,
+                       node) ||
+           !opt_inlinable(lisp, body, names)){
+            continue;
+        }
+        for(j=0;j<names->childnum;j++){
+            if(((Node**)names->childs)[j]->childnum ||
+               opt_uses(body, names, j) > 1){
+                break;
+            }
+        }
+        if(j < names->childnum) continue;
+        for(j=i+1;j<lisp->node.childnum;j++){
+            rc = opt_inline_calls(lisp, statements[j], node,
+                                  &VAR_GET_ITEM(name, 0).string);
+            if(rc) return rc;
+        }
+    }
+    return TL_SUCCESS;
+}
+
+int opt_declare(LizyLang *lisp, Node *names, Node *name) {
+    Node *let;
+    Node *init;
+    Var value;
+    Var *var;
+    int rc;
+    rc = var_copy(&lisp->alloc, name->var, &value);
+    if(rc) return rc;
+    rc = tl_add_const(lisp, &value, &var);
+    if(rc) return rc;
+    rc = opt_name(lisp, var, name, &let);
+    if(rc) return rc;
+    rc = var_num_from_float(&lisp->alloc, &value, 0);
+    if(!rc) rc = tl_add_const(lisp, &value, &var);
+    if(!rc) rc = opt_name(lisp, var, name, &init);
+    if(rc){
+        TL_FREE(&lisp->alloc, let);
+        return rc;
+    }
+    rc = node_add_child(&lisp->alloc, let, init);
+    if(rc){
+        TL_FREE(&lisp->alloc, init);
+        TL_FREE(&lisp->alloc, let);
+        return rc;
+    }
+    rc = node_add_child(&lisp->alloc, names, let);
+    if(rc) node_free_childs(&lisp->alloc, let, lisp_free_nodes, lisp);
+    return rc;
+}
+
+/* The variable of a for in a function becomes a hidden parameter of it, that
+ * starts at 0, so that it is a slot of its frame. This is done whatever the
+ * passes enabled, as it changes what the names refer to. */
+int opt_loops(LizyLang *lisp) {
+    Node *node;
+    Node *fncdef;
+    Node *names;
+    Node *name;
+    size_t n;
+    int rc;
+    for(node=&lisp->node;node;node=node_next(&lisp->node, node)){
+        if(node == &lisp->node || !node->childnum ||
+           !opt_is(lisp, node, builtin_for)){
+            continue;
+        }
+        name = ((Node**)node->childs)[0];
+        if(name->var->type != TL_T_NAME || VAR_LEN(name->var) != 1) continue;
+        /* It belongs to the function it is directly in. */
+        for(fncdef=node->parent;fncdef!=&lisp->node;fncdef=fncdef->parent){
+            if(opt_is(lisp, fncdef, builtin_fncdef) && fncdef->childnum >= 2){
+                break;
+            }
+        }
+        if(fncdef == &lisp->node) continue;
+        names = ((Node**)fncdef->childs)[1];
+        if(!opt_literal_params(lisp, names) ||
+           opt_find_param(names, name->var, &n)){
+            continue;
+        }
+        rc = opt_declare(lisp, names, name);
+        if(rc) return rc;
+    }
+    return TL_SUCCESS;
+}
+
+int opt_run(LizyLang *lisp) {
+    size_t i;
+    int rc;
+    rc = opt_loops(lisp);
+    if(rc || !lisp->opt) return rc;
+    /* The passes only rely on what the builtin functions do if they are
+     * never redefined. */
+    lisp->opt_redefined = TL_MALLOC(&lisp->alloc,
+                                    lisp->var_num ? lisp->var_num : 1);
+    if(!lisp->opt_redefined) return TL_ERR_OUT_OF_MEM;
+    memset(lisp->opt_redefined, 0, lisp->var_num);
+    opt_redefines(lisp);
+    rc = TL_SUCCESS;
+    if(lisp->opt & TL_OPT_INLINE) rc = opt_inline(lisp);
+    if(!rc) rc = opt_statements(lisp, &lisp->node, 0, NULL);
+    TL_FREE(&lisp->alloc, lisp->opt_redefined);
+    lisp->opt_redefined = NULL;
+    if(rc || !(lisp->opt & TL_OPT_BIND)) return rc;
+    for(i=0;i<lisp->node.childnum;i++){
+        opt_bind(lisp, ((Node**)lisp->node.childs)[i], NULL, 1);
+    }
+    return TL_SUCCESS;
+}
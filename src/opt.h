@@ -0,0 +1,114 @@
+/* A small interpreter for a lisp like language, targetting embedded systems.
+ * by Mibi88
+ *
+ * This software is licensed under the BSD-3-Clause license:
+ *
+ * Copyright 2024 Mibi88
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* CHANGELOG
+ *
+ * 2026/10/18: Created this file. Constant folding, removal of comments and
+ *             unused pure expressions, simplification of if. Common
+ *             subexpression elimination. Binding of the names to the
+ *             parameters. Inlining. Variables of the loops. Leave the
+ *             calls of the redefined builtins as they are.
+ */
+
+#ifndef OPT_H
+#define OPT_H
+
+#include <lisp.h>
+#include <call.h>
+#include <builtin.h>
+#include <tree.h>
+
+/* An expression that could be computed once per frame. */
+typedef struct {
+    Node *node;
+    size_t size;
+    /* Expressions that use global names can only be shared with the ones
+     * of the same segment of the body: the segments are separated by the
+     * calls that may change the globals. */
+    size_t segment;
+    char global;
+    char dead;
+} OptExpr;
+
+typedef struct {
+    OptExpr *exprs;
+    size_t num;
+    /* The global names assigned in the body. */
+    Var **assigned;
+    size_t assigned_num;
+    Node *names;
+    Node *fncdef;
+} OptCse;
+
+char opt_is(LizyLang *lisp, Node *node,
+            int f(void*, void*, size_t, void*));
+char opt_find_param(Node *params, Var *name, size_t *n);
+char opt_is_param(Node *params, Var *name);
+char opt_literal_params(LizyLang *lisp, Node *names);
+char opt_is_const(Node *node);
+int opt_remove(LizyLang *lisp, Node *parent, size_t idx);
+int opt_replace(LizyLang *lisp, Node *node, size_t idx);
+void opt_redefines(LizyLang *lisp);
+char opt_redefined(LizyLang *lisp, Node *node);
+int opt_fold(LizyLang *lisp, Node *node);
+int opt_if(LizyLang *lisp, Node *node, Node *parent, char statement);
+char opt_same(Node *a, Node *b);
+size_t opt_size(Node *node);
+char opt_looks_up(LizyLang *lisp, Node *parent, size_t idx);
+char opt_barrier(LizyLang *lisp, Node *node);
+int opt_assigned(LizyLang *lisp, OptCse *cse, Node *node);
+int opt_collect(LizyLang *lisp, OptCse *cse, Node *node, size_t segment,
+                char barrier, int *flags);
+int opt_name(LizyLang *lisp, Var *name, Node *at, Node **node);
+int opt_share(LizyLang *lisp, OptCse *cse, size_t n);
+int opt_compare_exprs(const void *a, const void *b);
+int opt_cse(LizyLang *lisp, Node *fncdef);
+int opt_walk(LizyLang *lisp, Node *node, Node *params);
+int opt_statements(LizyLang *lisp, Node *node, size_t first, Node *params);
+int opt_bind(LizyLang *lisp, Node *node, Node *params, char known);
+char opt_defines(LizyLang *lisp, Node *node, String *name, Node *except);
+size_t opt_uses(Node *node, Node *names, size_t n);
+char opt_inlinable(LizyLang *lisp, Node *node, Node *names);
+int opt_copy(LizyLang *lisp, Node *node, Node **copy);
+int opt_substitute(LizyLang *lisp, Node *node, Node *names, Node **args);
+int opt_inline_call(LizyLang *lisp, Node *node, Node *fncdef);
+int opt_inline_calls(LizyLang *lisp, Node *node, Node *fncdef,
+                     String *name);
+int opt_inline(LizyLang *lisp);
+int opt_declare(LizyLang *lisp, Node *names, Node *name);
+int opt_loops(LizyLang *lisp);
+int opt_run(LizyLang *lisp);
+
+#endif
@@ -35,6 +35,45 @@
 /* CHANGELOG
  *
  * 2024/09/28: Started developement.
+ * 2026/10/18: Default allocator. Executable memory for the JIT.
  */
 
+/* For MAP_ANONYMOUS. */
+#define _DEFAULT_SOURCE
+
 #include <platform.h>
+
+#if TL_JIT
+#include <sys/mman.h>
+#endif
+
+void *platform_alloc(void *ctx, size_t size) {
+    (void)ctx;
+    return malloc(size);
+}
+
+void *platform_realloc(void *ctx, void *ptr, size_t new_size) {
+    (void)ctx;
+    return realloc(ptr, new_size);
+}
+
+void platform_free(void *ctx, void *ptr) {
+    (void)ctx;
+    free(ptr);
+}
+
+#if TL_JIT
+void *platform_code_alloc(size_t size) {
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+int platform_code_exec(void *ptr, size_t size) {
+    return mprotect(ptr, size, PROT_READ | PROT_EXEC);
+}
+
+void platform_code_free(void *ptr, size_t size) {
+    munmap(ptr, size);
+}
+#endif
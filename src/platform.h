@@ -40,6 +40,8 @@
  * 2024/10/04: Debug function searching.
  * 2024/10/15: Debug the tree generation.
  * 2024/10/21: Debug the context.
+ * 2026/10/18: Default allocator. Debug the memory usage. Executable memory
+ *             for the JIT.
  */
 
 #ifndef PLATFORM_H
@@ -53,12 +55,40 @@
 
 /*
  * This header should provide:
- * void *malloc(size_t size);
- * void *realloc(void *ptr, size_t new_size);
- * void free(void *ptr);
  * void *memcpy(void *dest, void *src, size_t size);
+ *
+ * And the default allocator, used when no allocator is passed to tl_init:
+ * void *platform_alloc(void *ctx, size_t size);
+ * void *platform_realloc(void *ctx, void *ptr, size_t new_size);
+ * void platform_free(void *ctx, void *ptr);
+ *
+ * If TL_JIT is 1, the memory the machine code of the JIT is written to:
+ * void *platform_code_alloc(size_t size);
+ * int platform_code_exec(void *ptr, size_t size);
+ * void platform_code_free(void *ptr, size_t size);
+ * platform_code_exec makes it executable once it is written, and returns 0
+ * on success.
  */
 
+/* The JIT compiles the hot numeric functions to x86-64 machine code. */
+#ifndef TL_JIT
+#if defined(__x86_64__) && defined(__linux__)
+#define TL_JIT 1
+#else
+#define TL_JIT 0
+#endif
+#endif
+
+void *platform_alloc(void *ctx, size_t size);
+void *platform_realloc(void *ctx, void *ptr, size_t new_size);
+void platform_free(void *ctx, void *ptr);
+
+#if TL_JIT
+void *platform_code_alloc(size_t size);
+int platform_code_exec(void *ptr, size_t size);
+void platform_code_free(void *ptr, size_t size);
+#endif
+
 #define TL_DEBUG_CHAR     0
 #define TL_DEBUG_ARGSTACK 0
 #define TL_DEBUG_FSTACK   0
@@ -68,6 +98,7 @@
 #define TL_DEBUG_TREE     0
 #define TL_DEBUG_STACK    0
 #define TL_DEBUG_CONTEXT  0
+#define TL_DEBUG_MEM      0
 #define TL_LEAK_CHECK     1
 
 #endif
@@ -0,0 +1,391 @@
+/* A small interpreter for a lisp like language, targetting embedded systems.
+ * by Mibi88
+ *
+ * This software is licensed under the BSD-3-Clause license:
+ *
+ * Copyright 2024 Mibi88
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* CHANGELOG
+ *
+ * 2026/10/18: Created this file. Lazy streams. Streams of the elements of a
+ *             list, fused calls of the list functions.
+ */
+
+#include <stream.h>
+#include <call.h>
+#include <builtin.h>
+
+/* A stream is pulled from by the call that needs its elements, take, which
+ * is run by the evaluator like a loop. When an element needs a user defined
+ * function to be called, the call is pushed with the stream as destination
+ * and take pulls again once it returned: every stream of the chain then
+ * resumes from where it stopped. */
+
+int stream_get(LizyLang *lisp, Var *var, Stream **stream) {
+    Var list;
+    int rc;
+    if(var->type != TL_T_STREAM){
+        /* The elements of a list are given one by one. */
+        rc = var_stream(&lisp->alloc, &list, TL_STREAM_LIST);
+        if(rc){
+            var_free(&lisp->alloc, var);
+            return rc;
+        }
+        *stream = list.items->stream;
+        TL_FREE(&lisp->alloc, list.items);
+        if(var->ref){
+            rc = var_copy(&lisp->alloc, var, &(*stream)->data);
+            var_free(&lisp->alloc, var);
+            if(rc){
+                var_free_stream(&lisp->alloc, *stream);
+                return rc;
+            }
+        }else{
+            (*stream)->data = *var;
+        }
+        (*stream)->has_data = 1;
+        return TL_SUCCESS;
+    }
+    if(VAR_LEN(var) != 1) rc = TL_ERR_INVALID_LIST_SIZE;
+    else if(var->ref || var->base){
+        /* The stream is pulled from, the one it is borrowed from has to
+         * stay where it is. */
+        rc = var_copy_stream(&lisp->alloc, var->items->stream, stream);
+    }else{
+        *stream = var->items->stream;
+        TL_FREE(&lisp->alloc, var->items);
+        var->items = NULL;
+        var->size = 0;
+        return TL_SUCCESS;
+    }
+    var_free(&lisp->alloc, var);
+    return rc;
+}
+
+int stream_func(LizyLang *lisp, Node *node, size_t idx, Stream *stream) {
+    Var *name;
+    int rc;
+    /* Like with callif, the function is given by its name. */
+    rc = call_get_arg_raw(node, idx, &name);
+    if(rc) return rc;
+    if(name->type != TL_T_NAME) return TL_ERR_BAD_TYPE;
+    if(VAR_LEN(name) != 1) return TL_ERR_INVALID_LIST_SIZE;
+    return var_call(&lisp->alloc, &stream->function,
+                    VAR_STR_DATA(VAR_GET_ITEM(name, 0)),
+                    VAR_STR_LEN(VAR_GET_ITEM(name, 0)));
+}
+
+int stream_call(LizyLang *lisp, Stream *stream) {
+    Cont *sink = TL_CONT(lisp, lisp->cont_cur-1);
+    Node *call;
+    Node *arg;
+    /* A fold calls its function with what it accumulated and the element. */
+    size_t argnum = stream->kind == TL_STREAM_FOLD ? 2 : 1;
+    size_t i;
+    int rc;
+    if(!stream->nodes){
+        /* The call node, the nodes of its arguments and its list of
+         * childs. */
+        stream->nodes = TL_MALLOC(&lisp->alloc, (argnum+1)*sizeof(Node)+
+                                                argnum*sizeof(Node*));
+        if(!stream->nodes) return TL_ERR_OUT_OF_MEM;
+        call = stream->nodes;
+        node_init(call, &stream->function);
+        call->childs = call+argnum+1;
+        call->childnum = argnum;
+        call->parent = NULL;
+        call->idx = 0;
+        call->line = ((Node*)sink->node)->line;
+        for(i=0;i<argnum;i++){
+            arg = call+i+1;
+            node_init(arg, i+1 < argnum ? &stream->data : &stream->value);
+            arg->parent = call;
+            arg->idx = i;
+            arg->line = call->line;
+            ((Node**)call->childs)[i] = arg;
+        }
+    }
+    /* The element is not in any frame, so the call is made outside of any
+     * function. */
+    rc = call_push_cont(lisp, stream->nodes, 0, &stream->result,
+                        &stream->has_result, 0);
+    return rc ? rc : TL_PENDING;
+}
+
+int stream_result(LizyLang *lisp, Stream *stream, Var *dest) {
+    int rc;
+    stream->has_result = 0;
+    if(stream->result.type == TL_T_NAME){
+        /* Like an argument, a name that is returned is looked up. */
+        rc = call_parse_arg(lisp, &stream->result, dest, 0);
+        var_free(&lisp->alloc, &stream->result);
+        return rc;
+    }
+    *dest = stream->result;
+    return TL_SUCCESS;
+}
+
+int stream_true(Var *var, char *truth) {
+    if(VAR_LEN(var) != 1) return TL_ERR_INVALID_LIST_SIZE;
+    if(var->type != TL_T_NUM) return TL_ERR_BAD_TYPE;
+    *truth = VAR_NUM_AT(var, 0) != 0;
+    return TL_SUCCESS;
+}
+
+int stream_pull(LizyLang *lisp, Stream *stream, Var *dest, char *end) {
+    Stream *source = stream->source;
+    Var result;
+    Var view;
+    char truth;
+    float num;
+    int rc;
+    switch(stream->kind){
+        case TL_STREAM_RANGE:
+            /* The numbers are computed from the first one, so that they do
+             * not drift and can be skipped. */
+            num = stream->num+stream->count*stream->step;
+            if(stream->bounded && (stream->step < 0 ? num < stream->end :
+                                   num > stream->end)){
+                *end = 1;
+                return TL_SUCCESS;
+            }
+            rc = var_num_from_float(&lisp->alloc, dest, num);
+            if(rc) return rc;
+            stream->count++;
+            return TL_SUCCESS;
+        case TL_STREAM_ITERATE:
+            if(stream->has_result){
+                /* The next element is what the function gave for the last
+                 * one. */
+                var_free(&lisp->alloc, &stream->value);
+                stream->has_value = 0;
+                rc = stream_result(lisp, stream, &stream->value);
+                if(rc) return rc;
+                stream->has_value = 1;
+                stream->ready = 1;
+            }
+            if(stream->ready){
+                stream->ready = 0;
+                return var_copy(&lisp->alloc, &stream->value, dest);
+            }
+            return stream_call(lisp, stream);
+        case TL_STREAM_MAP:
+            if(stream->has_result){
+                var_free(&lisp->alloc, &stream->value);
+                stream->has_value = 0;
+                return stream_result(lisp, stream, dest);
+            }
+            break;
+        case TL_STREAM_FILTER:
+            if(stream->has_result){
+                rc = stream_result(lisp, stream, &result);
+                if(rc) return rc;
+                rc = stream_true(&result, &truth);
+                var_free(&lisp->alloc, &result);
+                if(rc) return rc;
+                if(truth){
+                    *dest = stream->value;
+                    stream->has_value = 0;
+                    return TL_SUCCESS;
+                }
+                var_free(&lisp->alloc, &stream->value);
+                stream->has_value = 0;
+            }
+            break;
+        case TL_STREAM_DROP:
+            if(source->kind == TL_STREAM_RANGE){
+                /* The numbers do not have to be made to be skipped. */
+                source->count += stream->count;
+                stream->count = 0;
+            }
+            for(;stream->count;stream->count--){
+                rc = stream_pull(lisp, source, &result, end);
+                if(rc || *end) return rc;
+                var_free(&lisp->alloc, &result);
+            }
+            return stream_pull(lisp, source, dest, end);
+        case TL_STREAM_LIST:
+            if(stream->count >= VAR_LEN(&stream->data)){
+                *end = 1;
+                return TL_SUCCESS;
+            }
+            /* Only the element is copied. */
+            var_ref(&stream->data, &view);
+            rc = var_slice(&lisp->alloc, &view, stream->count, 1);
+            if(rc) return rc;
+            stream->count++;
+            if(!view.ref){
+                *dest = view;
+                return TL_SUCCESS;
+            }
+            return var_copy(&lisp->alloc, &view, dest);
+        case TL_STREAM_TAKE:
+            if(!stream->count){
+                *end = 1;
+                return TL_SUCCESS;
+            }
+            rc = stream_pull(lisp, source, dest, end);
+            if(!rc && !*end) stream->count--;
+            return rc;
+        case TL_STREAM_FOLD:
+            if(stream->ready){
+                *end = 1;
+                return TL_SUCCESS;
+            }
+            if(stream->has_result){
+                var_free(&lisp->alloc, &stream->data);
+                stream->has_data = 0;
+                rc = stream_result(lisp, stream, &stream->data);
+                if(rc) return rc;
+                stream->has_data = 1;
+                var_free(&lisp->alloc, &stream->value);
+                stream->has_value = 0;
+            }
+            rc = stream_pull(lisp, source, &stream->value, end);
+            if(rc) return rc;
+            if(*end){
+                /* What was accumulated is the only element. */
+                *end = 0;
+                *dest = stream->data;
+                stream->has_data = 0;
+                stream->ready = 1;
+                return TL_SUCCESS;
+            }
+            stream->has_value = 1;
+            return stream_call(lisp, stream);
+        default:
+            return TL_ERR_INTERNAL;
+    }
+    /* The function of a stream-map or a stream-filter is called on the next
+     * element of its source. */
+    rc = stream_pull(lisp, source, &stream->value, end);
+    if(rc || *end) return rc;
+    stream->has_value = 1;
+    return stream_call(lisp, stream);
+}
+
+char stream_fused(LizyLang *lisp, Node *node) {
+    Node *parent = node->parent;
+    Function *function;
+    Var *name;
+    int (*f)(void*, void*, size_t, void*);
+    /* The result of list-map, list-filter or take is only used by a function
+     * that pulls the elements from it: no list has to be made in between. */
+    if(!(lisp->opt & TL_OPT_FUSE) || !parent || !parent->var ||
+       parent->var->type != TL_T_CALL || parent->var->size != 1 ||
+       call_node_func(lisp, parent, &function) || !function->builtin){
+        return 0;
+    }
+    f = function->ptr.f;
+    if(f == builtin_reduce){
+        if(node->idx != 2) return 0;
+    }else if(f != builtin_map && f != builtin_filter && f != builtin_take &&
+             f != builtin_stream_map && f != builtin_stream_filter){
+        return 0;
+    }else if(node->idx != 1){
+        return 0;
+    }
+    if(call_node_func(lisp, node, &function)) return 0;
+    if(function->ptr.f != builtin_map && function->ptr.f != builtin_filter){
+        return 1;
+    }
+    /* The function is then called between the calls of the functions that
+     * use its results, which is only invisible if it has no side effects. */
+    name = ((Node**)node->childs)[0]->var;
+    return name->type == TL_T_NAME && VAR_LEN(name) == 1 &&
+           !call_find_func(lisp, &VAR_GET_ITEM(name, 0).string, &function) &&
+           function->pure;
+}
+
+int stream_take(LizyLang *lisp, Var *stream, size_t count) {
+    Cont *cont = TL_CONT(lisp, lisp->cont_cur-1);
+    Var *list;
+    int rc;
+    if(stream->ref || stream->base){
+        rc = var_copy(&lisp->alloc, stream, &cont->tmp);
+        var_free(&lisp->alloc, stream);
+        if(rc) return rc;
+    }else{
+        cont->tmp = *stream;
+    }
+    cont->tmp_set = 1;
+    if(VAR_LEN(&cont->tmp) != 1) return TL_ERR_INVALID_LIST_SIZE;
+    if(!cont->args){
+        rc = call_cont_args(lisp, cont);
+        if(rc) return rc;
+    }
+    /* The list is made in the first argument, that is not needed anymore,
+     * so that it is freed if an error happens. */
+    list = &cont->args->value;
+    if(cont->args->evaluated) var_free(&lisp->alloc, list);
+    list->null = 0;
+    list->ref = 0;
+    list->storage = TL_S_ITEMS;
+    list->base = NULL;
+    list->size = 0;
+    list->items = NULL;
+    list->type = TL_T_NUM;
+    cont->args->evaluated = 1;
+    /* The continuation of the builtin function pulls the elements. */
+    cont->i = count;
+    cont->state = TL_C_STREAM;
+    return TL_PENDING;
+}
+
+int stream_end(LizyLang *lisp, Cont *cont) {
+    *cont->dest = cont->args->value;
+    cont->args->evaluated = 0;
+    if(cont->done) *cont->done = 1;
+    return call_pop_cont(lisp);
+}
+
+int stream_step(LizyLang *lisp, Cont *cont) {
+    Var *list = &cont->args->value;
+    Var item;
+    char end = 0;
+    int rc;
+    /* Each element goes through the whole chain before the next one is
+     * pulled, only the list being made is kept. */
+    for(;cont->i;cont->i--){
+        rc = stream_pull(lisp, cont->tmp.items->stream, &item, &end);
+        if(rc == TL_PENDING) return TL_SUCCESS;
+        if(rc) return rc;
+        if(end) break;
+        if(!VAR_LEN(list)){
+            *list = item;
+            continue;
+        }
+        rc = var_append(&lisp->alloc, &item, list);
+        var_free(&lisp->alloc, &item);
+        if(rc) return rc;
+    }
+    return stream_end(lisp, cont);
+}
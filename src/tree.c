@@ -36,12 +36,21 @@
  *
  * 2024/10/15: Created this file.
  * 2024/10/19: Adding function definition and calling.
+ * 2026/10/18: Do not free constants. Allocate memory with the given
+ *             allocator. Purity of the calls. Bytecode of the arguments.
+ *             Bound names and calls. Walk a tree without recursing.
  */
 
 #include <tree.h>
 
 int node_init(Node *node, Var *value) {
     node->has_value = 0;
+    node->constant = 0;
+    node->pure = TL_PURE_UNKNOWN;
+    node->code = NULL;
+    node->offset = 0;
+    node->slot = 0;
+    node->param = TL_PARAM_UNKNOWN;
     node->var = value;
     node->childs = NULL;
     node->childnum = 0;
@@ -53,10 +62,11 @@ int node_set_value(Node *node, Var *value) {
     return TL_SUCCESS;
 }
 
-int node_add_child(Node *parent, Node *child) {
+int node_add_child(TlAllocator *alloc, Node *parent, Node *child) {
     Node **childs;
     void *tmp;
-    tmp = realloc(parent->childs, (parent->childnum+1)*sizeof(Node*));
+    tmp = TL_REALLOC(alloc, parent->childs,
+                     (parent->childnum+1)*sizeof(Node*));
     if(!tmp){
         return TL_ERR_OUT_OF_MEM;
     }
@@ -69,15 +79,28 @@ int node_add_child(Node *parent, Node *child) {
     return TL_SUCCESS;
 }
 
-int node_free_childs(Node *parent, void on_node(Node*, void*), void *data) {
+/* The node after node when walking the tree of root, or NULL. It does not
+ * recurse, so that it works on trees of any depth. */
+Node *node_next(Node *root, Node *node) {
+    if(node->childnum) return ((Node**)node->childs)[0];
+    for(;node!=root;node=node->parent){
+        if(node->idx+1 < ((Node*)node->parent)->childnum){
+            return ((Node**)((Node*)node->parent)->childs)[node->idx+1];
+        }
+    }
+    return NULL;
+}
+
+int node_free_childs(TlAllocator *alloc, Node *parent,
+                     void on_node(Node*, void*), void *data) {
     /* TODO: Avoid recursion. */
     size_t i;
     for(i=0;i<parent->childnum;i++){
-        node_free_childs(((Node**)parent->childs)[i], on_node, data);
+        node_free_childs(alloc, ((Node**)parent->childs)[i], on_node, data);
     }
-    free(parent->childs);
+    TL_FREE(alloc, parent->childs);
     parent->childs = NULL;
-    if(parent->var) var_free(parent->var);
+    if(parent->var && !parent->constant) var_free(alloc, parent->var);
     on_node(parent, data);
     return TL_SUCCESS;
 }
@@ -36,6 +36,10 @@
  *
  * 2024/10/15: Created this file.
  * 2024/10/19: Adding function definition and calling.
+ * 2026/10/18: Nodes can hold constants. Allocate memory with the given
+ *             allocator. Remember if a call is pure. Bytecode of the
+ *             arguments. Bind the names and the calls. Walk a tree without
+ *             recursing.
  */
 
 #ifndef TREE_H
@@ -53,10 +57,33 @@ typedef struct {
     size_t childnum;
     size_t line;
     char has_value;
+    /* var is in the constant pool of the interpreter and is not owned by the
+     * node. */
+    char constant;
+    /* If the call has no side effects, TL_PURE_UNKNOWN until it is known. */
+    char pure;
+    /* The bytecode that evaluates the node when it is passed to a user
+     * defined function, and the offset it starts at. */
+    void *code;
+    size_t offset;
+    /* Index of the variable the call found its function at the last time,
+     * checked before it is used again. */
+    size_t slot;
+    /* Parameter the name was bound to by the optimiser. */
+    unsigned short param;
 } Node;
 
+#define TL_PURE_UNKNOWN 2
+
+/* The parameter a name refers to, TL_PARAM_FIRST for the first one. */
+#define TL_PARAM_UNKNOWN 0
+#define TL_PARAM_NONE    1
+#define TL_PARAM_FIRST   2
+
 int node_init(Node *node, Var *value);
-int node_add_child(Node *parent, Node *child);
-int node_free_childs(Node *parent, void on_node(Node*, void*), void *data);
+int node_add_child(TlAllocator *alloc, Node *parent, Node *child);
+Node *node_next(Node *root, Node *node);
+int node_free_childs(TlAllocator *alloc, Node *parent,
+                     void on_node(Node*, void*), void *data);
 
 #endif
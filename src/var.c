@@ -45,123 +45,186 @@
  *             var_call: initialize a Var.
  * 2024/10/18: Fixed builtin function prototype.
  * 2024/10/20: Better name.
+ * 2026/10/18: Store short strings inline. Added references to constant
+ *             values. Packed storage for lists of numbers and strings.
+ *             Allocate memory with the given allocator. Fixed leaks when
+ *             running out of memory. Views of a part of a list, substrings.
+ *             Hidden parameters. Hash of a value. Bytecode of a function.
+ *             Streams. Views that take the storage they borrow.
  */
 
 #include <var.h>
 
-int var_auto(Var *var, char *data, size_t len) {
+int var_auto(TlAllocator *alloc, Var *var, char *data, size_t len) {
+    int rc;
     if(var_isnum(data, len)){
-        var_num(var, data, len);
-        return TL_SUCCESS;
+        return var_num(alloc, var, data, len);
     }else if(var_isname(data, len)){
-        var_str(var, data, len);
+        rc = var_str(alloc, var, data, len);
+        if(rc) return rc;
         var->type = TL_T_NAME;
         return TL_SUCCESS;
     }
     return TL_ERR_UNKNOWN_TYPE;
 }
 
-int var_str(Var *var, char *data, size_t len) {
+int var_str(TlAllocator *alloc, Var *var, char *data, size_t len) {
+    int rc;
     var->type = TL_T_STR;
-    var->items = malloc(sizeof(Item));
+    var->items = TL_MALLOC(alloc, sizeof(Item));
     if(!var->items){
         return TL_ERR_OUT_OF_MEM;
     }
     var->size = 1;
-    var->items->string.data = malloc(len);
-    if(!var->items->string.data){
-        return TL_ERR_OUT_OF_MEM;
-    }
-    var->items->string.len = len;
-    if(!memcpy(var->items->string.data, data, len)){
-        return TL_ERR_CPY;
+    rc = var_raw_str(alloc, &var->items->string, data, len);
+    if(rc){
+        TL_FREE(alloc, var->items);
+        var->items = NULL;
+        var->size = 0;
+        return rc;
     }
     var->null = 0;
+    var->ref = 0;
+    var->storage = TL_S_ITEMS;
+    var->base = NULL;
     return TL_SUCCESS;
 }
 
-int var_str_concat(Var *var, Var *str1, Var *str2) {
+int var_str_concat(TlAllocator *alloc, Var *var, Var *str1, Var *str2) {
+    String *string;
+    int rc;
     var->type = TL_T_STR;
-    var->items = malloc(sizeof(Item));
+    var->items = TL_MALLOC(alloc, sizeof(Item));
     if(!var->items){
         return TL_ERR_OUT_OF_MEM;
     }
     var->size = 1;
-    var->items->string.len = str1->items->string.len+str2->items->string.len;
-    var->items->string.data = malloc(var->items->string.len);
-    if(!var->items->string.data){
-        return TL_ERR_OUT_OF_MEM;
+    string = &var->items->string;
+    rc = var_raw_str_alloc(alloc, string,
+                           str1->items->string.len+ str2->items->string.len);
+    if(rc){
+        TL_FREE(alloc, var->items);
+        var->items = NULL;
+        var->size = 0;
+        return rc;
     }
-    if(!memcpy(var->items->string.data, str1->items->string.data,
+    if(!memcpy(VAR_RAW_STR_DATA(string), VAR_STR_DATA(*str1->items),
                str1->items->string.len)){
         return TL_ERR_CPY;
     }
-    if(!memcpy(var->items->string.data+str1->items->string.len,
-               str2->items->string.data, str2->items->string.len)){
+    if(!memcpy(VAR_RAW_STR_DATA(string)+str1->items->string.len,
+               VAR_STR_DATA(*str2->items), str2->items->string.len)){
         return TL_ERR_CPY;
     }
     var->null = 0;
+    var->ref = 0;
+    var->storage = TL_S_ITEMS;
+    var->base = NULL;
     return TL_SUCCESS;
 }
 
-int var_str_add(Var *var, char *data, size_t len) {
+int var_str_add(TlAllocator *alloc, Var *var, char *data, size_t len) {
+    String *string;
     char *tmp;
+    size_t new_len;
     if(var->type != TL_T_STR) return TL_ERR_BAD_TYPE;
-    tmp = realloc(var->items->string.data, var->items->string.len+len);
-    if(!tmp) return TL_ERR_OUT_OF_MEM;
-    var->items->string.data = tmp;
-    if(!memcpy(var->items->string.data+var->items->string.len, data, len)){
+    string = &var->items->string;
+    new_len = string->len+len;
+    if(new_len > TL_STR_INLINE_SZ){
+        if(VAR_STR_INLINE(string)){
+            /* The string does not fit inline anymore: move it to the heap. */
+            tmp = TL_MALLOC(alloc, new_len);
+            if(!tmp) return TL_ERR_OUT_OF_MEM;
+            if(!memcpy(tmp, string->data.buf, string->len)){
+                TL_FREE(alloc, tmp);
+                return TL_ERR_CPY;
+            }
+        }else{
+            tmp = TL_REALLOC(alloc, string->data.ptr, new_len);
+            if(!tmp) return TL_ERR_OUT_OF_MEM;
+        }
+        string->data.ptr = tmp;
+    }
+    tmp = new_len > TL_STR_INLINE_SZ ? string->data.ptr : string->data.buf;
+    if(!memcpy(tmp+string->len, data, len)){
         return TL_ERR_CPY;
     }
-    var->items->string.len += len;
+    string->len = new_len;
     return TL_SUCCESS;
 }
 
-int var_raw_str(String *string, char *data, size_t len) {
-    string->data = malloc(len);
-    if(!string->data){
-        return TL_ERR_OUT_OF_MEM;
-    }
+int var_raw_str_alloc(TlAllocator *alloc, String *string, size_t len) {
     string->len = len;
-    if(!memcpy(string->data, data, len)){
+    if(!VAR_STR_INLINE(string)){
+        string->data.ptr = TL_MALLOC(alloc, len);
+        if(!string->data.ptr){
+            string->len = 0;
+            return TL_ERR_OUT_OF_MEM;
+        }
+    }
+    return TL_SUCCESS;
+}
+
+int var_raw_str(TlAllocator *alloc, String *string, char *data, size_t len) {
+    int rc;
+    rc = var_raw_str_alloc(alloc, string, len);
+    if(rc) return rc;
+    if(!memcpy(VAR_RAW_STR_DATA(string), data, len)){
         return TL_ERR_CPY;
     }
     return TL_SUCCESS;
 }
 
-int var_builtin_func(Var *var, int f(void*, void*, size_t, void*),
-                     char parse) {
+int var_builtin_func(TlAllocator *alloc, Var *var,
+                     int f(void*, void*, size_t, void*), char parse,
+                     char pure) {
     var->type = TL_T_FUNC;
-    var->items = malloc(sizeof(Item));
+    var->items = TL_MALLOC(alloc, sizeof(Item));
     if(!var->items){
         return TL_ERR_OUT_OF_MEM;
     }
     var->size = 1;
     var->null = 0;
+    var->ref = 0;
+    var->storage = TL_S_ITEMS;
+    var->base = NULL;
     var->items->function.ptr.f = f;
     var->items->function.builtin = 1;
     var->items->function.parseargs = parse;
+    var->items->function.pure = pure;
+    var->items->function.memo = 0;
+    var->items->function.strict = 0;
+    var->items->function.lets = 0;
+    var->items->function.code = NULL;
     return TL_SUCCESS;
 }
 
-int var_user_func(Var *var, void *fncdef, Var *params) {
+int var_user_func(TlAllocator *alloc, Var *var, void *fncdef, Var *params) {
     int rc;
     var->type = TL_T_FUNC;
-    var->items = malloc(sizeof(Item));
+    var->items = TL_MALLOC(alloc, sizeof(Item));
     if(!var->items){
         return TL_ERR_OUT_OF_MEM;
     }
     var->size = 1;
     var->null = 0;
+    var->ref = 0;
+    var->storage = TL_S_ITEMS;
+    var->base = NULL;
     var->items->function.ptr.fncdef = fncdef;
     var->items->function.builtin = 0;
     var->items->function.parseargs = 1;
-    var->items->function.params = malloc(sizeof(Var));
+    var->items->function.pure = 0;
+    var->items->function.memo = 0;
+    var->items->function.strict = 0;
+    var->items->function.lets = 0;
+    var->items->function.code = NULL;
+    var->items->function.params = TL_MALLOC(alloc, sizeof(Var));
     if(!var->items->function.params){
-        free(var->items);
+        TL_FREE(alloc, var->items);
         return TL_ERR_OUT_OF_MEM;
     }
-    rc = var_copy(params, var->items->function.params);
+    rc = var_copy(alloc, params, var->items->function.params);
     if(rc) return rc;
     return TL_SUCCESS;
 }
@@ -188,7 +251,7 @@ char var_isnum(char *data, size_t len) {
     return 1;
 }
 
-int var_num(Var *var, char *data, size_t len) {
+int var_num(TlAllocator *alloc, Var *var, char *data, size_t len) {
     /* TODO: Add support for exponent */
     float sign = 1;
     float d = 0.1;
@@ -196,7 +259,7 @@ int var_num(Var *var, char *data, size_t len) {
     char c;
     size_t i;
     var->type = TL_T_NUM;
-    var->items = malloc(sizeof(Item));
+    var->items = TL_MALLOC(alloc, sizeof(Item));
     if(!var->items){
         return TL_ERR_OUT_OF_MEM;
     }
@@ -220,18 +283,24 @@ int var_num(Var *var, char *data, size_t len) {
     }
     var->items->num = out*sign;
     var->null = 0;
+    var->ref = 0;
+    var->storage = TL_S_ITEMS;
+    var->base = NULL;
     return TL_SUCCESS;
 }
 
-int var_num_from_float(Var *var, float num) {
+int var_num_from_float(TlAllocator *alloc, Var *var, float num) {
     var->type = TL_T_NUM;
-    var->items = malloc(sizeof(Item));
+    var->items = TL_MALLOC(alloc, sizeof(Item));
     if(!var->items){
         return TL_ERR_OUT_OF_MEM;
     }
     var->size = 1;
     var->items->num = num;
     var->null = 0;
+    var->ref = 0;
+    var->storage = TL_S_ITEMS;
+    var->base = NULL;
     return TL_SUCCESS;
 }
 
@@ -243,178 +312,629 @@ char var_isname(char *data, size_t len) {
     return 1;
 }
 
-int var_copy(Var *src, Var *dest) {
+int var_copy(TlAllocator *alloc, Var *src, Var *dest) {
     size_t i;
-    if(!src->size || !src->items){
+    size_t *offsets;
+    int rc;
+    if(!src->size || (!src->items && !VAR_PACKED(src))){
+        dest->type = src->type;
         dest->size = 0;
         dest->items = NULL;
+        dest->packed = NULL;
+        dest->null = 0;
+        dest->ref = 0;
+        dest->storage = TL_S_ITEMS;
+        dest->base = NULL;
+        return TL_SUCCESS;
+    }
+    if(VAR_PACKED(src)){
+        dest->packed = TL_MALLOC(alloc, var_packed_size(src));
+        if(!dest->packed){
+            return TL_ERR_OUT_OF_MEM;
+        }
+        if(src->type == TL_T_NUM){
+            if(!memcpy(dest->packed, src->packed, var_packed_size(src))){
+                TL_FREE(alloc, dest->packed);
+                return TL_ERR_CPY;
+            }
+        }else{
+            /* src may be a view, only copy the strings it contains. */
+            offsets = dest->packed;
+            for(i=0;i<=src->size;i++){
+                offsets[i] = VAR_PACKED_OFFSETS(src)[i]-
+                             VAR_PACKED_OFFSETS(src)[0]+
+                             (src->size+1)*sizeof(size_t);
+            }
+            if(!memcpy((char*)dest->packed+offsets[0], VAR_STR_AT(src, 0),
+                       offsets[src->size]-offsets[0])){
+                TL_FREE(alloc, dest->packed);
+                return TL_ERR_CPY;
+            }
+        }
+        dest->type = src->type;
+        dest->items = NULL;
+        dest->size = src->size;
+        dest->null = 0;
+        dest->ref = 0;
+        dest->storage = TL_S_PACKED;
+        dest->base = NULL;
         return TL_SUCCESS;
     }
     switch(src->type){
         case TL_T_NAME:
             dest->type = TL_T_NAME;
-            dest->items = malloc(src->size*sizeof(Item));
+            dest->items = TL_MALLOC(alloc, src->size*sizeof(Item));
             if(!dest->items){
                 return TL_ERR_OUT_OF_MEM;
             }
             dest->size = src->size;
             for(i=0;i<src->size;i++){
-                dest->items[i].string.data = malloc(src->items[i].string.len);
-                if(!dest->items[i].string.data){
-                    return TL_ERR_OUT_OF_MEM;
-                }
-                dest->items[i].string.len = src->items[i].string.len;
-                if(!memcpy(dest->items[i].string.data,
-                           src->items[i].string.data,
-                           src->items[i].string.len)){
-                    return TL_ERR_CPY;
-                }
+                rc = var_raw_str(alloc, &dest->items[i].string,
+                                 VAR_STR_DATA(src->items[i]),
+                                 src->items[i].string.len);
+                if(rc) return rc;
             }
             dest->null = 0;
+            dest->ref = 0;
+            dest->storage = TL_S_ITEMS;
+            dest->base = NULL;
             break;
         case TL_T_STR:
             dest->type = TL_T_STR;
-            dest->items = malloc(src->size*sizeof(Item));
+            dest->items = TL_MALLOC(alloc, src->size*sizeof(Item));
             if(!dest->items){
                 return TL_ERR_OUT_OF_MEM;
             }
             dest->size = src->size;
             for(i=0;i<src->size;i++){
-                dest->items[i].string.data = malloc(src->items[i].string.len);
-                if(!dest->items[i].string.data){
-                    return TL_ERR_OUT_OF_MEM;
-                }
-                dest->items[i].string.len = src->items[i].string.len;
-                if(!memcpy(dest->items[i].string.data,
-                           src->items[i].string.data,
-                           src->items[i].string.len)){
-                    return TL_ERR_CPY;
-                }
+                rc = var_raw_str(alloc, &dest->items[i].string,
+                                 VAR_STR_DATA(src->items[i]),
+                                 src->items[i].string.len);
+                if(rc) return rc;
             }
             dest->null = 0;
+            dest->ref = 0;
+            dest->storage = TL_S_ITEMS;
+            dest->base = NULL;
             break;
         case TL_T_NUM:
             dest->type = TL_T_NUM;
-            dest->items = malloc(src->size*sizeof(Item));
+            dest->items = TL_MALLOC(alloc, src->size*sizeof(Item));
             if(!dest->items){
                 return TL_ERR_OUT_OF_MEM;
             }
             dest->size = src->size;
             dest->null = 0;
+            dest->ref = 0;
+            dest->storage = TL_S_ITEMS;
+            dest->base = NULL;
             for(i=0;i<src->size;i++){
                 dest->items[i].num = src->items[i].num;
             }
             break;
         case TL_T_FUNC:
             dest->type = TL_T_FUNC;
-            dest->items = malloc(src->size*sizeof(Item));
+            dest->items = TL_MALLOC(alloc, src->size*sizeof(Item));
             if(!dest->items){
                 return TL_ERR_OUT_OF_MEM;
             }
             dest->size = src->size;
             dest->null = 0;
+            dest->ref = 0;
+            dest->storage = TL_S_ITEMS;
+            dest->base = NULL;
             for(i=0;i<src->size;i++){
                 dest->items[i].function = src->items[i].function;
             }
             break;
         case TL_T_CALL:
             dest->type = TL_T_CALL;
-            dest->items = malloc(src->size*sizeof(Item));
+            dest->items = TL_MALLOC(alloc, src->size*sizeof(Item));
             if(!dest->items){
                 return TL_ERR_OUT_OF_MEM;
             }
             dest->size = src->size;
             dest->null = 0;
+            dest->ref = 0;
+            dest->storage = TL_S_ITEMS;
+            dest->base = NULL;
             for(i=0;i<src->size;i++){
                 dest->items[i].call = src->items[i].call;
             }
             break;
+        case TL_T_STREAM:
+            dest->type = TL_T_STREAM;
+            dest->items = TL_MALLOC(alloc, src->size*sizeof(Item));
+            if(!dest->items){
+                return TL_ERR_OUT_OF_MEM;
+            }
+            dest->null = 0;
+            dest->ref = 0;
+            dest->storage = TL_S_ITEMS;
+            dest->base = NULL;
+            for(i=0;i<src->size;i++){
+                rc = var_copy_stream(alloc, src->items[i].stream,
+                                     &dest->items[i].stream);
+                if(rc){
+                    dest->size = i;
+                    var_free(alloc, dest);
+                    return rc;
+                }
+            }
+            dest->size = src->size;
+            break;
         default:
             return TL_ERR_BAD_TYPE;
     }
     return TL_SUCCESS;
 }
 
-int var_call(Var *var, char *name, size_t len) {
+char var_same(Var *a, Var *b) {
+    size_t i;
+    float num_a, num_b;
+    if(a->type != b->type || a->size != b->size) return 0;
+    for(i=0;i<a->size;i++){
+        switch(a->type){
+            case TL_T_NAME:
+                if(a->items[i].string.len != b->items[i].string.len) return 0;
+                if(memcmp(VAR_STR_DATA(a->items[i]), VAR_STR_DATA(b->items[i]),
+                          a->items[i].string.len)){
+                    return 0;
+                }
+                break;
+            case TL_T_STR:
+                if(VAR_STR_LEN_AT(a, i) != VAR_STR_LEN_AT(b, i)) return 0;
+                if(memcmp(VAR_STR_AT(a, i), VAR_STR_AT(b, i),
+                          VAR_STR_LEN_AT(a, i))){
+                    return 0;
+                }
+                break;
+            case TL_T_NUM:
+                /* Compare the representation, so that 0 and -0 are not the
+                 * same. */
+                num_a = VAR_NUM_AT(a, i);
+                num_b = VAR_NUM_AT(b, i);
+                if(memcmp(&num_a, &num_b, sizeof(float))) return 0;
+                break;
+            default:
+                return 0;
+        }
+    }
+    return 1;
+}
+
+unsigned long var_hash(Var *var, unsigned long hash) {
+    size_t i, n;
+    float num;
+    char *data;
+    size_t len;
+    /* FNV-1a of the type, the size and the items, as var_same compares
+     * them. */
+    hash = ((hash^var->type)*16777619UL)&0xFFFFFFFFUL;
+    hash = ((hash^(var->size&0xFF))*16777619UL)&0xFFFFFFFFUL;
+    for(i=0;i<var->size;i++){
+        switch(var->type){
+            case TL_T_NAME:
+                data = VAR_STR_DATA(var->items[i]);
+                len = var->items[i].string.len;
+                break;
+            case TL_T_STR:
+                data = VAR_STR_AT(var, i);
+                len = VAR_STR_LEN_AT(var, i);
+                break;
+            case TL_T_NUM:
+                num = VAR_NUM_AT(var, i);
+                data = (char*)&num;
+                len = sizeof(float);
+                break;
+            default:
+                return hash;
+        }
+        for(n=0;n<len;n++){
+            hash = ((hash^(unsigned char)data[n])*16777619UL)&0xFFFFFFFFUL;
+        }
+    }
+    return hash;
+}
+
+int var_ref(Var *src, Var *dest) {
+    *dest = *src;
+    dest->ref = 1;
+    return TL_SUCCESS;
+}
+
+int var_call(TlAllocator *alloc, Var *var, char *name, size_t len) {
+    int rc;
     var->type = TL_T_CALL;
-    var->items = malloc(sizeof(Item));
+    var->items = TL_MALLOC(alloc, sizeof(Item));
     if(!var->items){
         return TL_ERR_OUT_OF_MEM;
     }
     var->size = 1;
     var->null = 0;
-    var->items->call.function.data = malloc(len);
-    if(!var->items->call.function.data){
+    var->ref = 0;
+    var->storage = TL_S_ITEMS;
+    var->base = NULL;
+    rc = var_raw_str(alloc, &var->items->call.function, name, len);
+    if(rc){
+        TL_FREE(alloc, var->items);
+        var->items = NULL;
+        return rc;
+    }
+    var->items->call.has_func = 0;
+    return TL_SUCCESS;
+}
+
+int var_stream(TlAllocator *alloc, Var *var, unsigned char kind) {
+    Stream *stream;
+    var->type = TL_T_STREAM;
+    var->items = TL_MALLOC(alloc, sizeof(Item));
+    if(!var->items){
         return TL_ERR_OUT_OF_MEM;
     }
-    var->items->call.function.len = len;
-    if(!memcpy(var->items->call.function.data, name, len)){
-        return TL_ERR_CPY;
+    stream = TL_MALLOC(alloc, sizeof(Stream));
+    if(!stream){
+        TL_FREE(alloc, var->items);
+        var->items = NULL;
+        return TL_ERR_OUT_OF_MEM;
     }
-    var->items->call.has_func = 0;
+    var->size = 1;
+    var->null = 0;
+    var->ref = 0;
+    var->storage = TL_S_ITEMS;
+    var->base = NULL;
+    var->items->stream = stream;
+    stream->kind = kind;
+    stream->list = kind == TL_STREAM_LIST;
+    stream->source = NULL;
+    stream->num = 0;
+    stream->step = 1;
+    stream->end = 0;
+    stream->bounded = 0;
+    stream->count = 0;
+    stream->function.type = TL_T_CALL;
+    stream->function.items = NULL;
+    stream->function.size = 0;
+    stream->function.null = 0;
+    stream->function.ref = 0;
+    stream->function.storage = TL_S_ITEMS;
+    stream->function.base = NULL;
+    stream->has_value = 0;
+    stream->has_result = 0;
+    stream->ready = 0;
+    stream->has_data = 0;
+    stream->nodes = NULL;
     return TL_SUCCESS;
 }
 
-int var_free_str(String *string) {
-    free(string->data);
-    string->data = NULL;
+int var_copy_stream(TlAllocator *alloc, Stream *src, Stream **dest) {
+    Stream *stream;
+    String *name;
+    int rc;
+    stream = TL_MALLOC(alloc, sizeof(Stream));
+    if(!stream){
+        return TL_ERR_OUT_OF_MEM;
+    }
+    /* The nodes point into the stream they were made for. */
+    *stream = *src;
+    stream->source = NULL;
+    stream->function.items = NULL;
+    stream->function.size = 0;
+    stream->has_value = 0;
+    stream->has_result = 0;
+    stream->has_data = 0;
+    stream->nodes = NULL;
+    rc = TL_SUCCESS;
+    if(src->function.size){
+        name = &src->function.items->call.function;
+        rc = var_call(alloc, &stream->function, VAR_RAW_STR_DATA(name),
+                      name->len);
+    }
+    if(!rc && src->has_value){
+        rc = var_copy(alloc, &src->value, &stream->value);
+        stream->has_value = !rc;
+    }
+    if(!rc && src->has_result){
+        rc = var_copy(alloc, &src->result, &stream->result);
+        stream->has_result = !rc;
+    }
+    if(!rc && src->has_data){
+        rc = var_copy(alloc, &src->data, &stream->data);
+        stream->has_data = !rc;
+    }
+    if(!rc && src->source){
+        rc = var_copy_stream(alloc, src->source, &stream->source);
+    }
+    if(rc){
+        var_free_stream(alloc, stream);
+        return rc;
+    }
+    *dest = stream;
     return TL_SUCCESS;
 }
 
-int var_free(Var *var) {
+int var_free_str(TlAllocator *alloc, String *string) {
+    if(!VAR_STR_INLINE(string)) TL_FREE(alloc, string->data.ptr);
+    string->data.ptr = NULL;
+    string->len = 0;
+    return TL_SUCCESS;
+}
+
+int var_free_stream(TlAllocator *alloc, Stream *stream) {
+    if(stream->source) var_free_stream(alloc, stream->source);
+    var_free(alloc, &stream->function);
+    if(stream->has_value) var_free(alloc, &stream->value);
+    if(stream->has_result) var_free(alloc, &stream->result);
+    if(stream->has_data) var_free(alloc, &stream->data);
+    if(stream->nodes) TL_FREE(alloc, stream->nodes);
+    TL_FREE(alloc, stream);
+    return TL_SUCCESS;
+}
+
+int var_free_items(TlAllocator *alloc, Var *var, size_t start, size_t end) {
     size_t i;
-    if(!var->items || !var->size) return TL_SUCCESS;
     switch(var->type){
         case TL_T_NAME:
             /* FALLTHRU */
         case TL_T_STR:
-            for(i=0;i<var->size;i++){
-                free(var->items[i].string.data);
-                var->items[i].string.data = NULL;
+            for(i=start;i<end;i++){
+                var_free_str(alloc, &var->items[i].string);
             }
             break;
         case TL_T_NUM:
             break;
         case TL_T_FUNC:
-            for(i=0;i<var->size;i++){
+            for(i=start;i<end;i++){
                 if(!var->items[i].function.builtin){
-                    var_free(var->items[i].function.params);
-                    free(var->items[i].function.params);
+                    var_free(alloc, var->items[i].function.params);
+                    TL_FREE(alloc, var->items[i].function.params);
                     var->items[i].function.params = NULL;
                 }
             }
             break;
         case TL_T_CALL:
-            free(var->items->call.function.data);
-            var->items->call.function.data = NULL;
-            var->items->call.function.len = 0;
+            for(i=start;i<end;i++){
+                var_free_str(alloc, &var->items[i].call.function);
+            }
+            break;
+        case TL_T_STREAM:
+            for(i=start;i<end;i++){
+                var_free_stream(alloc, var->items[i].stream);
+            }
             break;
         default:
             return TL_ERR_UNKNOWN_TYPE;
     }
-    free(var->items);
+    return TL_SUCCESS;
+}
+
+int var_free(TlAllocator *alloc, Var *var) {
+    int rc;
+    if(var->ref){
+        /* The items belong to another Var. */
+        var->items = NULL;
+        var->size = 0;
+        var->packed = NULL;
+        var->ref = 0;
+        var->storage = TL_S_ITEMS;
+        var->base = NULL;
+        return TL_SUCCESS;
+    }
+    if(VAR_PACKED(var)){
+        TL_FREE(alloc, VAR_PACKED_BLOCK(var));
+        var->packed = NULL;
+        var->size = 0;
+        var->storage = TL_S_ITEMS;
+        var->base = NULL;
+        return TL_SUCCESS;
+    }
+    if(!var->items || !var->size) return TL_SUCCESS;
+    rc = var_free_items(alloc, var, 0, var->size);
+    if(rc) return rc;
+    TL_FREE(alloc, var->base ? var->base : var->items);
     var->items = NULL;
+    var->base = NULL;
     var->size = 0;
     return TL_SUCCESS;
 }
 
-int var_append(Var *src, Var *dest) {
+size_t var_packed_size(Var *var) {
+    if(var->type == TL_T_NUM) return var->size*sizeof(float);
+    return (var->size+1)*sizeof(size_t)+VAR_PACKED_OFFSETS(var)[var->size]-
+           VAR_PACKED_OFFSETS(var)[0];
+}
+
+int var_append_packed(TlAllocator *alloc, Var *src, Var *dest) {
+    void *block;
+    size_t size = dest->size+src->size;
+    size_t chars = 0;
+    size_t start = 0;
+    size_t *offsets;
+    char *data;
+    size_t i;
+    if(dest->type == TL_T_NUM){
+        if(VAR_PACKED(dest) && !dest->ref && !dest->base){
+            block = TL_REALLOC(alloc, dest->packed, size*sizeof(float));
+            if(!block) return TL_ERR_OUT_OF_MEM;
+            dest->packed = block;
+            /* The elements of dest are already in place. */
+            start = dest->size;
+        }else{
+            block = TL_MALLOC(alloc, size*sizeof(float));
+            if(!block) return TL_ERR_OUT_OF_MEM;
+        }
+        for(i=start;i<dest->size;i++){
+            ((float*)block)[i] = VAR_NUM_AT(dest, i);
+        }
+        for(i=0;i<src->size;i++){
+            ((float*)block)[dest->size+i] = VAR_NUM_AT(src, i);
+        }
+    }else{
+        for(i=0;i<dest->size;i++) chars += VAR_STR_LEN_AT(dest, i);
+        for(i=0;i<src->size;i++) chars += VAR_STR_LEN_AT(src, i);
+        block = TL_MALLOC(alloc, (size+1)*sizeof(size_t)+chars);
+        if(!block) return TL_ERR_OUT_OF_MEM;
+        offsets = block;
+        data = block;
+        offsets[0] = (size+1)*sizeof(size_t);
+        for(i=0;i<size;i++){
+            if(i < dest->size){
+                if(!memcpy(data+offsets[i], VAR_STR_AT(dest, i),
+                           VAR_STR_LEN_AT(dest, i))){
+                    TL_FREE(alloc, block);
+                    return TL_ERR_CPY;
+                }
+                offsets[i+1] = offsets[i]+VAR_STR_LEN_AT(dest, i);
+            }else{
+                if(!memcpy(data+offsets[i], VAR_STR_AT(src, i-dest->size),
+                           VAR_STR_LEN_AT(src, i-dest->size))){
+                    TL_FREE(alloc, block);
+                    return TL_ERR_CPY;
+                }
+                offsets[i+1] = offsets[i]+VAR_STR_LEN_AT(src, i-dest->size);
+            }
+        }
+    }
+    /* Free the old storage, unless it has been reallocated. */
+    if(!start) var_free(alloc, dest);
+    dest->packed = block;
+    dest->items = NULL;
+    dest->size = size;
+    dest->null = 0;
+    dest->ref = 0;
+    dest->storage = TL_S_PACKED;
+    dest->base = NULL;
+    return TL_SUCCESS;
+}
+
+int var_append(TlAllocator *alloc, Var *src, Var *dest) {
     Item *tmp;
     Var src_copy;
     int rc;
-    rc = var_copy(src, &src_copy);
-    if(rc) return rc;
     if(src->type != dest->type) return TL_ERR_BAD_TYPE;
-    tmp = realloc(dest->items, (dest->size+src->size)*sizeof(Item));
-    if(!tmp) return TL_ERR_OUT_OF_MEM;
+    if((dest->type == TL_T_NUM || dest->type == TL_T_STR) &&
+       dest->size+src->size > 1){
+        return var_append_packed(alloc, src, dest);
+    }
+    if(dest->ref || dest->base){
+        /* Never modify the Var the items are borrowed from, and do not
+         * resize a view. */
+        rc = var_copy(alloc, dest, &src_copy);
+        if(rc) return rc;
+        var_free(alloc, dest);
+        *dest = src_copy;
+    }
+    rc = var_copy(alloc, src, &src_copy);
+    if(rc) return rc;
+    tmp = TL_REALLOC(alloc, dest->items, (dest->size+src->size)*sizeof(Item));
+    if(!tmp){
+        var_free(alloc, &src_copy);
+        return TL_ERR_OUT_OF_MEM;
+    }
     dest->items = tmp;
     if(!memcpy(dest->items+dest->size, src_copy.items,
                src->size*sizeof(Item))){
         return TL_ERR_CPY;
     }
     dest->size += src->size;
-    free(src_copy.items);
+    TL_FREE(alloc, src_copy.items);
     return TL_SUCCESS;
 }
 
-/* TODO: Head and tail. */
+int var_slice(TlAllocator *alloc, Var *var, size_t start, size_t len) {
+    Var item;
+    int rc;
+    if(start > var->size || len > var->size-start) return TL_ERR_OUT_OF_RANGE;
+    if(!len){
+        rc = var_free(alloc, var);
+        var->items = NULL;
+        var->size = 0;
+        return rc;
+    }
+    if(len == 1 && (var->type == TL_T_NUM || var->type == TL_T_STR)){
+        /* Single values are never packed, nor views: a loop updates its
+         * variable in place. */
+        if(var->type == TL_T_NUM){
+            rc = var_num_from_float(alloc, &item, VAR_NUM_AT(var, start));
+        }else{
+            rc = var_str(alloc, &item, VAR_STR_AT(var, start),
+                         VAR_STR_LEN_AT(var, start));
+        }
+        if(rc) return rc;
+        var_free(alloc, var);
+        *var = item;
+        return TL_SUCCESS;
+    }
+    if(!var->ref && !VAR_PACKED(var)){
+        /* The items outside of the view cannot be reached anymore. */
+        var_free_items(alloc, var, 0, start);
+        var_free_items(alloc, var, start+len, var->size);
+    }
+    if(!var->base){
+        var->base = VAR_PACKED(var) ? var->packed : (void*)var->items;
+    }
+    if(!VAR_PACKED(var)) var->items += start;
+    else if(var->type == TL_T_NUM) var->packed = VAR_PACKED_NUMS(var)+start;
+    else var->packed = VAR_PACKED_OFFSETS(var)+start;
+    var->size = len;
+    return TL_SUCCESS;
+}
+
+char var_borrows(Var *var, Var *from) {
+    void *storage;
+    if(!var->ref || !var->base || from->ref || !from->size ||
+       var->storage != from->storage){
+        return 0;
+    }
+    storage = from->base;
+    if(!storage){
+        storage = VAR_PACKED(from) ? from->packed : (void*)from->items;
+    }
+    return var->base == storage;
+}
+
+int var_take(TlAllocator *alloc, Var *var, Var *from) {
+    size_t start;
+    /* from is about to be freed: the view gets its storage instead, without
+     * the items it cannot reach. */
+    if(!VAR_PACKED(from)){
+        start = var->items-from->items;
+        var_free_items(alloc, from, 0, start);
+        var_free_items(alloc, from, start+var->size, from->size);
+    }
+    var->ref = 0;
+    from->items = NULL;
+    from->packed = NULL;
+    from->size = 0;
+    from->storage = TL_S_ITEMS;
+    from->base = NULL;
+    return TL_SUCCESS;
+}
+
+int var_substr(TlAllocator *alloc, Var *var, size_t start, size_t len) {
+    String *string;
+    char buf[TL_STR_INLINE_SZ];
+    char *data;
+    if(var->type != TL_T_STR) return TL_ERR_BAD_TYPE;
+    if(var->size != 1) return TL_ERR_INVALID_LIST_SIZE;
+    string = &var->items->string;
+    if(start > string->len || len > string->len-start){
+        return TL_ERR_OUT_OF_RANGE;
+    }
+    data = VAR_RAW_STR_DATA(string);
+    if(var->ref){
+        /* The string belongs to another Var. */
+        return var_str(alloc, var, data+start, len);
+    }
+    if(VAR_STR_INLINE(string) || len > TL_STR_INLINE_SZ){
+        /* Keep the substring in the storage of the string. */
+        memmove(data, data+start, len);
+    }else{
+        /* The substring is short enough to be stored inline. */
+        memcpy(buf, data+start, len);
+        TL_FREE(alloc, string->data.ptr);
+        memcpy(string->data.buf, buf, len);
+    }
+    string->len = len;
+    return TL_SUCCESS;
+}
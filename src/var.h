@@ -46,6 +46,13 @@
  * 2024/10/16: Removed useless values in structs.
  * 2024/10/18: Fixed builtin function prototype.
  * 2024/10/20: Better name.
+ * 2026/10/18: Store short strings inline. Added references to constant
+ *             values. Packed storage for lists of numbers and strings.
+ *             Allocate memory with the given allocator. Views of a part of
+ *             a list. Pure functions and strict parameters. Hidden
+ *             parameters. Hash of a value, functions that can be memoised.
+ *             Bytecode of a function. Streams. Views that take the storage
+ *             they borrow.
  */
 
 #ifndef VAR_H
@@ -55,7 +62,7 @@
 
 #define VAR_LEN(var) (var)->size
 #define VAR_GET_ITEM(var, i) (var)->items[i]
-#define VAR_STR_DATA(item) (item).string.data
+#define VAR_STR_DATA(item) VAR_RAW_STR_DATA(&(item).string)
 #define VAR_STR_LEN(item) (item).string.len
 #define VAR_NUM(item) (item).num
 #define VAR_BUILTIN_FUNC(item) (item).function.ptr.f
@@ -63,16 +70,52 @@
 #define VAR_PARSEARGS(item) (item).function.parseargs
 #define VAR_USER_FUNC(item) (item).function.ptr.start
 
+/* Lists of numbers and strings with more than one element may be packed:
+ * numbers are then stored in a float array, and strings in a single block
+ * containing size+1 offsets followed by the characters of all the strings.
+ * The offsets are counted from the start of the block, so that a view of the
+ * list can still find the characters.
+ * Use these macros to read the elements of a list. */
+#define VAR_PACKED(var) ((var)->storage == TL_S_PACKED)
+#define VAR_PACKED_NUMS(var) ((float*)(var)->packed)
+#define VAR_PACKED_OFFSETS(var) ((size_t*)(var)->packed)
+#define VAR_PACKED_BLOCK(var) ((char*)((var)->base ? (var)->base : \
+                                       (var)->packed))
+#define VAR_NUM_AT(var, i) (VAR_PACKED(var) ? VAR_PACKED_NUMS(var)[i] : \
+                            VAR_NUM((var)->items[i]))
+#define VAR_STR_AT(var, i) (VAR_PACKED(var) ? VAR_PACKED_BLOCK(var)+ \
+                            VAR_PACKED_OFFSETS(var)[i] : \
+                            VAR_STR_DATA((var)->items[i]))
+#define VAR_STR_LEN_AT(var, i) (VAR_PACKED(var) ? \
+                                VAR_PACKED_OFFSETS(var)[(i)+1]- \
+                                VAR_PACKED_OFFSETS(var)[i] : \
+                                VAR_STR_LEN((var)->items[i]))
+
+/* Strings of up to TL_STR_INLINE_SZ bytes are stored inside of the String
+ * itself, longer strings are stored on the heap. */
+#define VAR_STR_INLINE(string) ((string)->len <= TL_STR_INLINE_SZ)
+#define VAR_RAW_STR_DATA(string) (VAR_STR_INLINE(string) ? \
+                                  (string)->data.buf : (string)->data.ptr)
+
 enum {
     TL_T_FUNC,
     TL_T_STR,
     TL_T_NUM,
     TL_T_NAME,
-    TL_T_CALL
+    TL_T_CALL,
+    TL_T_STREAM
+};
+
+enum {
+    TL_S_ITEMS,
+    TL_S_PACKED
 };
 
 typedef struct {
-    char *data;
+    union {
+        char *ptr;
+        char buf[TL_STR_INLINE_SZ];
+    } data;
     size_t len;
 } String;
 
@@ -83,7 +126,20 @@ typedef struct {
     } ptr;
     char builtin;
     char parseargs;
+    /* The function has no side effects. */
+    char pure;
+    /* The results of the function are cached. */
+    char memo;
+    /* Bit i is set if parameter i is always used before any side effect, so
+     * that a pure argument can be evaluated before calling. */
+    unsigned short strict;
+    /* The last lets parameters are not passed: their value is computed in the
+     * frame, from the child of their name in the params of the fncdef. */
+    unsigned short lets;
     void *params;
+    /* The body compiled to bytecode, owned by the interpreter. NULL until it
+     * is called for the first time. */
+    void *code;
 } Function;
 
 typedef struct {
@@ -96,34 +152,110 @@ typedef union {
     String string;
     Function function;
     Call call;
+    struct Stream *stream;
 } Item;
 
 typedef struct {
     Item *items;
+    void *packed;
+    /* Start of the storage when this Var is a view of a part of it: items or
+     * packed then point to the first element of the view. NULL otherwise. */
+    void *base;
     size_t size;
     unsigned char type;
+    unsigned char storage;
     char null;
+    /* The items are borrowed from a Var that outlives this one, like a
+     * constant or the parameter a view was taken from, and are not freed by
+     * var_free. */
+    char ref;
 } Var;
 
-int var_auto(Var *var, char *data, size_t len);
-int var_str(Var *var, char *data, size_t len);
-int var_str_concat(Var *var, Var *str1, Var *str2);
-int var_str_add(Var *var, char *data, size_t len);
-int var_raw_str(String *string, char *data, size_t len);
-int var_builtin_func(Var *var, int f(void*, void*, size_t, void*),
-                     char parse);
-int var_user_func(Var *var, void *fncdef, Var *params);
+/* The streams given by range, iterate, stream-map, stream-filter and drop.
+ * The elements of a list, the first elements of a take and the result of a
+ * reduce are streams too when their calls are fused. */
+enum {
+    TL_STREAM_RANGE,
+    TL_STREAM_ITERATE,
+    TL_STREAM_MAP,
+    TL_STREAM_FILTER,
+    TL_STREAM_DROP,
+    TL_STREAM_LIST,
+    TL_STREAM_TAKE,
+    TL_STREAM_FOLD
+};
+
+/* A lazy sequence: its elements are only computed when they are pulled, one
+ * at a time, so that it never holds more than one of them. A copy of a
+ * stream starts from where the stream is. */
+typedef struct Stream {
+    unsigned char kind;
+    /* The stream stands for a list, whose calls were fused. */
+    char list;
+    /* The stream the elements are pulled from. */
+    struct Stream *source;
+    /* The next number of a range, its step and its last number if it is
+     * bounded. */
+    float num;
+    float step;
+    float end;
+    char bounded;
+    /* Amount of elements a drop still skips or a take still gives, or
+     * index of the next element of a range or a list. */
+    size_t count;
+    /* Call of the function of iterate, stream-map or stream-filter, or an
+     * empty Var. */
+    Var function;
+    /* The element the function is called with, and what it returned. The
+     * element of an iterate is only given once ready is set. */
+    Var value;
+    char has_value;
+    Var result;
+    char has_result;
+    char ready;
+    /* The list the elements are read from, or the value a fold accumulates,
+     * that it gives once its source ended. */
+    Var data;
+    char has_data;
+    /* The nodes of the call of the function with value, made the first time
+     * it is called. */
+    void *nodes;
+} Stream;
+
+int var_auto(TlAllocator *alloc, Var *var, char *data, size_t len);
+int var_str(TlAllocator *alloc, Var *var, char *data, size_t len);
+int var_str_concat(TlAllocator *alloc, Var *var, Var *str1, Var *str2);
+int var_str_add(TlAllocator *alloc, Var *var, char *data, size_t len);
+int var_raw_str(TlAllocator *alloc, String *string, char *data, size_t len);
+int var_raw_str_alloc(TlAllocator *alloc, String *string, size_t len);
+int var_builtin_func(TlAllocator *alloc, Var *var,
+                     int f(void*, void*, size_t, void*), char parse,
+                     char pure);
+int var_user_func(TlAllocator *alloc, Var *var, void *fncdef, Var *params);
 char var_isnum(char *data, size_t len);
-int var_num(Var *var, char *data, size_t len);
-int var_num_from_float(Var *var, float num);
+int var_num(TlAllocator *alloc, Var *var, char *data, size_t len);
+int var_num_from_float(TlAllocator *alloc, Var *var, float num);
 char var_isname(char *data, size_t len);
-int var_copy(Var *src, Var *dest);
-int var_call(Var *var, char *name, size_t len);
+int var_copy(TlAllocator *alloc, Var *src, Var *dest);
+char var_same(Var *a, Var *b);
+unsigned long var_hash(Var *var, unsigned long hash);
+int var_ref(Var *src, Var *dest);
+int var_call(TlAllocator *alloc, Var *var, char *name, size_t len);
+int var_stream(TlAllocator *alloc, Var *var, unsigned char kind);
+int var_copy_stream(TlAllocator *alloc, Stream *src, Stream **dest);
 
 int var_free_call(Call *call);
-int var_free_str(String *string);
-int var_free(Var *var);
+int var_free_str(TlAllocator *alloc, String *string);
+int var_free_stream(TlAllocator *alloc, Stream *stream);
+int var_free_items(TlAllocator *alloc, Var *var, size_t start, size_t end);
+int var_free(TlAllocator *alloc, Var *var);
 
-int var_append(Var *src, Var *dest);
+size_t var_packed_size(Var *var);
+int var_append_packed(TlAllocator *alloc, Var *src, Var *dest);
+int var_append(TlAllocator *alloc, Var *src, Var *dest);
+int var_slice(TlAllocator *alloc, Var *var, size_t start, size_t len);
+char var_borrows(Var *var, Var *from);
+int var_take(TlAllocator *alloc, Var *var, Var *from);
+int var_substr(TlAllocator *alloc, Var *var, size_t start, size_t len);
 
 #endif
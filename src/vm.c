@@ -0,0 +1,767 @@
+/* A small interpreter for a lisp like language, targetting embedded systems.
+ * by Mibi88
+ *
+ * This software is licensed under the BSD-3-Clause license:
+ *
+ * Copyright 2024 Mibi88
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* CHANGELOG
+ *
+ * 2026/10/18: Created this file. Compile the body of the user defined
+ *             functions and the arguments they pass to bytecode and run
+ *             it. Specialised calls of builtin functions. Unboxed numeric
+ *             code. Lend the parameters to the builtin functions that only
+ *             read them. Run the bytecode translated to C ahead of time.
+ */
+
+#include <vm.h>
+#include <call.h>
+#include <builtin.h>
+#include <jit.h>
+#include <num.h>
+#include <math.h>
+
+int vm_emit(VmCompiler *c, unsigned char op, size_t arg, size_t *offset) {
+    Code *code = c->code;
+    unsigned char *ops;
+    size_t max;
+    /* The operands and the offsets to jump to have to fit in 16 bits. */
+    if(arg > TL_OP_MAX || code->size+TL_OP_SZ > TL_OP_MAX){
+        return TL_ERR_OUT_OF_RANGE;
+    }
+    if(code->size+TL_OP_SZ > c->op_max){
+        max = c->op_max ? c->op_max*2 : 64*TL_OP_SZ;
+        ops = TL_REALLOC(&c->lisp->alloc, code->ops, max);
+        if(!ops) return TL_ERR_OUT_OF_MEM;
+        code->ops = ops;
+        c->op_max = max;
+    }
+    if(offset) *offset = code->size;
+    code->ops[code->size] = op;
+    code->ops[code->size+1] = arg&0xFF;
+    code->ops[code->size+2] = arg>>8;
+    code->size += TL_OP_SZ;
+    return TL_SUCCESS;
+}
+
+int vm_add_ref(VmCompiler *c, Node *node, size_t *idx) {
+    Code *code = c->code;
+    CodeRef *refs;
+    size_t max;
+    if(code->ref_num > TL_OP_MAX) return TL_ERR_OUT_OF_RANGE;
+    if(code->ref_num == c->ref_max){
+        max = c->ref_max ? c->ref_max*2 : 16;
+        refs = TL_REALLOC(&c->lisp->alloc, code->refs, max*sizeof(CodeRef));
+        if(!refs) return TL_ERR_OUT_OF_MEM;
+        code->refs = refs;
+        c->ref_max = max;
+    }
+    code->refs[code->ref_num].node = node;
+    code->refs[code->ref_num].var = 0;
+    code->refs[code->ref_num].generic = 0;
+    *idx = code->ref_num++;
+    return TL_SUCCESS;
+}
+
+int vm_push(VmCompiler *c, int n) {
+    if(n < 0){
+        c->sp -= (size_t)-n;
+        return TL_SUCCESS;
+    }
+    c->sp += n;
+    if(c->sp > c->code->stack) c->code->stack = c->sp;
+    return TL_SUCCESS;
+}
+
+int vm_patch(VmCompiler *c, size_t offset) {
+    /* Jump to the next instruction. */
+    c->code->ops[offset+1] = c->code->size&0xFF;
+    c->code->ops[offset+2] = c->code->size>>8;
+    return TL_SUCCESS;
+}
+
+int vm_add_thunk(VmCompiler *c, Node *node) {
+    VmThunk *thunks;
+    size_t max;
+    if(c->thunk_num == c->thunk_max){
+        max = c->thunk_max ? c->thunk_max*2 : 8;
+        thunks = TL_REALLOC(&c->lisp->alloc, c->thunks,
+                            max*sizeof(VmThunk));
+        if(!thunks) return TL_ERR_OUT_OF_MEM;
+        c->thunks = thunks;
+        c->thunk_max = max;
+    }
+    c->thunks[c->thunk_num].node = node;
+    c->thunks[c->thunk_num].offset = 0;
+    c->thunk_num++;
+    return TL_SUCCESS;
+}
+
+int vm_finish(VmCompiler *c, int where) {
+    int rc;
+    if(where == TL_VM_ARG) return TL_SUCCESS;
+    rc = vm_emit(c, where == TL_VM_DROP ? TL_OP_POP : TL_OP_RETURN, 0, NULL);
+    if(rc) return rc;
+    return vm_push(c, -1);
+}
+
+int vm_compile_call(VmCompiler *c, Node *node, int where) {
+    Function *function;
+    Var *var = node->var;
+    Node *child;
+    size_t i, n;
+    int rc;
+    if(var->type == TL_T_CALL &&
+       (var->size != 1 ||
+        call_find_func(c->lisp, &var->items->call.function, &function) ||
+        !function->builtin || function->ptr.f != builtin_fncdef)){
+        /* The arguments the function evaluates itself are compiled too, to
+         * be run when they are evaluated. The bodies of the functions
+         * defined in it are compiled when they are called. */
+        for(i=0;i<node->childnum;i++){
+            child = ((Node**)node->childs)[i];
+            if(child->var->type != TL_T_CALL) continue;
+            rc = vm_add_thunk(c, child);
+            if(rc) return rc;
+        }
+    }
+    /* The call is performed by the evaluator of the tree. */
+    rc = vm_add_ref(c, node, &n);
+    if(rc) return rc;
+    if(where == TL_VM_RETURN) return vm_emit(c, TL_OP_TAIL, n, NULL);
+    rc = vm_emit(c, where == TL_VM_ARG ? TL_OP_CALL : TL_OP_EXEC, n, NULL);
+    if(rc) return rc;
+    vm_push(c, 1);
+    if(where == TL_VM_ARG) return TL_SUCCESS;
+    return vm_finish(c, where);
+}
+
+int vm_compile_if(VmCompiler *c, Node *node, int where) {
+    Node **childs = node->childs;
+    size_t jumpf, jump;
+    int rc;
+    rc = vm_compile_expr(c, childs[0], TL_VM_ARG);
+    if(rc) return rc;
+    rc = vm_emit(c, TL_OP_JUMPF, 0, &jumpf);
+    if(rc) return rc;
+    vm_push(c, -1);
+    rc = vm_compile_expr(c, childs[1], where);
+    if(rc) return rc;
+    rc = vm_emit(c, TL_OP_JUMP, 0, &jump);
+    if(rc) return rc;
+    /* Only one of the branches pushes its value. */
+    if(where == TL_VM_ARG) vm_push(c, -1);
+    vm_patch(c, jumpf);
+    rc = vm_compile_expr(c, childs[2], where);
+    if(rc) return rc;
+    vm_patch(c, jump);
+    return TL_SUCCESS;
+}
+
+int vm_compile_expr(VmCompiler *c, Node *node, int where) {
+    Function *function;
+    Node *child;
+    Var *var = node->var;
+    size_t i, n;
+    int rc;
+    if(var->type == TL_T_CALL){
+        if(var->size != 1 ||
+           call_find_func(c->lisp, &var->items->call.function, &function) ||
+           !function->builtin){
+            return vm_compile_call(c, node, where);
+        }
+        if(function->ptr.f == builtin_if && node->childnum == 3){
+            return vm_compile_if(c, node, where);
+        }
+        if(function->parseargs != TL_ARGS_ALL){
+            /* It gets its arguments itself. */
+            return vm_compile_call(c, node, where);
+        }
+        for(i=0;i<node->childnum;i++){
+            child = ((Node**)node->childs)[i];
+            if(!i && builtin_borrows(function) &&
+               child->var->type == TL_T_NAME && child->var->size == 1 &&
+               call_node_param(child, c->params, &n)){
+                rc = vm_emit(c, TL_OP_BORROW, n, NULL);
+                if(rc) return rc;
+                vm_push(c, 1);
+                continue;
+            }
+            rc = vm_compile_expr(c, child, TL_VM_ARG);
+            if(rc) return rc;
+        }
+        rc = vm_add_ref(c, node, &n);
+        if(rc) return rc;
+        c->code->refs[n].function = *function;
+        rc = vm_emit(c, TL_OP_BUILTIN, n, NULL);
+        if(rc) return rc;
+        /* The value it returns is put above its arguments first. */
+        vm_push(c, 1);
+        c->sp -= node->childnum+1;
+        vm_push(c, 1);
+        return vm_finish(c, where);
+    }
+    if(var->type == TL_T_NAME){
+        if(var->size != 1) return TL_ERR_INVALID_NAME;
+        if(call_node_param(node, c->params, &n)){
+            rc = vm_emit(c, TL_OP_PARAM, n, NULL);
+        }else{
+            rc = vm_add_ref(c, node, &n);
+            if(!rc) rc = vm_emit(c, TL_OP_GLOBAL, n, NULL);
+        }
+    }else{
+        rc = vm_add_ref(c, node, &n);
+        if(!rc){
+            rc = vm_emit(c, node->constant ? TL_OP_CONST : TL_OP_COPY, n,
+                         NULL);
+        }
+    }
+    if(rc) return rc;
+    vm_push(c, 1);
+    return vm_finish(c, where);
+}
+
+int vm_compile_stmt(VmCompiler *c, Node *node, char last) {
+    Code *code = c->code;
+    size_t *lines;
+    size_t max;
+    if(code->line_num == c->line_max){
+        max = c->line_max ? c->line_max*2 : 8;
+        lines = TL_REALLOC(&c->lisp->alloc, code->lines,
+                           max*2*sizeof(size_t));
+        if(!lines) return TL_ERR_OUT_OF_MEM;
+        code->lines = lines;
+        c->line_max = max;
+    }
+    code->lines[code->line_num*2] = code->size;
+    code->lines[code->line_num*2+1] = node->line;
+    code->line_num++;
+    if(node->var->type != TL_T_CALL){
+        /* Let the evaluator of the tree report the error. */
+        return vm_compile_call(c, node, last ? TL_VM_RETURN : TL_VM_DROP);
+    }
+    return vm_compile_expr(c, node, last ? TL_VM_RETURN : TL_VM_DROP);
+}
+
+int vm_compile_thunks(VmCompiler *c) {
+    size_t i;
+    int rc;
+    /* Compiling an argument may add the ones it passes. */
+    for(i=0;i<c->thunk_num;i++){
+        c->thunks[i].offset = c->code->size;
+        c->sp = 0;
+        rc = vm_compile_expr(c, c->thunks[i].node, TL_VM_VALUE);
+        if(rc) return rc;
+        rc = vm_emit(c, TL_OP_END, 0, NULL);
+        if(rc) return rc;
+    }
+    return TL_SUCCESS;
+}
+
+int vm_free_code(LizyLang *lisp, Code *code) {
+    jit_free(code);
+    TL_FREE(&lisp->alloc, code->num);
+    TL_FREE(&lisp->alloc, code->ops);
+    TL_FREE(&lisp->alloc, code->refs);
+    TL_FREE(&lisp->alloc, code->lines);
+    TL_FREE(&lisp->alloc, code);
+    return TL_SUCCESS;
+}
+
+int vm_compile(LizyLang *lisp, Function *function) {
+    Node *fncdef = function->ptr.fncdef;
+    Node *names = ((Node**)fncdef->childs)[1];
+    VmCompiler c;
+    Code *code;
+    size_t i;
+    int rc = TL_SUCCESS;
+    code = TL_MALLOC(&lisp->alloc, sizeof(Code));
+    if(!code) return TL_ERR_OUT_OF_MEM;
+    code->fncdef = fncdef;
+    code->ops = NULL;
+    code->size = 0;
+    code->refs = NULL;
+    code->ref_num = 0;
+    code->lines = NULL;
+    code->line_num = 0;
+    code->stack = 0;
+    code->calls = 0;
+    code->jit = NULL;
+    code->jit_size = 0;
+    code->native = NULL;
+    code->compiled = NULL;
+    code->typed = TL_NUM_UNKNOWN;
+    code->num_bounded = 0;
+    code->num = NULL;
+    code->num_size = 0;
+    code->num_params = 0;
+    code->num_depth = 0;
+    c.lisp = lisp;
+    c.code = code;
+    c.params = function->params;
+    c.op_max = 0;
+    c.ref_max = 0;
+    c.line_max = 0;
+    c.sp = 0;
+    c.thunks = NULL;
+    c.thunk_num = 0;
+    c.thunk_max = 0;
+    /* The expressions of the hidden parameters are evaluated like
+     * arguments. */
+    for(i=0;i<names->childnum && !rc;i++){
+        if(((Node**)names->childs)[i]->childnum &&
+           call_let(names, i)->var->type == TL_T_CALL){
+            rc = vm_add_thunk(&c, call_let(names, i));
+        }
+    }
+    for(i=2;i<fncdef->childnum && !rc;i++){
+        rc = vm_compile_stmt(&c, ((Node**)fncdef->childs)[i],
+                             i == fncdef->childnum-1);
+    }
+    if(!rc) rc = vm_emit(&c, TL_OP_END, 0, NULL);
+    if(!rc) rc = vm_compile_thunks(&c);
+    if(rc == TL_ERR_OUT_OF_MEM){
+        TL_FREE(&lisp->alloc, c.thunks);
+        vm_free_code(lisp, code);
+        return rc;
+    }
+    if(rc){
+        /* It is too big, the tree is evaluated instead. */
+        code->size = 0;
+    }else{
+        for(i=0;i<c.thunk_num;i++){
+            c.thunks[i].node->code = code;
+            c.thunks[i].node->offset = c.thunks[i].offset;
+        }
+    }
+    TL_FREE(&lisp->alloc, c.thunks);
+    /* The previous bytecode may still be running, so it is only freed with
+     * the interpreter. */
+    code->gen = lisp->code_gen;
+    code->next = lisp->codes;
+    lisp->codes = code;
+    function->code = code;
+    return TL_SUCCESS;
+}
+
+char vm_find_var(LizyLang *lisp, CodeRef *ref, String *name, size_t *n) {
+    size_t i = ref->var;
+    if(i < lisp->var_num && lisp->var_names[i].len == name->len &&
+       !memcmp(VAR_RAW_STR_DATA(lisp->var_names+i), VAR_RAW_STR_DATA(name),
+               name->len)){
+        *n = i;
+        return 1;
+    }
+    for(i=0;i<lisp->var_num;i++){
+        if(lisp->var_names[i].len != name->len) continue;
+        if(!memcmp(VAR_RAW_STR_DATA(lisp->var_names+i),
+                   VAR_RAW_STR_DATA(name), name->len)){
+            ref->var = i;
+            *n = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int vm_call(LizyLang *lisp, Cont *cont, CodeRef *ref, Var *dest, char *done,
+            char tail) {
+    Node *node = ref->node;
+    Cont *call;
+    size_t n;
+    int rc;
+    rc = call_push_cont(lisp, node, cont->context, dest, done, tail);
+    if(rc) return rc;
+    if(node->var->type == TL_T_CALL && node->var->size == 1 &&
+       vm_find_var(lisp, ref, &node->var->items->call.function, &n) &&
+       lisp->vars[n].type == TL_T_FUNC){
+        /* call_start does not have to look it up. */
+        call = TL_CONT(lisp, lisp->cont_cur-1);
+        call->function = &lisp->vars[n].items->function;
+    }
+    return TL_SUCCESS;
+}
+
+int vm_param(LizyLang *lisp, Cont *cont, size_t n, Arg *slot, char borrow) {
+    Arg *arg = TL_FRAME(lisp, cont->context-1)->args+n;
+    Node *node;
+    int rc;
+    if(arg->thunk) arg = arg->thunk;
+    if(arg->evaluated){
+        if(arg->value.type == TL_T_NAME){
+            return call_parse_arg(lisp, &arg->value, &slot->value,
+                                  cont->context);
+        }
+        if(borrow) return var_ref(&arg->value, &slot->value);
+        return var_copy(&lisp->alloc, &arg->value, &slot->value);
+    }
+    node = arg->node;
+    if(node->var->type == TL_T_CALL){
+        /* The instruction is run again once it is evaluated. */
+        rc = call_push_node(lisp, node, arg->context, &arg->value,
+                            &arg->evaluated);
+        return rc ? rc : TL_PENDING;
+    }
+    if(node->var->type == TL_T_NAME){
+        return call_parse_arg(lisp, node->var, &slot->value, arg->context);
+    }
+    if(node->constant) return var_ref(node->var, &slot->value);
+    return var_copy(&lisp->alloc, node->var, &slot->value);
+}
+
+int vm_builtin(LizyLang *lisp, Cont *cont, CodeRef *ref) {
+    Node *node = ref->node;
+    Arg *stack = cont->args;
+    Function *function = cont->function;
+    size_t evalnum = cont->evalnum;
+    size_t argnum = node->childnum;
+    size_t i;
+    Var returned;
+    int rc;
+    /* It gets its arguments from the stack as if they were the evaluated
+     * arguments of its continuation. */
+    cont->args = stack+cont->sp-argnum;
+    cont->evalnum = argnum;
+    cont->function = &ref->function;
+    rc = ref->function.ptr.f(lisp, node, argnum, &returned);
+    cont->args = stack;
+    cont->evalnum = evalnum;
+    cont->function = function;
+    cont->sp -= argnum;
+    call_free_args(lisp, stack+cont->sp, argnum);
+    for(i=0;i<argnum;i++) stack[cont->sp+i].evaluated = 0;
+    if(rc == TL_PENDING) return TL_ERR_INTERNAL;
+    if(rc) return rc;
+    stack[cont->sp].value = returned;
+    stack[cont->sp].evaluated = 1;
+    cont->sp++;
+    return TL_SUCCESS;
+}
+
+/* The instruction a call of a builtin function is specialised into for the
+ * arguments on the stack, TL_OP_BUILTIN if there is none. */
+unsigned char vm_quick_op(CodeRef *ref, Arg *args) {
+    int (*f)(void*, void*, size_t, void*) = ref->function.ptr.f;
+    Var *a = &args[0].value;
+    Var *b = &args[1].value;
+    if(VAR_LEN(a) != 1 || VAR_LEN(b) != 1 || a->type != b->type){
+        return TL_OP_BUILTIN;
+    }
+    if(a->type == TL_T_STR){
+        if(f == builtin_add) return TL_OP_ADD_STR;
+        if(f == builtin_equal) return TL_OP_EQ_STR;
+        if(f == builtin_not_equal) return TL_OP_NE_STR;
+        return TL_OP_BUILTIN;
+    }
+    if(a->type != TL_T_NUM) return TL_OP_BUILTIN;
+    if(f == builtin_add) return TL_OP_ADD_NUM;
+    if(f == builtin_substract) return TL_OP_SUB_NUM;
+    if(f == builtin_multiply) return TL_OP_MUL_NUM;
+    if(f == builtin_divide) return TL_OP_DIV_NUM;
+    if(f == builtin_modulo) return TL_OP_MOD_NUM;
+    if(f == builtin_smaller) return TL_OP_LT_NUM;
+    if(f == builtin_bigger) return TL_OP_GT_NUM;
+    if(f == builtin_smaller_or_equal) return TL_OP_LE_NUM;
+    if(f == builtin_bigger_or_equal) return TL_OP_GE_NUM;
+    if(f == builtin_equal) return TL_OP_EQ_NUM;
+    if(f == builtin_not_equal) return TL_OP_NE_NUM;
+    return TL_OP_BUILTIN;
+}
+
+/* Checks that the arguments still have the types the instruction was
+ * specialised for. The errors are left to the builtin function. */
+char vm_guard(unsigned char op, Arg *args) {
+    Var *a = &args[0].value;
+    Var *b = &args[1].value;
+    int type = op >= TL_OP_ADD_STR ? TL_T_STR : TL_T_NUM;
+    if(VAR_LEN(a) != 1 || VAR_LEN(b) != 1) return 0;
+    if(a->type != type || b->type != type) return 0;
+    if(op == TL_OP_DIV_NUM || op == TL_OP_MOD_NUM){
+        return VAR_NUM_AT(b, 0) != 0;
+    }
+    return 1;
+}
+
+/* Runs a specialised instruction, its arguments are replaced by the value
+ * it returns. */
+int vm_quick(LizyLang *lisp, Cont *cont, unsigned char op) {
+    Arg *args = cont->args+cont->sp-2;
+    Var *a = &args[0].value;
+    Var *b = &args[1].value;
+    Var returned;
+    float x, y, result;
+    char equal;
+    int rc;
+    if(op == TL_OP_ADD_STR){
+        rc = var_str_concat(&lisp->alloc, &returned, a, b);
+        if(rc) return rc;
+        var_free(&lisp->alloc, a);
+        *a = returned;
+    }else{
+        if(op >= TL_OP_ADD_STR){
+            equal = VAR_STR_LEN_AT(a, 0) == VAR_STR_LEN_AT(b, 0) &&
+                    !memcmp(VAR_STR_AT(a, 0), VAR_STR_AT(b, 0),
+                            VAR_STR_LEN_AT(a, 0));
+            result = op == TL_OP_EQ_STR ? equal : !equal;
+        }else{
+            x = VAR_NUM_AT(a, 0);
+            y = VAR_NUM_AT(b, 0);
+            switch(op){
+                case TL_OP_ADD_NUM:
+                    result = x+y;
+                    break;
+                case TL_OP_SUB_NUM:
+                    result = x-y;
+                    break;
+                case TL_OP_MUL_NUM:
+                    result = x*y;
+                    break;
+                case TL_OP_DIV_NUM:
+                    result = x/y;
+                    break;
+                case TL_OP_MOD_NUM:
+                    result = fmod(x, y);
+                    break;
+                case TL_OP_LT_NUM:
+                    result = x < y;
+                    break;
+                case TL_OP_GT_NUM:
+                    result = x > y;
+                    break;
+                case TL_OP_LE_NUM:
+                    result = x <= y;
+                    break;
+                case TL_OP_GE_NUM:
+                    result = x >= y;
+                    break;
+                case TL_OP_EQ_NUM:
+                    result = x == y;
+                    break;
+                default:
+                    result = x != y;
+            }
+        }
+        if(a->type == TL_T_NUM && !a->ref && !VAR_PACKED(a) && !a->base){
+            /* The first argument is not used anymore, its item is reused. */
+            a->items->num = result;
+        }else{
+            rc = var_num_from_float(&lisp->alloc, &returned, result);
+            if(rc) return rc;
+            var_free(&lisp->alloc, a);
+            *a = returned;
+        }
+    }
+    var_free(&lisp->alloc, b);
+    args[1].evaluated = 0;
+    cont->sp--;
+    return TL_SUCCESS;
+}
+
+int vm_run(LizyLang *lisp, Cont *cont) {
+    Code *code = cont->code;
+    Node *node;
+    Arg *slot;
+    Var parsed;
+    size_t i, n;
+    unsigned char op;
+    char done;
+    int rc = TL_SUCCESS;
+    if(!cont->args){
+        if(cont->state == TL_C_VM){
+            /* The function runs as native code when it can. */
+            rc = jit_call(lisp, cont, &done);
+            if(rc) return rc;
+            if(done) return call_end_body(lisp, cont);
+        }
+        /* The stack is taken from the argument pool. */
+        rc = call_alloc_args(lisp, code->stack, &cont->args,
+                             &cont->arg_chunk);
+        if(rc) return rc;
+        cont->argnum = code->stack;
+        for(i=0;i<code->stack;i++) cont->args[i].evaluated = 0;
+        cont->sp = 0;
+    }
+    /* Its bytecode may have been translated to C ahead of time. */
+    if(code->compiled) return code->compiled(lisp, cont);
+    for(;;){
+        op = code->ops[cont->i];
+        n = code->ops[cont->i+1]|code->ops[cont->i+2]<<8;
+        slot = cont->args+cont->sp;
+        switch(op){
+            case TL_OP_CONST:
+                node = code->refs[n].node;
+                rc = var_ref(node->var, &slot->value);
+                break;
+            case TL_OP_COPY:
+                node = code->refs[n].node;
+                rc = var_copy(&lisp->alloc, node->var, &slot->value);
+                break;
+            case TL_OP_PARAM:
+            case TL_OP_BORROW:
+                rc = vm_param(lisp, cont, n, slot, op == TL_OP_BORROW);
+                if(rc == TL_PENDING) return TL_SUCCESS;
+                break;
+            case TL_OP_GLOBAL:
+                node = code->refs[n].node;
+                if(!vm_find_var(lisp, code->refs+n, &node->var->items->string,
+                                &i)){
+                    return TL_ERR_NOT_DEF;
+                }
+                rc = var_copy(&lisp->alloc, lisp->vars+i, &slot->value);
+                break;
+            case TL_OP_BUILTIN:
+                if(lisp->opt & TL_OPT_QUICKEN && !code->refs[n].generic &&
+                   ((Node*)code->refs[n].node)->childnum == 2){
+                    /* The call site is rewritten for the types it sees. */
+                    op = vm_quick_op(code->refs+n, slot-2);
+                    if(op != TL_OP_BUILTIN){
+                        code->ops[cont->i] = op;
+                        continue;
+                    }
+                    code->refs[n].generic = 1;
+                }
+                rc = vm_builtin(lisp, cont, code->refs+n);
+                if(rc) return rc;
+                cont->i += TL_OP_SZ;
+                continue;
+            case TL_OP_ADD_NUM:
+            case TL_OP_SUB_NUM:
+            case TL_OP_MUL_NUM:
+            case TL_OP_DIV_NUM:
+            case TL_OP_MOD_NUM:
+            case TL_OP_LT_NUM:
+            case TL_OP_GT_NUM:
+            case TL_OP_LE_NUM:
+            case TL_OP_GE_NUM:
+            case TL_OP_EQ_NUM:
+            case TL_OP_NE_NUM:
+            case TL_OP_ADD_STR:
+            case TL_OP_EQ_STR:
+            case TL_OP_NE_STR:
+                if(!vm_guard(op, slot-2)){
+                    /* It is not specialised anymore. */
+                    code->ops[cont->i] = TL_OP_BUILTIN;
+                    code->refs[n].generic = 1;
+                    continue;
+                }
+                rc = vm_quick(lisp, cont, op);
+                if(rc) return rc;
+                cont->i += TL_OP_SZ;
+                continue;
+            case TL_OP_CALL:
+                /* FALLTHRU */
+            case TL_OP_EXEC:
+                if(!slot->evaluated){
+                    /* The instruction is run again once it returned. */
+                    return vm_call(lisp, cont, code->refs+n, &slot->value,
+                                   &slot->evaluated, 0);
+                }
+                if(op == TL_OP_CALL && slot->value.type == TL_T_NAME){
+                    rc = call_parse_arg(lisp, &slot->value, &parsed,
+                                        cont->context);
+                    if(rc) return rc;
+                    var_free(&lisp->alloc, &slot->value);
+                    slot->value = parsed;
+                }
+                cont->sp++;
+                cont->i += TL_OP_SZ;
+                continue;
+            case TL_OP_TAIL:
+                cont->i += TL_OP_SZ;
+                return vm_call(lisp, cont, code->refs+n, cont->dest, NULL, 1);
+            case TL_OP_POP:
+                slot--;
+                var_free(&lisp->alloc, &slot->value);
+                slot->evaluated = 0;
+                cont->sp--;
+                cont->i += TL_OP_SZ;
+                continue;
+            case TL_OP_JUMPF:
+                slot--;
+                if(VAR_LEN(&slot->value) != 1){
+                    rc = TL_ERR_INVALID_LIST_SIZE;
+                }else if(slot->value.type != TL_T_NUM){
+                    rc = TL_ERR_BAD_TYPE;
+                }
+                cont->i = !rc && VAR_NUM_AT(&slot->value, 0) == 0 ? n :
+                          cont->i+TL_OP_SZ;
+                var_free(&lisp->alloc, &slot->value);
+                slot->evaluated = 0;
+                cont->sp--;
+                if(rc) return rc;
+                continue;
+            case TL_OP_JUMP:
+                cont->i = n;
+                continue;
+            case TL_OP_RETURN:
+                slot--;
+                *cont->dest = slot->value;
+                slot->evaluated = 0;
+                cont->sp--;
+                cont->i += TL_OP_SZ;
+                continue;
+            case TL_OP_END:
+                call_free_cont_args(lisp, cont);
+                if(cont->state == TL_C_EXPR){
+                    if(cont->done) *cont->done = 1;
+                    return call_pop_cont(lisp);
+                }
+                return call_end_body(lisp, cont);
+            default:
+                return TL_ERR_INTERNAL;
+        }
+        if(rc) return rc;
+        /* The instruction pushed a value. */
+        slot->evaluated = 1;
+        cont->sp++;
+        cont->i += TL_OP_SZ;
+    }
+}
+
+size_t vm_line(Code *code, size_t offset) {
+    size_t i;
+    size_t line = 0;
+    for(i=0;i<code->line_num;i++){
+        if(code->lines[i*2] > offset) break;
+        line = code->lines[i*2+1];
+    }
+    return line;
+}
+
+int vm_free(LizyLang *lisp) {
+    Code *next;
+    while(lisp->codes){
+        next = lisp->codes->next;
+        vm_free_code(lisp, lisp->codes);
+        lisp->codes = next;
+    }
+    return TL_SUCCESS;
+}
@@ -0,0 +1,159 @@
+/* A small interpreter for a lisp like language, targetting embedded systems.
+ * by Mibi88
+ *
+ * This software is licensed under the BSD-3-Clause license:
+ *
+ * Copyright 2024 Mibi88
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* CHANGELOG
+ *
+ * 2026/10/18: Created this file. Compile the body of the user defined
+ *             functions and the arguments they pass to bytecode and run
+ *             it. Specialised calls of builtin functions. Lend the
+ *             parameters to the builtin functions that only read them.
+ */
+
+#ifndef VM_H
+#define VM_H
+
+#include <lisp.h>
+#include <var.h>
+#include <tree.h>
+
+/* Every instruction is an opcode followed by a 16 bits operand, the index of
+ * a CodeRef, of a parameter or the offset to jump to. */
+enum {
+    /* Push a constant. */
+    TL_OP_CONST,
+    /* Push a copy of a value of the tree. */
+    TL_OP_COPY,
+    /* Push the value of a parameter, that is evaluated if it was not yet. */
+    TL_OP_PARAM,
+    /* Push a parameter without copying it, for a builtin function that only
+     * reads it. */
+    TL_OP_BORROW,
+    /* Push the value of a global variable. */
+    TL_OP_GLOBAL,
+    /* Call a builtin function with the values on top of the stack. */
+    TL_OP_BUILTIN,
+    /* A call of a builtin function with two arguments rewritten for the
+     * types it was first run with. If the arguments have other types it
+     * becomes a BUILTIN again. */
+    TL_OP_ADD_NUM,
+    TL_OP_SUB_NUM,
+    TL_OP_MUL_NUM,
+    TL_OP_DIV_NUM,
+    TL_OP_MOD_NUM,
+    TL_OP_LT_NUM,
+    TL_OP_GT_NUM,
+    TL_OP_LE_NUM,
+    TL_OP_GE_NUM,
+    TL_OP_EQ_NUM,
+    TL_OP_NE_NUM,
+    TL_OP_ADD_STR,
+    TL_OP_EQ_STR,
+    TL_OP_NE_STR,
+    /* Evaluate a call of the tree and push its value. CALL looks the value
+     * up if it is a name, like when it is passed to a builtin function. */
+    TL_OP_CALL,
+    TL_OP_EXEC,
+    /* Perform a call of the tree that returns the value of the function. */
+    TL_OP_TAIL,
+    /* Remove the value on top of the stack. */
+    TL_OP_POP,
+    /* Remove the condition on top of the stack and jump if it is 0. */
+    TL_OP_JUMPF,
+    TL_OP_JUMP,
+    /* Return the value on top of the stack. */
+    TL_OP_RETURN,
+    TL_OP_END
+};
+
+#define TL_OP_SZ 3
+#define TL_OP_MAX 0xFFFF
+
+/* Where the value of an expression goes. */
+enum {
+    /* Pushed, a name returned by a call is looked up. */
+    TL_VM_ARG,
+    /* Removed once it is evaluated. */
+    TL_VM_DROP,
+    /* Returned by the function. */
+    TL_VM_RETURN,
+    /* Returned, but not in tail position: an argument is evaluated. */
+    TL_VM_VALUE
+};
+
+/* An argument passed to a user defined function, compiled after the body. */
+typedef struct {
+    Node *node;
+    size_t offset;
+} VmThunk;
+
+typedef struct {
+    LizyLang *lisp;
+    Code *code;
+    Var *params;
+    size_t op_max;
+    size_t ref_max;
+    size_t line_max;
+    size_t sp;
+    VmThunk *thunks;
+    size_t thunk_num;
+    size_t thunk_max;
+} VmCompiler;
+
+int vm_emit(VmCompiler *c, unsigned char op, size_t arg, size_t *offset);
+int vm_add_ref(VmCompiler *c, Node *node, size_t *idx);
+int vm_push(VmCompiler *c, int n);
+int vm_patch(VmCompiler *c, size_t offset);
+int vm_add_thunk(VmCompiler *c, Node *node);
+int vm_finish(VmCompiler *c, int where);
+int vm_compile_call(VmCompiler *c, Node *node, int where);
+int vm_compile_if(VmCompiler *c, Node *node, int where);
+int vm_compile_expr(VmCompiler *c, Node *node, int where);
+int vm_compile_stmt(VmCompiler *c, Node *node, char last);
+int vm_compile_thunks(VmCompiler *c);
+int vm_free_code(LizyLang *lisp, Code *code);
+int vm_compile(LizyLang *lisp, Function *function);
+char vm_find_var(LizyLang *lisp, CodeRef *ref, String *name, size_t *n);
+int vm_call(LizyLang *lisp, Cont *cont, CodeRef *ref, Var *dest, char *done,
+            char tail);
+int vm_param(LizyLang *lisp, Cont *cont, size_t n, Arg *slot, char borrow);
+int vm_builtin(LizyLang *lisp, Cont *cont, CodeRef *ref);
+unsigned char vm_quick_op(CodeRef *ref, Arg *args);
+char vm_guard(unsigned char op, Arg *args);
+int vm_quick(LizyLang *lisp, Cont *cont, unsigned char op);
+int vm_run(LizyLang *lisp, Cont *cont);
+size_t vm_line(Code *code, size_t offset);
+int vm_free(LizyLang *lisp);
+
+#endif